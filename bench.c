@@ -0,0 +1,488 @@
+#include "chip8.h"
+#include "chip8_harness.h"
+#include "chip8_jit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+    Benchmark suite:
+    Runs every rom given on the command line for a fixed instruction budget
+    with scripted input and reports ns per instruction, draws per second
+    and `chip8_pixel_data` throughput. Instructions are the ones actually
+    executed, cycles skipped in idle loops are reported apart with the time
+    per cycle of the virtual clock next to it. Every measurement is taken
+    `--trials` times after `--warmup` untimed runs and reported as the
+    best and the median trial. Microbenchmarks isolate instruction
+    decoding, DXYN and `chip8_pixel_data` in both resolutions from the
+    rest of the interpreter.
+
+    Usage: chip8_bench [--cycles N] [--trials N] [--warmup N] [--cycles-per-frame N] [--jit] [--json FILE] rom...
+
+    --json FILE    Also writes all results as JSON, `-` for stdout. The
+                   hash of the final machine state is included so changes
+                   in behaviour show up next to changes in speed.
+
+    `cmake --build . --target bench` runs the suite over `roms/` and writes
+    `bench.json` to the build directory.
+*/
+
+enum
+{
+    DEFAULT_CYCLES = 1000000,
+    DEFAULT_TRIALS = 5,
+    DEFAULT_WARMUP = 1,
+    DEFAULT_CYCLES_PER_FRAME = 10,
+    MAX_TRIALS = 64,
+    // Seed of the scripted input
+    INPUT_SEED = 1,
+    PIXEL_DATA_ITERATIONS = 20000,
+    DECODE_ITERATIONS = 2000,
+    DRAW_ITERATIONS = 2000000,
+};
+
+typedef struct BenchOptions
+{
+    ui64 num_cycles;
+    ui32 num_trials;
+    ui32 num_warmup;
+    ui32 cycles_per_frame;
+    ui8 use_jit;
+    const char *json_path;
+} BenchOptions;
+
+// The best trial and the median one
+typedef struct BenchStat
+{
+    double best;
+    double median;
+} BenchStat;
+
+typedef struct RomResult
+{
+    const char *rom_file_path;
+    // Per executed instruction, idle-skipped cycles left out
+    BenchStat ns_per_instruction;
+    // Per cycle of the virtual clock, idle-skipped cycles included
+    BenchStat ns_per_cycle;
+    BenchStat draws_per_second;
+    BenchStat pixel_data_ns;
+    ui64 num_draws;
+    ui64 num_idle_cycles;
+    ui64 state_hash;
+} RomResult;
+
+typedef struct MicroResult
+{
+    const char *name;
+    BenchStat ns_per_op;
+} MicroResult;
+
+// Runs once per trial and returns the time taken, lower is better
+typedef double (*BenchFunction)(void *context);
+
+// Keeps the results of measured loops from being optimized away
+static volatile ui32 bench_sink;
+
+void print_usage(const char *program);
+BenchStat measure(const BenchOptions *options, BenchFunction function, void *context);
+int bench_rom(const char *rom_file_path, const BenchOptions *options, RomResult *result);
+void bench_micro(const BenchOptions *options, MicroResult *results);
+void write_json(FILE *file, const BenchOptions *options, const RomResult *rom_results, const ui32 num_roms, const MicroResult *micro_results, const ui32 num_micro);
+
+enum
+{
+    MICRO_DECODE,
+    MICRO_DRAW,
+    MICRO_PIXEL_DATA,
+    MICRO_PIXEL_DATA_HIRES,
+    NUM_MICRO,
+};
+
+int main(int n_args, char **args)
+{
+    BenchOptions options = { DEFAULT_CYCLES, DEFAULT_TRIALS, DEFAULT_WARMUP, DEFAULT_CYCLES_PER_FRAME, 0, NULL };
+
+    int arg = 1;
+    for(; arg < n_args; ++arg)
+    {
+        if(strcmp(args[arg], "--cycles") == 0 && arg + 1 < n_args)
+            options.num_cycles = strtoull(args[++arg], NULL, 0);
+        else if(strcmp(args[arg], "--trials") == 0 && arg + 1 < n_args)
+            options.num_trials = (ui32)strtoul(args[++arg], NULL, 0);
+        else if(strcmp(args[arg], "--warmup") == 0 && arg + 1 < n_args)
+            options.num_warmup = (ui32)strtoul(args[++arg], NULL, 0);
+        else if(strcmp(args[arg], "--cycles-per-frame") == 0 && arg + 1 < n_args)
+            options.cycles_per_frame = (ui32)strtoul(args[++arg], NULL, 0);
+        else if(strcmp(args[arg], "--json") == 0 && arg + 1 < n_args)
+            options.json_path = args[++arg];
+        else if(strcmp(args[arg], "--jit") == 0)
+            options.use_jit = 1;
+        else if(strcmp(args[arg], "--help") == 0)
+        {
+            print_usage(args[0]);
+            return 0;
+        }
+        else if(args[arg][0] == '-' && args[arg][1] == '-')
+        {
+            print_usage(args[0]);
+            return 1;
+        }
+        else
+            break;
+    }
+
+    if(options.num_cycles == 0 || options.num_trials == 0 || options.num_trials > MAX_TRIALS || options.cycles_per_frame == 0)
+    {
+        print_usage(args[0]);
+        return 1;
+    }
+
+    const ui32 num_roms = (ui32)(n_args - arg);
+    RomResult *rom_results = calloc(num_roms + 1, sizeof(RomResult));
+    if(rom_results == NULL)
+        return 1;
+
+    int exit_code = 0;
+    ui32 num_rom_results = 0;
+    for(; arg < n_args; ++arg)
+    {
+        RomResult *result = &rom_results[num_rom_results];
+        if(bench_rom(args[arg], &options, result) != 0)
+        {
+            exit_code = 1;
+            continue;
+        }
+        ++num_rom_results;
+
+        printf("%-24s ns/instr=%.3f (median %.3f) ns/cycle=%.3f idle=%llu draws/s=%.0f pixel_data=%.1fns hash=%016llx\n",
+            args[arg], result->ns_per_instruction.best, result->ns_per_instruction.median, result->ns_per_cycle.median,
+            result->num_idle_cycles, result->draws_per_second.median, result->pixel_data_ns.median, result->state_hash);
+    }
+
+    MicroResult micro_results[NUM_MICRO];
+    bench_micro(&options, micro_results);
+    for(ui32 i = 0; i < NUM_MICRO; ++i)
+        printf("%-24s ns/op=%.3f (median %.3f)\n", micro_results[i].name, micro_results[i].ns_per_op.best, micro_results[i].ns_per_op.median);
+
+    if(options.json_path != NULL)
+    {
+        FILE *file = strcmp(options.json_path, "-") == 0 ? stdout : fopen(options.json_path, "w");
+        if(file == NULL)
+        {
+            printf("cannot write `%s`\n", options.json_path);
+            exit_code = 1;
+        }
+        else
+        {
+            write_json(file, &options, rom_results, num_rom_results, micro_results, NUM_MICRO);
+            if(file != stdout && fclose(file) != 0)
+                exit_code = 1;
+        }
+    }
+
+    free(rom_results);
+    return exit_code;
+}
+
+void print_usage(const char *program)
+{
+    printf("Usage: %s [--cycles N] [--trials N (at most %d)] [--warmup N] [--cycles-per-frame N] [--jit] [--json FILE] rom...\n", program, MAX_TRIALS);
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    const double value_a = *(const double*)a;
+    const double value_b = *(const double*)b;
+    return (value_a > value_b) - (value_a < value_b);
+}
+
+BenchStat measure(const BenchOptions *options, BenchFunction function, void *context)
+{
+    for(ui32 i = 0; i < options->num_warmup; ++i)
+        function(context);
+
+    double values[MAX_TRIALS];
+    for(ui32 i = 0; i < options->num_trials; ++i)
+        values[i] = function(context);
+
+    qsort(values, options->num_trials, sizeof(double), compare_doubles);
+    const ui32 middle = options->num_trials / 2;
+    const double median = options->num_trials % 2 != 0 ? values[middle] : (values[middle - 1] + values[middle]) * 0.5;
+    const BenchStat stat = { values[0], median };
+    return stat;
+}
+
+/*
+    Rom runs:
+    Every trial starts from a freshly loaded rom with the same seed and the
+    same scripted input, so all trials execute the same instructions.
+*/
+
+typedef struct RomRun
+{
+    const char *rom_file_path;
+    const BenchOptions *options;
+    Chip8 chip8;
+    ui64 num_draws;
+    // Instructions executed, the budget without the cycles skipped in idle loops
+    ui64 num_instructions;
+    double seconds;
+} RomRun;
+
+static void rom_run(RomRun *run)
+{
+    Chip8 *chip8 = &run->chip8;
+    chip8_init(chip8);
+    chip8_seed(chip8, 0);
+    chip8_set_cycles_per_frame(chip8, run->options->cycles_per_frame);
+    chip8_load_rom(chip8, run->rom_file_path);
+
+    Chip8Jit *jit = run->options->use_jit ? chip8_jit_create(chip8) : NULL;
+    Chip8KeyScript script;
+    chip8_key_script_start(&script, chip8, INPUT_SEED);
+    ui64 num_draws = 0;
+
+    // Runs only stop for events and on the frames the script flips a key on, the tiers tick the timers in between
+    const ui64 num_cycles = run->options->num_cycles;
+    const double start = chip8_now_seconds();
+    for(ui64 cycle = 0; cycle < num_cycles;)
+    {
+        ui64 budget = chip8_key_script_cycles(&script, chip8);
+        if(budget > num_cycles - cycle)
+            budget = num_cycles - cycle;
+        if(budget > 0xFFFFFFFF)
+            budget = 0xFFFFFFFF;
+
+        ui32 events = 0;
+        cycle += jit != NULL ? chip8_jit_run_cycles(jit, chip8, (ui32)budget, &events) : chip8_run_cycles(chip8, (ui32)budget, &events);
+        num_draws += (events & C8_EVENT_DRAW) != 0;
+
+        Chip8InputKey key;
+        if(chip8_key_script_next(&script, chip8, &key))
+            chip8_feed_input(chip8, &key, 1);
+    }
+    run->seconds = chip8_now_seconds() - start;
+    run->num_draws = num_draws;
+    run->num_instructions = num_cycles - chip8->idle_cycles_skipped;
+
+    chip8_jit_destroy(jit);
+}
+
+static double rom_ns_per_instruction(void *context)
+{
+    RomRun *run = (RomRun*)context;
+    rom_run(run);
+    return run->num_instructions != 0 ? run->seconds * 1e9 / (double)run->num_instructions : 0.0;
+}
+
+// Exports the final screen of the last run
+static double rom_pixel_data_ns(void *context)
+{
+    RomRun *run = (RomRun*)context;
+    static ui8 pixels[C8_HIRES_SCREEN_PIXELS];
+    ui32 checksum = 0;
+
+    const double start = chip8_now_seconds();
+    for(ui32 i = 0; i < PIXEL_DATA_ITERATIONS; ++i)
+    {
+        chip8_pixel_data(&run->chip8, pixels, C8_HIRES_SCREEN_PIXELS);
+        checksum += pixels[i % C8_HIRES_SCREEN_PIXELS];
+    }
+    const double seconds = chip8_now_seconds() - start;
+
+    bench_sink = checksum;
+    return seconds * 1e9 / PIXEL_DATA_ITERATIONS;
+}
+
+int bench_rom(const char *rom_file_path, const BenchOptions *options, RomResult *result)
+{
+    static RomRun run;
+    run.rom_file_path = rom_file_path;
+    run.options = options;
+
+    chip8_init(&run.chip8);
+    if(chip8_load_rom(&run.chip8, rom_file_path) != C8_LOAD_OK)
+    {
+        printf("%s: failed to load rom\n", rom_file_path);
+        return 1;
+    }
+
+    result->rom_file_path = rom_file_path;
+    result->ns_per_instruction = measure(options, rom_ns_per_instruction, &run);
+    // Every trial executes the same instructions and draws the same number of times
+    const double instructions_per_cycle = (double)run.num_instructions / (double)options->num_cycles;
+    result->ns_per_cycle.best = result->ns_per_instruction.best * instructions_per_cycle;
+    result->ns_per_cycle.median = result->ns_per_instruction.median * instructions_per_cycle;
+    const double draws_per_instruction = run.num_instructions != 0 ? (double)run.num_draws / (double)run.num_instructions : 0.0;
+    result->draws_per_second.best = result->ns_per_instruction.best > 0.0 ? draws_per_instruction / result->ns_per_instruction.best * 1e9 : 0.0;
+    result->draws_per_second.median = result->ns_per_instruction.median > 0.0 ? draws_per_instruction / result->ns_per_instruction.median * 1e9 : 0.0;
+    result->pixel_data_ns = measure(options, rom_pixel_data_ns, &run);
+    result->num_draws = run.num_draws;
+    result->num_idle_cycles = run.chip8.idle_cycles_skipped;
+    result->state_hash = chip8_state_hash(&run.chip8);
+    return 0;
+}
+
+/*
+    Microbenchmarks:
+    Each one runs a single part of the interpreter in a loop over fixed,
+    generated input and reports the time per operation.
+*/
+
+static double micro_decode(void *context)
+{
+    Chip8 *chip8 = (Chip8*)context;
+    Chip8Instruction instruction;
+    ui32 checksum = 0;
+
+    const double start = chip8_now_seconds();
+    for(ui32 i = 0; i < DECODE_ITERATIONS; ++i)
+    {
+        for(ui16 address = 0; address < C8_MEMORY_SIZE; address += 2)
+        {
+            chip8_decode_instruction(chip8, address, &instruction);
+            checksum += instruction.op + instruction.nnn;
+        }
+    }
+    const double seconds = chip8_now_seconds() - start;
+
+    bench_sink = checksum;
+    return seconds * 1e9 / ((double)DECODE_ITERATIONS * C8_NUM_DECODED_INSTRUCTIONS);
+}
+
+// Draws a 15 row sprite at a new position every time, wrapping around both edges, through its handler alone
+static double micro_draw(void *context)
+{
+    Chip8 *chip8 = (Chip8*)context;
+    Chip8Instruction instruction;
+    chip8_decode_instruction(chip8, C8_ROM_PLACEMENT, &instruction);
+    ui32 checksum = 0;
+
+    const double start = chip8_now_seconds();
+    for(ui32 i = 0; i < DRAW_ITERATIONS; ++i)
+    {
+        chip8->registers[0] = (ui8)(i * 7);
+        chip8->registers[1] = (ui8)(i * 3);
+        checksum += instruction.handler(chip8, &instruction);
+    }
+    const double seconds = chip8_now_seconds() - start;
+
+    bench_sink = checksum;
+    return seconds * 1e9 / DRAW_ITERATIONS;
+}
+
+static double micro_pixel_data(void *context)
+{
+    Chip8 *chip8 = (Chip8*)context;
+    static ui8 pixels[C8_HIRES_SCREEN_PIXELS];
+    ui32 checksum = 0;
+
+    const double start = chip8_now_seconds();
+    for(ui32 i = 0; i < PIXEL_DATA_ITERATIONS; ++i)
+    {
+        chip8_pixel_data(chip8, pixels, C8_HIRES_SCREEN_PIXELS);
+        checksum += pixels[i % C8_HIRES_SCREEN_PIXELS];
+    }
+    const double seconds = chip8_now_seconds() - start;
+
+    bench_sink = checksum;
+    return seconds * 1e9 / PIXEL_DATA_ITERATIONS;
+}
+
+void bench_micro(const BenchOptions *options, MicroResult *results)
+{
+    static Chip8 chip8;
+    chip8_init(&chip8);
+    chip8_seed(&chip8, 0);
+
+    // Random code, every opcode class shows up
+    ui8 code[C8_MAX_ROM_SIZE];
+    for(ui32 i = 0; i < sizeof(code); ++i)
+        code[i] = chip8_random_byte(&chip8.random_state);
+    chip8_load_rom_data(&chip8, code, sizeof(code));
+    results[MICRO_DECODE].name = "decode";
+    results[MICRO_DECODE].ns_per_op = measure(options, micro_decode, &chip8);
+
+    // `D01F` with I on 15 bytes of random sprite data right after it
+    const ui8 draw_code[] = { 0xD0, 0x1F };
+    chip8_load_rom_data(&chip8, draw_code, sizeof(draw_code));
+    for(ui32 i = 0; i < 15; ++i)
+        chip8.memory[C8_ROM_PLACEMENT + 2 + i] = chip8_random_byte(&chip8.random_state);
+    chip8.index_register = C8_ROM_PLACEMENT + 2;
+    results[MICRO_DRAW].name = "draw";
+    results[MICRO_DRAW].ns_per_op = measure(options, micro_draw, &chip8);
+
+    // Random screen, so no row can take a shortcut, the hi-res one shares its first half with the lo-res one
+    for(ui32 word = 0; word < C8_SCREEN_WORDS; ++word)
+    {
+        for(ui32 i = 0; i < sizeof(ui64); ++i)
+            chip8.screen_memory[word] = chip8.screen_memory[word] << 8 | chip8_random_byte(&chip8.random_state);
+    }
+    results[MICRO_PIXEL_DATA].name = "pixel_data";
+    results[MICRO_PIXEL_DATA].ns_per_op = measure(options, micro_pixel_data, &chip8);
+    chip8.hires = 1;
+    results[MICRO_PIXEL_DATA_HIRES].name = "pixel_data_hires";
+    results[MICRO_PIXEL_DATA_HIRES].ns_per_op = measure(options, micro_pixel_data, &chip8);
+}
+
+static void write_json_string(FILE *file, const char *string)
+{
+    fputc('"', file);
+    for(; *string != '\0'; ++string)
+    {
+        const unsigned char c = (unsigned char)*string;
+        if(c == '"' || c == '\\')
+            fprintf(file, "\\%c", c);
+        else if(c < 0x20)
+            fprintf(file, "\\u%04x", c);
+        else
+            fputc(c, file);
+    }
+    fputc('"', file);
+}
+
+static void write_json_stat(FILE *file, const char *name, const BenchStat *stat)
+{
+    fprintf(file, "\"%s\": { \"best\": %.4f, \"median\": %.4f }", name, stat->best, stat->median);
+}
+
+void write_json(FILE *file, const BenchOptions *options, const RomResult *rom_results, const ui32 num_roms, const MicroResult *micro_results, const ui32 num_micro)
+{
+    fprintf(file, "{\n");
+    fprintf(file, "  \"cycles\": %llu,\n", options->num_cycles);
+    fprintf(file, "  \"trials\": %u,\n", options->num_trials);
+    fprintf(file, "  \"warmup\": %u,\n", options->num_warmup);
+    fprintf(file, "  \"cycles_per_frame\": %u,\n", options->cycles_per_frame);
+    fprintf(file, "  \"jit\": %s,\n", options->use_jit ? "true" : "false");
+
+    fprintf(file, "  \"roms\": [\n");
+    for(ui32 i = 0; i < num_roms; ++i)
+    {
+        const RomResult *result = &rom_results[i];
+        fprintf(file, "    { \"rom\": ");
+        write_json_string(file, result->rom_file_path);
+        fprintf(file, ", ");
+        write_json_stat(file, "ns_per_instruction", &result->ns_per_instruction);
+        fprintf(file, ", ");
+        write_json_stat(file, "ns_per_cycle", &result->ns_per_cycle);
+        fprintf(file, ", ");
+        write_json_stat(file, "draws_per_second", &result->draws_per_second);
+        fprintf(file, ", ");
+        write_json_stat(file, "pixel_data_ns", &result->pixel_data_ns);
+        fprintf(file, ", \"draws\": %llu, \"idle_cycles\": %llu, \"hash\": \"%016llx\" }%s\n",
+            result->num_draws, result->num_idle_cycles, result->state_hash, i + 1 < num_roms ? "," : "");
+    }
+    fprintf(file, "  ],\n");
+
+    fprintf(file, "  \"micro\": [\n");
+    for(ui32 i = 0; i < num_micro; ++i)
+    {
+        fprintf(file, "    { \"name\": \"%s\", ", micro_results[i].name);
+        write_json_stat(file, "ns_per_op", &micro_results[i].ns_per_op);
+        fprintf(file, " }%s\n", i + 1 < num_micro ? "," : "");
+    }
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+}
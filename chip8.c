@@ -1,17 +1,77 @@
 #include "chip8.h"
+#include "chip8_ops.h"
+#include "chip8_rom.h"
 
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define C8_PIXELS_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define C8_PIXELS_SSE2 1
+#elif defined(__ARM_NEON)
+    #include <arm_neon.h>
+    #define C8_PIXELS_NEON 1
+#endif
+
+// Event ring indices, shared between the producing and the consuming thread
+#if defined(_MSC_VER) && !defined(__clang__)
+    // Volatile accesses are acquire and release with /volatile:ms, the default on x86 and x64
+    #define C8_LOAD_ACQUIRE(pointer) (*(const volatile ui32*)(pointer))
+    #define C8_STORE_RELEASE(pointer, value) (*(volatile ui32*)(pointer) = (value))
+#else
+    #define C8_LOAD_ACQUIRE(pointer) __atomic_load_n(pointer, __ATOMIC_ACQUIRE)
+    #define C8_STORE_RELEASE(pointer, value) __atomic_store_n(pointer, value, __ATOMIC_RELEASE)
+#endif
+
+#ifdef C8_PROFILE
+    #include "chip8_profile.h"
+    #if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        #include <intrin.h>
+        #define C8_PROFILE_TSC 1
+    #elif defined(__x86_64__) || defined(__i386__)
+        #include <x86intrin.h>
+        #define C8_PROFILE_TSC 1
+    #endif
+#endif
+
 void chip8_setup_fonts(Chip8 *chip8);
 
 void chip8_init(Chip8 *chip8)
 {
     memset(chip8, 0, sizeof(Chip8));
     chip8_setup_fonts(chip8);
-    srand((ui32)time(0));
+    chip8_seed(chip8, (ui64)time(0));
+    chip8->cycles_per_frame = C8_DEFAULT_CYCLES_PER_FRAME;
+}
+
+void chip8_seed(Chip8 *chip8, const ui64 seed)
+{
+    chip8->random_state = chip8_random_state_from_seed(seed);
+}
+
+ui64 chip8_random_state_from_seed(const ui64 seed)
+{
+    // splitmix64, spreads small and similar seeds over the whole state
+    ui64 state = seed + 0x9E3779B97F4A7C15ULL;
+    state = (state ^ (state >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    state = (state ^ (state >> 27)) * 0x94D049BB133111EBULL;
+    state ^= state >> 31;
+    return state != 0 ? state : 0x9E3779B97F4A7C15ULL;
+}
+
+ui8 chip8_random_byte(ui64 *random_state)
+{
+    // xorshift64*, the high byte of the product has the best quality
+    ui64 state = *random_state;
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    *random_state = state;
+    return (ui8)((state * 0x2545F4914F6CDD1DULL) >> 56);
 }
 
 void chip8_setup_fonts(Chip8 *chip8)
@@ -36,340 +96,1276 @@ void chip8_setup_fonts(Chip8 *chip8)
         { 0xF0, 0x80, 0xF0, 0x80, 0x80 }, // "F"
     };
     memcpy(chip8->memory, font_memory, C8_NUM_FONTS * C8_FONT_SIZE);
+
+    const ui8 big_font_memory[C8_NUM_FONTS][C8_BIG_FONT_SIZE] =
+    {
+        { 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF }, // "0"
+        { 0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF }, // "1"
+        { 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF }, // "2"
+        { 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF }, // "3"
+        { 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03 }, // "4"
+        { 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF }, // "5"
+        { 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF }, // "6"
+        { 0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18 }, // "7"
+        { 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF }, // "8"
+        { 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF }, // "9"
+        { 0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3 }, // "A"
+        { 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC }, // "B"
+        { 0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C }, // "C"
+        { 0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC }, // "D"
+        { 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF }, // "E"
+        { 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0 }, // "F"
+    };
+    memcpy(&chip8->memory[C8_BIG_FONT_ADDRESS], big_font_memory, C8_NUM_FONTS * C8_BIG_FONT_SIZE);
 }
 
-void chip8_load_rom(Chip8 *chip8, const char *rom_file_path)
+i32 chip8_load_rom(Chip8 *chip8, const char *rom_file_path)
 {
-    FILE *rom = NULL;
-    const i32 error = fopen_s(&rom, rom_file_path, "rb");
-    if(error != 0)
-    {
-        printf("Failed to load rom `%s`\n with error: `%ld`", rom_file_path, error);
-        return;
-    }
+    const Chip8Rom *rom = NULL;
+    const i32 status = chip8_rom_open(rom_file_path, &rom);
+    if(status == C8_LOAD_OK)
+        chip8_rom_load(chip8, rom);
+    return status;
+}
 
-    i32 data = EOF;
-    ui8 *buffer = &chip8->memory[C8_ROM_PLACEMENT];
-    ui8 *buffer_end = &chip8->memory[C8_MEMORY_SIZE];
-    while((data = fgetc(rom)) != EOF && buffer != buffer_end)
-    {
-        *buffer = (ui8)data;
-        buffer++;
-    }
+i32 chip8_load_rom_data(Chip8 *chip8, const ui8 *data, const ui32 size)
+{
+    if(size == 0)
+        return C8_LOAD_EMPTY;
+    if(size > C8_MAX_ROM_SIZE)
+        return C8_LOAD_TOO_LARGE;
 
-    fclose(rom);
+    // Clear what a previously loaded, larger rom left behind
+    memcpy(&chip8->memory[C8_ROM_PLACEMENT], data, size);
+    memset(&chip8->memory[C8_ROM_PLACEMENT + size], 0, C8_MAX_ROM_SIZE - size);
+    chip8->rom_hash = chip8_rom_hash(data, size);
+    chip8->quirks = chip8_rom_quirks(chip8->rom_hash);
 
+    memset(chip8->decoded_instructions, 0, sizeof(chip8->decoded_instructions));
+    ++chip8->code_generation;
+    chip8->code_pages_written = ~0ULL;
     chip8->program_counter = C8_ROM_PLACEMENT;
+    return C8_LOAD_OK;
 }
 
-void chip8_run_program(Chip8 *chip8, ui8 *event)
+/*
+    Instruction handlers:
+    Each handler executes one decoded instruction, advances `program_counter`
+    itself and returns the event raised by the instruction, if any. The ones
+    that depend on the quirks profile are in chip8_interpreter.inl.
+*/
+
+static ui8 chip8_op_unsupported(Chip8 *chip8, const Chip8Instruction *instruction)
 {
-    // Construct opcode
-    const ui16 opcode = chip8->memory[chip8->program_counter] << 8 | chip8->memory[chip8->program_counter + 1];
+    (void)instruction;
+    chip8->fault_opcode = chip8->memory[chip8->program_counter & (C8_MEMORY_SIZE - 1)] << 8 | chip8->memory[(chip8->program_counter + 1) & (C8_MEMORY_SIZE - 1)];
+    ++chip8->num_faults;
+    chip8->program_counter += 2;
+    return C8_EVENT_FAULT;
+}
 
-    ui8 local_event = 0;
-    ui16 add_program_counter = 2;
-    switch(opcode & 0xF000)
+// 00E0: Clear screen
+static ui8 chip8_op_cls(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    (void)instruction;
+    memset(chip8->screen_memory, 0, sizeof(chip8->screen_memory));
+    chip8->dirty_rows = 0xFFFFFFFF;
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// 00EE: Return from subroutine
+static ui8 chip8_op_ret(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    // An empty stack faults instead of reading past it
+    if(chip8->stack_pointer - 1u >= C8_NUM_STACK_LEVELS)
+        return chip8_op_unsupported(chip8, instruction);
+
+    // Return to the call instruction and step past it
+    chip8->program_counter = chip8->stack_levels[--chip8->stack_pointer] + 2;
+    return 0;
+}
+
+// 1NNN: Jump to NNN
+static ui8 chip8_op_jp(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8->program_counter = instruction->nnn;
+    return 0;
+}
+
+// 2NNN: Call subroutine at NNN
+static ui8 chip8_op_call(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    // A full stack faults instead of writing past it
+    if(chip8->stack_pointer >= C8_NUM_STACK_LEVELS)
+        return chip8_op_unsupported(chip8, instruction);
+
+    chip8->stack_levels[chip8->stack_pointer++] = chip8->program_counter;
+    chip8->program_counter = instruction->nnn;
+    return 0;
+}
+
+// 3XNN: Skip if VX == NN
+static ui8 chip8_op_se_imm(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8->program_counter += chip8->registers[instruction->x] == instruction->nn ? 4 : 2;
+    return 0;
+}
+
+// 4XNN: Skip if VX != NN
+static ui8 chip8_op_sne_imm(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8->program_counter += chip8->registers[instruction->x] != instruction->nn ? 4 : 2;
+    return 0;
+}
+
+// 5XY0: Skip if VX == VY
+static ui8 chip8_op_se_reg(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8->program_counter += chip8->registers[instruction->x] == chip8->registers[instruction->y] ? 4 : 2;
+    return 0;
+}
+
+// 6XNN: VX = NN
+static ui8 chip8_op_ld_imm(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8->registers[instruction->x] = instruction->nn;
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// 7XNN: VX += NN
+static ui8 chip8_op_add_imm(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8->registers[instruction->x] += instruction->nn;
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// 8XY0: VX = VY
+static ui8 chip8_op_ld_reg(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8_alu(0x0, &chip8->registers[instruction->x], chip8->registers[instruction->y], &chip8->registers[0xF], 0);
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// 8XY4: VX += VY, VF = carry
+static ui8 chip8_op_add_reg(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8_alu(0x4, &chip8->registers[instruction->x], chip8->registers[instruction->y], &chip8->registers[0xF], 0);
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// 8XY5: VX -= VY, VF = not borrow
+static ui8 chip8_op_sub(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8_alu(0x5, &chip8->registers[instruction->x], chip8->registers[instruction->y], &chip8->registers[0xF], 0);
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// 8XY7: VX = VY - VX, VF = not borrow
+static ui8 chip8_op_subn(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8_alu(0x7, &chip8->registers[instruction->x], chip8->registers[instruction->y], &chip8->registers[0xF], 0);
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// 9XY0: Skip if VX != VY
+static ui8 chip8_op_sne_reg(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8->program_counter += chip8->registers[instruction->x] != chip8->registers[instruction->y] ? 4 : 2;
+    return 0;
+}
+
+// ANNN: I = NNN
+static ui8 chip8_op_ld_i(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8->index_register = instruction->nnn;
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// CXNN: VX = random & NN
+static ui8 chip8_op_rnd(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    const ui8 random_value = chip8_random_byte(&chip8->random_state);
+    chip8->registers[instruction->x] = (ui8)(instruction->nn & random_value);
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// EX9E: Skip if key VX is pressed
+static ui8 chip8_op_skp(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    const ui8 key_index = chip8->registers[instruction->x];
+    chip8->program_counter += chip8->keys[key_index] == 1 ? 4 : 2;
+    return 0;
+}
+
+// EXA1: Skip if key VX is not pressed
+static ui8 chip8_op_sknp(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    const ui8 key_index = chip8->registers[instruction->x];
+    chip8->program_counter += chip8->keys[key_index] == 0 ? 4 : 2;
+    return 0;
+}
+
+// FX07: VX = delay timer
+static ui8 chip8_op_ld_vx_dt(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8->registers[instruction->x] = chip8->delay_timer;
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// FX0A: Wait for a key press, VX = key
+static ui8 chip8_op_ld_vx_k(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    for(ui8 i = 0; i < C8_NUM_KEYS; ++i)
     {
-        case 0x00:
-        {
-            const ui8 sub_opcode = opcode & 0x00FF;
-            switch(sub_opcode)
-            {
-                case 0xE0:
-                    memset(chip8->screen_memory, 0, C8_SCREEN_SIZE);
-                    break;
-                case 0xEE:
-                    chip8->program_counter = chip8->stack_levels[chip8->stack_pointer--];
-                    // `program_counter` still needs to be incremented by `add_program_counter` at end of execution
-                    break;
-                default:
-                    printf("Unsupported opcode %X\n", opcode);
-            }
-            break;
-        }
-        case 0x1000:
+        if(chip8->keys[i] == 1)
         {
-            const ui16 next_program_counter = opcode & 0x0FFF;
-            chip8->program_counter = next_program_counter;
-            add_program_counter = 0;
-            break;
+            chip8->registers[instruction->x] = i;
+            chip8->key_wait_queued = 0;
+            chip8->program_counter += 2;
+            return 0;
         }
-        case 0x2000:
+    }
+
+    // `program_counter` stays on this instruction until a key is pressed
+    return C8_EVENT_KEY_WAIT;
+}
+
+// FX15: Delay timer = VX
+static ui8 chip8_op_ld_dt_vx(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8->delay_timer = chip8->registers[instruction->x];
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// FX18: Sound timer = VX
+static ui8 chip8_op_ld_st_vx(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    const ui8 was_playing = chip8->sound_timer != 0;
+    chip8->sound_timer = chip8->registers[instruction->x];
+    chip8->program_counter += 2;
+    return (chip8->sound_timer != 0) != was_playing ? C8_EVENT_SOUND : 0;
+}
+
+// FX1E: I += VX, wrapping within memory
+static ui8 chip8_op_add_i(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8->index_register = (chip8->index_register + chip8->registers[instruction->x]) & (C8_MEMORY_SIZE - 1);
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// FX29: I = font sprite for digit VX
+static ui8 chip8_op_ld_f(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8->index_register = chip8_font_address(chip8->registers[instruction->x]);
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// FX33: Store BCD of VX at I, I + 1, I + 2
+static ui8 chip8_op_ld_b(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    ui8 digits[3];
+    chip8_bcd(chip8->registers[instruction->x], digits);
+    for(ui8 i = 0; i < 3; ++i)
+        chip8->memory[(chip8->index_register + i) & (C8_MEMORY_SIZE - 1)] = digits[i];
+    chip8_invalidate_instructions(chip8, chip8->index_register, 3);
+    chip8->program_counter += 2;
+    return 0;
+}
+
+/*
+    SCHIP screen:
+    Scrolls move whole rows with memmove and pixels within a row with word
+    shifts, hi-res rows carrying the bits that cross between their halves.
+    Scroll distances are in pixels of the current resolution. Switching
+    resolutions clears the screen.
+*/
+
+// 00CN: Scroll down N rows
+static ui8 chip8_op_scroll_down(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    const ui32 words_per_row = chip8->hires ? 2 : 1;
+    const ui32 num_words = (chip8->hires ? C8_HIRES_SCREEN_HEIGHT : C8_SCREEN_HEIGHT) * words_per_row;
+    const ui32 shift = instruction->n * words_per_row;
+    memmove(&chip8->screen_memory[shift], chip8->screen_memory, (num_words - shift) * sizeof(ui64));
+    memset(chip8->screen_memory, 0, shift * sizeof(ui64));
+    chip8->dirty_rows = 0xFFFFFFFF;
+    chip8->program_counter += 2;
+    return C8_EVENT_DRAW;
+}
+
+// 00FB: Scroll right 4 pixels
+static ui8 chip8_op_scroll_right(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    (void)instruction;
+    ui64 *screen = chip8->screen_memory;
+    if(chip8->hires)
+    {
+        for(ui32 row = 0; row < C8_HIRES_SCREEN_HEIGHT; ++row)
         {
-            const ui16 next_program_counter = opcode & 0x0FFF;
-            chip8->stack_levels[++chip8->stack_pointer] = chip8->program_counter;
-            chip8->program_counter = next_program_counter;
-            add_program_counter = 0;
-            break;
+            screen[row * 2 + 1] = screen[row * 2 + 1] >> 4 | screen[row * 2] << 60;
+            screen[row * 2] >>= 4;
         }
-        case 0x3000:
+    }
+    else
+    {
+        for(ui32 row = 0; row < C8_SCREEN_HEIGHT; ++row)
+            screen[row] >>= 4;
+    }
+    chip8->dirty_rows = 0xFFFFFFFF;
+    chip8->program_counter += 2;
+    return C8_EVENT_DRAW;
+}
+
+// 00FC: Scroll left 4 pixels
+static ui8 chip8_op_scroll_left(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    (void)instruction;
+    ui64 *screen = chip8->screen_memory;
+    if(chip8->hires)
+    {
+        for(ui32 row = 0; row < C8_HIRES_SCREEN_HEIGHT; ++row)
         {
-            const ui8 register_index = (opcode & 0x0F00) >> 8;
-            const ui8 value = opcode & 0x00FF;
-            if(chip8->registers[register_index] == value)
-                add_program_counter += 2;
-            break;
+            screen[row * 2] = screen[row * 2] << 4 | screen[row * 2 + 1] >> 60;
+            screen[row * 2 + 1] <<= 4;
         }
-        case 0x4000:
+    }
+    else
+    {
+        for(ui32 row = 0; row < C8_SCREEN_HEIGHT; ++row)
+            screen[row] <<= 4;
+    }
+    chip8->dirty_rows = 0xFFFFFFFF;
+    chip8->program_counter += 2;
+    return C8_EVENT_DRAW;
+}
+
+// 00FD: Exit, `program_counter` stays on this instruction from then on
+static ui8 chip8_op_exit(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    (void)chip8; (void)instruction;
+    return 0;
+}
+
+static void chip8_set_resolution(Chip8 *chip8, const ui8 hires)
+{
+    chip8->hires = hires;
+    memset(chip8->screen_memory, 0, sizeof(chip8->screen_memory));
+    chip8->dirty_rows = 0xFFFFFFFF;
+}
+
+// 00FE: Lo-res 64x32 screen
+static ui8 chip8_op_lores(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    (void)instruction;
+    chip8_set_resolution(chip8, 0);
+    chip8->program_counter += 2;
+    return C8_EVENT_DRAW;
+}
+
+// 00FF: Hi-res 128x64 screen
+static ui8 chip8_op_hires(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    (void)instruction;
+    chip8_set_resolution(chip8, 1);
+    chip8->program_counter += 2;
+    return C8_EVENT_DRAW;
+}
+
+// FX30: I = big font sprite for digit VX
+static ui8 chip8_op_ld_hf(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8->index_register = C8_BIG_FONT_ADDRESS + (chip8->registers[instruction->x] & 0xF) * C8_BIG_FONT_SIZE;
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// FX75: Store V0..VX in the flag registers
+static ui8 chip8_op_ld_r_vx(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    memcpy(chip8->flag_registers, chip8->registers, instruction->x + 1);
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// FX85: Load V0..VX from the flag registers
+static ui8 chip8_op_ld_vx_r(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    memcpy(chip8->registers, chip8->flag_registers, instruction->x + 1);
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// Shifts a hi-res row, `left` holding its leftmost pixels, by up to 127 pixels
+static inline void chip8_shift_row_right(ui64 *left, ui64 *right, const ui32 shift)
+{
+    if(shift >= 64)
+    {
+        *right = *left >> (shift - 64);
+        *left = 0;
+    }
+    else if(shift != 0)
+    {
+        *right = *right >> shift | *left << (64 - shift);
+        *left >>= shift;
+    }
+}
+
+static inline void chip8_shift_row_left(ui64 *left, ui64 *right, const ui32 shift)
+{
+    if(shift >= 64)
+    {
+        *left = *right << (shift - 64);
+        *right = 0;
+    }
+    else if(shift != 0)
+    {
+        *left = *left << shift | *right >> (64 - shift);
+        *right <<= shift;
+    }
+}
+
+/*
+    SCHIP sprites:
+    DXY0 draws 16x16 sprites of two bytes per row in both resolutions, and
+    every sprite drawn in hi-res lands on the 128x64 screen. Like in lo-res
+    VF is set on any collision rather than to the number of rows that hit.
+*/
+static ui8 chip8_draw_extended(Chip8 *chip8, const Chip8Instruction *instruction, const ui8 clip)
+{
+    const ui8 hires = chip8->hires;
+    const ui32 screen_width = hires ? C8_HIRES_SCREEN_WIDTH : C8_SCREEN_WIDTH;
+    const ui32 screen_height = hires ? C8_HIRES_SCREEN_HEIGHT : C8_SCREEN_HEIGHT;
+    const ui32 sprite_width = instruction->n == 0 ? 16 : 8;
+    const ui32 screen_position_x = chip8->registers[instruction->x] % screen_width;
+    const ui32 screen_position_y = chip8->registers[instruction->y] % screen_height;
+
+    ui32 sprite_height = instruction->n == 0 ? 16 : instruction->n;
+    if(clip && sprite_height > screen_height - screen_position_y)
+        sprite_height = screen_height - screen_position_y;
+
+    ui64 collision = 0;
+    ui32 dirty_rows = 0;
+    for(ui32 y = 0; y < sprite_height; ++y)
+    {
+        const ui32 screen_row = (screen_position_y + y) % screen_height;
+        const ui16 sprite_address = chip8->index_register + y * (sprite_width / 8);
+        ui64 sprite_row = chip8->memory[sprite_address & (C8_MEMORY_SIZE - 1)];
+        if(sprite_width == 16)
+            sprite_row = sprite_row << 8 | chip8->memory[(sprite_address + 1) & (C8_MEMORY_SIZE - 1)];
+        sprite_row <<= 64 - sprite_width;
+
+        if(hires)
         {
-            const ui8 register_index = (opcode & 0x0F00) >> 8;
-            const ui8 value = opcode & 0x00FF;
-            if(chip8->registers[register_index] != value)
-                add_program_counter += 2;
-            break;
+            ui64 left = sprite_row, right = 0;
+            chip8_shift_row_right(&left, &right, screen_position_x);
+            if(!clip && screen_position_x != 0)
+            {
+                ui64 wrapped_left = sprite_row, wrapped_right = 0;
+                chip8_shift_row_left(&wrapped_left, &wrapped_right, C8_HIRES_SCREEN_WIDTH - screen_position_x);
+                left |= wrapped_left;
+                right |= wrapped_right;
+            }
+
+            ui64 *screen = &chip8->screen_memory[screen_row * 2];
+            collision |= (screen[0] & left) | (screen[1] & right);
+            screen[0] ^= left;
+            screen[1] ^= right;
+            dirty_rows |= (ui32)((left | right) != 0) << (screen_row / 2);
         }
-        case 0x5000:
+        else
         {
-            const ui8 register_index_x = (opcode & 0x0F00) >> 8;
-            const ui8 register_index_y = (opcode & 0x00F0) >> 4;
-            if(chip8->registers[register_index_x] == chip8->registers[register_index_y])
-                add_program_counter += 2;
-            break;
+            ui64 sprite_pixels = sprite_row >> screen_position_x;
+            if(!clip)
+                sprite_pixels |= sprite_row << ((C8_SCREEN_WIDTH - screen_position_x) % C8_SCREEN_WIDTH);
+
+            collision |= chip8->screen_memory[screen_row] & sprite_pixels;
+            chip8->screen_memory[screen_row] ^= sprite_pixels;
+            dirty_rows |= (ui32)(sprite_pixels != 0) << screen_row;
         }
-        case 0x6000:
+    }
+
+    chip8->registers[0xF] = collision != 0;
+    chip8->dirty_rows |= dirty_rows;
+
+#ifdef C8_PROFILE
+    if(chip8->profile != NULL)
+    {
+        ++chip8->profile->num_draws;
+        chip8->profile->num_collisions += collision != 0;
+    }
+#endif
+
+    chip8->program_counter += 2;
+    return C8_EVENT_DRAW;
+}
+
+/*
+    Opcode table:
+    Every decodable instruction class and its handler. Expanded into the op
+    enum and, once per quirks profile, into the handler table and the
+    dispatch loop. `C8_QUIRKS_NAME` handlers have a copy per profile.
+*/
+#define C8_OPS(OP) \
+    OP(UNSUPPORTED, chip8_op_unsupported) \
+    OP(CLS, chip8_op_cls) \
+    OP(RET, chip8_op_ret) \
+    OP(JP, chip8_op_jp) \
+    OP(CALL, chip8_op_call) \
+    OP(SE_IMM, chip8_op_se_imm) \
+    OP(SNE_IMM, chip8_op_sne_imm) \
+    OP(SE_REG, chip8_op_se_reg) \
+    OP(LD_IMM, chip8_op_ld_imm) \
+    OP(ADD_IMM, chip8_op_add_imm) \
+    OP(LD_REG, chip8_op_ld_reg) \
+    OP(OR, C8_QUIRKS_NAME(chip8_op_or)) \
+    OP(AND, C8_QUIRKS_NAME(chip8_op_and)) \
+    OP(XOR, C8_QUIRKS_NAME(chip8_op_xor)) \
+    OP(ADD_REG, chip8_op_add_reg) \
+    OP(SUB, chip8_op_sub) \
+    OP(SHR, C8_QUIRKS_NAME(chip8_op_shr)) \
+    OP(SUBN, chip8_op_subn) \
+    OP(SHL, C8_QUIRKS_NAME(chip8_op_shl)) \
+    OP(SNE_REG, chip8_op_sne_reg) \
+    OP(LD_I, chip8_op_ld_i) \
+    OP(JP_OFFSET, C8_QUIRKS_NAME(chip8_op_jp_offset)) \
+    OP(RND, chip8_op_rnd) \
+    OP(DRW, C8_QUIRKS_NAME(chip8_op_drw)) \
+    OP(SKP, chip8_op_skp) \
+    OP(SKNP, chip8_op_sknp) \
+    OP(LD_VX_DT, chip8_op_ld_vx_dt) \
+    OP(LD_VX_K, chip8_op_ld_vx_k) \
+    OP(LD_DT_VX, chip8_op_ld_dt_vx) \
+    OP(LD_ST_VX, chip8_op_ld_st_vx) \
+    OP(ADD_I, chip8_op_add_i) \
+    OP(LD_F, chip8_op_ld_f) \
+    OP(LD_B, chip8_op_ld_b) \
+    OP(LD_STORE, C8_QUIRKS_NAME(chip8_op_ld_store)) \
+    OP(LD_LOAD, C8_QUIRKS_NAME(chip8_op_ld_load)) \
+    OP(SCD, chip8_op_scroll_down) \
+    OP(SCR, chip8_op_scroll_right) \
+    OP(SCL, chip8_op_scroll_left) \
+    OP(EXIT, chip8_op_exit) \
+    OP(LOW, chip8_op_lores) \
+    OP(HIGH, chip8_op_hires) \
+    OP(LD_HF, chip8_op_ld_hf) \
+    OP(LD_R_VX, chip8_op_ld_r_vx) \
+    OP(LD_VX_R, chip8_op_ld_vx_r)
+
+#define C8_OP_ENUM(name, handler) C8_OP_##name,
+enum
+{
+    C8_OPS(C8_OP_ENUM)
+    C8_NUM_OPS
+};
+#undef C8_OP_ENUM
+
+#define C8_OP_NAME(name, handler) #name,
+static const char *const C8_OP_NAMES[C8_NUM_OPS] = { C8_OPS(C8_OP_NAME) };
+#undef C8_OP_NAME
+
+const char *chip8_op_name(const ui8 op)
+{
+    return op < C8_NUM_OPS ? C8_OP_NAMES[op] : NULL;
+}
+
+/*
+    Profiling hooks:
+    With `C8_PROFILE` every instruction run by the interpreter is counted
+    by opcode class and address, and timed around its handler. Without it
+    the hooks expand to nothing.
+*/
+#ifdef C8_PROFILE
+_Static_assert((ui32)C8_NUM_OPS <= (ui32)C8_PROFILE_MAX_OPS, "Chip8Profile has too few opcode classes");
+
+static inline ui64 chip8_profile_ticks(void)
+{
+#if defined(C8_PROFILE_TSC)
+    return __rdtsc();
+#else
+    struct timespec time_now;
+    timespec_get(&time_now, TIME_UTC);
+    return (ui64)time_now.tv_sec * 1000000000ULL + (ui64)time_now.tv_nsec;
+#endif
+}
+
+static inline ui64 chip8_profile_enter(Chip8 *chip8, const ui8 op)
+{
+    Chip8Profile *profile = chip8->profile;
+    if(profile == NULL)
+        return 0;
+
+    const ui16 address = chip8->program_counter & (C8_MEMORY_SIZE - 1);
+    ++profile->op_counts[op];
+    ++profile->pc_hits[address];
+    profile->pc_ops[address] = op;
+    return chip8_profile_ticks();
+}
+
+static inline void chip8_profile_leave(Chip8 *chip8, const ui8 op, const ui64 start_ticks)
+{
+    if(chip8->profile != NULL)
+        chip8->profile->op_ticks[op] += chip8_profile_ticks() - start_ticks;
+}
+
+    #define C8_PROFILE_ENTER(op) profile_ticks = chip8_profile_enter(chip8, op)
+    #define C8_PROFILE_LEAVE(op) chip8_profile_leave(chip8, op, profile_ticks)
+#else
+    #define C8_PROFILE_ENTER(op) (void)0
+    #define C8_PROFILE_LEAVE(op) (void)0
+#endif
+
+// Handler table of a quirks profile, the tables follow the dispatch loops
+static const Chip8Handler *chip8_quirks_handlers(const ui8 quirks);
+
+static ui8 chip8_decode_op(const ui16 opcode)
+{
+    switch(opcode & 0xF000)
+    {
+        case 0x0000:
+            switch(opcode & 0x00FF)
+            {
+                case 0xE0: return C8_OP_CLS;
+                case 0xEE: return C8_OP_RET;
+                case 0xFB: return C8_OP_SCR;
+                case 0xFC: return C8_OP_SCL;
+                case 0xFD: return C8_OP_EXIT;
+                case 0xFE: return C8_OP_LOW;
+                case 0xFF: return C8_OP_HIGH;
+                default: return (opcode & 0x00F0) == 0xC0 ? C8_OP_SCD : C8_OP_UNSUPPORTED;
+            }
+        case 0x1000: return C8_OP_JP;
+        case 0x2000: return C8_OP_CALL;
+        case 0x3000: return C8_OP_SE_IMM;
+        case 0x4000: return C8_OP_SNE_IMM;
+        case 0x5000: return C8_OP_SE_REG;
+        case 0x6000: return C8_OP_LD_IMM;
+        case 0x7000: return C8_OP_ADD_IMM;
+        case 0x8000:
+            switch(opcode & 0x000F)
+            {
+                case 0x0: return C8_OP_LD_REG;
+                case 0x1: return C8_OP_OR;
+                case 0x2: return C8_OP_AND;
+                case 0x3: return C8_OP_XOR;
+                case 0x4: return C8_OP_ADD_REG;
+                case 0x5: return C8_OP_SUB;
+                case 0x6: return C8_OP_SHR;
+                case 0x7: return C8_OP_SUBN;
+                case 0xE: return C8_OP_SHL;
+                default: return C8_OP_UNSUPPORTED;
+            }
+        case 0x9000: return C8_OP_SNE_REG;
+        case 0xA000: return C8_OP_LD_I;
+        case 0xB000: return C8_OP_JP_OFFSET;
+        case 0xC000: return C8_OP_RND;
+        case 0xD000: return C8_OP_DRW;
+        case 0xE000:
+            switch(opcode & 0x00FF)
+            {
+                case 0x9E: return C8_OP_SKP;
+                case 0xA1: return C8_OP_SKNP;
+                default: return C8_OP_UNSUPPORTED;
+            }
+        case 0xF000:
+            switch(opcode & 0x00FF)
+            {
+                case 0x07: return C8_OP_LD_VX_DT;
+                case 0x0A: return C8_OP_LD_VX_K;
+                case 0x15: return C8_OP_LD_DT_VX;
+                case 0x18: return C8_OP_LD_ST_VX;
+                case 0x1E: return C8_OP_ADD_I;
+                case 0x29: return C8_OP_LD_F;
+                case 0x30: return C8_OP_LD_HF;
+                case 0x33: return C8_OP_LD_B;
+                case 0x55: return C8_OP_LD_STORE;
+                case 0x65: return C8_OP_LD_LOAD;
+                case 0x75: return C8_OP_LD_R_VX;
+                case 0x85: return C8_OP_LD_VX_R;
+                default: return C8_OP_UNSUPPORTED;
+            }
+    }
+    return C8_OP_UNSUPPORTED;
+}
+
+void chip8_decode_instruction(const Chip8 *chip8, const ui16 address, Chip8Instruction *instruction)
+{
+    // Construct opcode
+    const ui16 opcode = chip8->memory[address & (C8_MEMORY_SIZE - 1)] << 8 | chip8->memory[(address + 1) & (C8_MEMORY_SIZE - 1)];
+
+    const ui8 op = chip8_decode_op(opcode);
+    instruction->handler = chip8_quirks_handlers(chip8->quirks)[op];
+    instruction->op = op;
+    instruction->nnn = opcode & 0x0FFF;
+    instruction->x = (opcode & 0x0F00) >> 8;
+    instruction->y = (opcode & 0x00F0) >> 4;
+    instruction->n = opcode & 0x000F;
+    instruction->nn = opcode & 0x00FF;
+}
+
+void chip8_invalidate_instructions(Chip8 *chip8, const ui16 address, const ui16 size)
+{
+    if(size == 0)
+        return;
+
+    // A decoded instruction at even address `a` covers the bytes `a` and `a + 1`
+    const ui16 first = (address & (C8_MEMORY_SIZE - 1)) >> 1;
+    const ui16 last = ((address + size - 1) & (C8_MEMORY_SIZE - 1)) >> 1;
+    ui8 overwritten_code = 0;
+    for(ui16 i = first; ; i = (i + 1) % C8_NUM_DECODED_INSTRUCTIONS)
+    {
+        if(chip8->decoded_instructions[i].handler != NULL)
         {
-            const ui8 register_index = (opcode & 0x0F00) >> 8;
-            const ui8 value = opcode & 0x00FF;
-            chip8->registers[register_index] = value;
-            break;
+            chip8->decoded_instructions[i].handler = NULL;
+            chip8->code_pages_written |= 1ULL << (i * 2 / C8_CODE_PAGE_SIZE);
+            overwritten_code = 1;
         }
-        case 0x7000:
-        {
-            const ui8 register_index = (opcode & 0x0F00) >> 8;
-            const ui8 value = opcode & 0x00FF;
-            chip8->registers[register_index] += value;
+
+        if(i == last)
             break;
-        }
-        case 0x8000:
+    }
+
+    if(overwritten_code)
+        ++chip8->code_generation;
+}
+
+static inline const Chip8Instruction *chip8_peek_instruction(Chip8 *chip8, const ui16 address, Chip8Instruction *storage)
+{
+    if((address & 1) == 0)
+    {
+        // Only instructions at even addresses are cached
+        Chip8Instruction *decoded = &chip8->decoded_instructions[(address & (C8_MEMORY_SIZE - 1)) >> 1];
+        if(decoded->handler == NULL)
+            chip8_decode_instruction(chip8, address, decoded);
+        return decoded;
+    }
+
+    chip8_decode_instruction(chip8, address, storage);
+    return storage;
+}
+
+static inline const Chip8Instruction *chip8_fetch_instruction(Chip8 *chip8, Chip8Instruction *storage)
+{
+    return chip8_peek_instruction(chip8, chip8->program_counter, storage);
+}
+
+/*
+    Idle loops:
+    ROMs wait for the delay timer with `FX07, 3X00, 1NNN` jumping back to
+    the FX07, and for input with FX0A. Neither can end before the next
+    timer tick or new input, so up to `max_cycles` of the wait are skipped
+    at once. Returns the number of cycles skipped, which always leaves the
+    instance exactly where running the loop would have, and 0 when the
+    instruction at `program_counter` is not such a wait.
+*/
+static inline ui32 chip8_idle_cycles(Chip8 *chip8, const Chip8Instruction *instruction, const ui32 max_cycles)
+{
+    if(instruction->op == C8_OP_LD_VX_K)
+    {
+        for(ui8 i = 0; i < C8_NUM_KEYS; ++i)
         {
-            const ui8 register_index_x = (opcode & 0x0F00) >> 8;
-            const ui8 register_index_y = (opcode & 0x00F0) >> 4;
-            const ui8 sub_opcode = opcode & 0x000F;
-            switch(sub_opcode)
-            {
-                case 0x0:
-                    chip8->registers[register_index_x] = chip8->registers[register_index_y];
-                    break;
-                case 0x1:
-                    chip8->registers[register_index_x] |= chip8->registers[register_index_y];
-                    break;
-                case 0x2:
-                    chip8->registers[register_index_x] &= chip8->registers[register_index_y];
-                    break;
-                case 0x3:
-                    chip8->registers[register_index_x] ^= chip8->registers[register_index_y];
-                    break;
-                case 0x4:
-                {
-                    const ui16 value = chip8->registers[register_index_x] + chip8->registers[register_index_y];
-                    chip8->registers[0xF] = value > 0xFF ? 1 : 0;
-                    chip8->registers[register_index_x] = value & 0x00FF;
-                    break;
-                }
-                case 0x5:
-                {
-                    const ui8 value_x = chip8->registers[register_index_x];
-                    const ui8 value_y = chip8->registers[register_index_y];
-                    chip8->registers[0xF] = value_x > value_y ? 1 : 0;
-                    chip8->registers[register_index_x] = value_x - value_y;
-                    break;
-                }
-                case 0x6:
-                {
-                    const ui8 value = chip8->registers[register_index_x];
-                    chip8->registers[0xF] = value & 0x1;
-                    chip8->registers[register_index_x] = value >> 1;
-                    break;
-                }
-                case 0x7:
-                {
-                    const ui8 value_x = chip8->registers[register_index_x];
-                    const ui8 value_y = chip8->registers[register_index_y];
-                    chip8->registers[0xF] = value_y > value_x ? 1 : 0;
-                    chip8->registers[register_index_x] = value_y - value_x;
-                    break;
-                }
-                case 0xE:
-                {
-                    const ui8 value = chip8->registers[register_index_x];
-                    chip8->registers[0xF] = value >> 7;
-                    chip8->registers[register_index_x] = value << 1;
-                    break;
-                }
-                default:
-                    printf("Unsupported opcode %X\n", opcode);
-            }  
-            break;
+            if(chip8->keys[i] == 1)
+                return 0;
         }
-        case 0x9000:
+        return max_cycles;
+    }
+
+    // Skips whole iterations only, the loop is back on its FX07 afterwards
+    if(instruction->op != C8_OP_LD_VX_DT || chip8->delay_timer == 0 || max_cycles < 3)
+        return 0;
+
+    Chip8Instruction storage;
+    const ui16 loop_address = chip8->program_counter;
+    const Chip8Instruction *skip = chip8_peek_instruction(chip8, loop_address + 2, &storage);
+    if(skip->op != C8_OP_SE_IMM || skip->x != instruction->x || skip->nn != 0)
+        return 0;
+    const Chip8Instruction *jump = chip8_peek_instruction(chip8, loop_address + 4, &storage);
+    if(jump->op != C8_OP_JP || jump->nnn != loop_address)
+        return 0;
+
+    chip8->registers[instruction->x] = chip8->delay_timer;
+    return max_cycles - max_cycles % 3;
+}
+
+/*
+    Event ring producer:
+    The run functions queue the events of an instruction once it finished,
+    stamped with the cycle it started at. Timer ticks queue the end of a
+    sound themselves.
+*/
+static inline void chip8_queue_event(Chip8 *chip8, const ui8 type, const ui64 cycle, const ui32 data)
+{
+    // Only this thread writes `event_head`
+    const ui32 head = chip8->event_head;
+    if(head - C8_LOAD_ACQUIRE(&chip8->event_tail) == C8_EVENT_RING_SIZE)
+    {
+        ++chip8->num_dropped_events;
+        return;
+    }
+
+    Chip8Event *event = &chip8->events[head & (C8_EVENT_RING_SIZE - 1)];
+    event->cycle = cycle;
+    event->data = data;
+    event->type = type;
+    C8_STORE_RELEASE(&chip8->event_head, head + 1);
+}
+
+static inline void chip8_queue_events(Chip8 *chip8, const ui32 events, const ui64 cycle)
+{
+    if(events & C8_EVENT_DRAW)
+        chip8_queue_event(chip8, C8_EVENT_TYPE_DRAW, cycle, chip8->dirty_rows);
+    if(events & C8_EVENT_SOUND)
+        chip8_queue_event(chip8, chip8->sound_timer != 0 ? C8_EVENT_TYPE_SOUND_ON : C8_EVENT_TYPE_SOUND_OFF, cycle, chip8->sound_timer);
+    if((events & C8_EVENT_KEY_WAIT) && !chip8->key_wait_queued)
+    {
+        // FX0A re-runs until a key is pressed, only the start of the wait is queued
+        chip8->key_wait_queued = 1;
+        chip8_queue_event(chip8, C8_EVENT_TYPE_KEY_WAIT, cycle, chip8->memory[chip8->program_counter & (C8_MEMORY_SIZE - 1)] & 0x0F);
+    }
+    if(events & C8_EVENT_FAULT)
+        chip8_queue_event(chip8, C8_EVENT_TYPE_FAULT, cycle, chip8->fault_opcode);
+}
+
+ui8 chip8_poll_event(Chip8 *chip8, Chip8Event *event)
+{
+    // Only this thread writes `event_tail`
+    const ui32 tail = chip8->event_tail;
+    if(tail == C8_LOAD_ACQUIRE(&chip8->event_head))
+        return 0;
+
+    *event = chip8->events[tail & (C8_EVENT_RING_SIZE - 1)];
+    C8_STORE_RELEASE(&chip8->event_tail, tail + 1);
+    return 1;
+}
+
+void chip8_run_program(Chip8 *chip8, ui8 *event)
+{
+    Chip8Instruction instruction_storage;
+    const Chip8Instruction *instruction = chip8_fetch_instruction(chip8, &instruction_storage);
+
+#ifdef C8_PROFILE
+    ui64 profile_ticks = 0;
+#endif
+    C8_PROFILE_ENTER(instruction->op);
+    const ui8 local_event = instruction->handler(chip8, instruction);
+    C8_PROFILE_LEAVE(instruction->op);
+
+    // The clock is advanced by the caller, `cycle_count` is still this instruction's
+    if(local_event != 0)
+        chip8_queue_events(chip8, local_event, chip8->cycle_count);
+
+    if(event)
+        *event = local_event;
+}
+
+#if !defined(C8_NO_THREADED_DISPATCH) && (defined(__GNUC__) || defined(__clang__))
+    #define C8_THREADED_DISPATCH 1
+#else
+    #define C8_THREADED_DISPATCH 0
+#endif
+
+static inline void chip8_clock_tick(Chip8 *chip8, const ui32 num_cycles)
+{
+    chip8->cycle_count += num_cycles;
+    chip8->frame_cycles += num_cycles;
+    while(chip8->frame_cycles >= chip8->cycles_per_frame)
+    {
+        chip8->frame_cycles -= chip8->cycles_per_frame;
+        chip8_update_timers(chip8);
+    }
+}
+
+/*
+    Quirks profiles:
+    Each profile gets its own copy of the quirk dependent handlers, of the
+    handler table and of the dispatch loop, see chip8_interpreter.inl.
+    Instances only pick the copy once per run.
+*/
+// Shifts VX, FX55/FX65 keep I, BNNN adds V0 and sprites wrap
+#define C8_QUIRKS_DEFAULT_FLAGS 0
+// The original COSMAC VIP interpreter
+#define C8_QUIRKS_COSMAC_FLAGS (C8_QUIRK_SHIFT_VY | C8_QUIRK_LOAD_STORE_INCREMENT | C8_QUIRK_CLIP | C8_QUIRK_VF_RESET)
+// SUPER-CHIP 1.1 on the HP 48
+#define C8_QUIRKS_SCHIP_FLAGS (C8_QUIRK_JUMP_VX | C8_QUIRK_CLIP)
+
+static const ui32 C8_QUIRKS_FLAGS[C8_NUM_QUIRKS] =
+{
+    [C8_QUIRKS_DEFAULT] = C8_QUIRKS_DEFAULT_FLAGS,
+    [C8_QUIRKS_COSMAC] = C8_QUIRKS_COSMAC_FLAGS,
+    [C8_QUIRKS_SCHIP] = C8_QUIRKS_SCHIP_FLAGS,
+};
+
+static const char *const C8_QUIRKS_NAMES[C8_NUM_QUIRKS] =
+{
+    [C8_QUIRKS_DEFAULT] = "default",
+    [C8_QUIRKS_COSMAC] = "cosmac",
+    [C8_QUIRKS_SCHIP] = "schip",
+};
+
+#define C8_QUIRKS_CONCAT(name, suffix) name##_##suffix
+#define C8_QUIRKS_EXPAND(name, suffix) C8_QUIRKS_CONCAT(name, suffix)
+#define C8_QUIRKS_NAME(name) C8_QUIRKS_EXPAND(name, C8_QUIRKS_SUFFIX)
+
+#define C8_QUIRKS_SUFFIX default
+#define C8_QUIRKS C8_QUIRKS_DEFAULT_FLAGS
+#include "chip8_interpreter.inl"
+#undef C8_QUIRKS
+#undef C8_QUIRKS_SUFFIX
+
+#define C8_QUIRKS_SUFFIX cosmac
+#define C8_QUIRKS C8_QUIRKS_COSMAC_FLAGS
+#include "chip8_interpreter.inl"
+#undef C8_QUIRKS
+#undef C8_QUIRKS_SUFFIX
+
+#define C8_QUIRKS_SUFFIX schip
+#define C8_QUIRKS C8_QUIRKS_SCHIP_FLAGS
+#include "chip8_interpreter.inl"
+#undef C8_QUIRKS
+#undef C8_QUIRKS_SUFFIX
+
+#undef C8_QUIRKS_NAME
+
+static const Chip8Handler *const C8_QUIRKS_HANDLERS[C8_NUM_QUIRKS] =
+{
+    [C8_QUIRKS_DEFAULT] = C8_HANDLERS_default,
+    [C8_QUIRKS_COSMAC] = C8_HANDLERS_cosmac,
+    [C8_QUIRKS_SCHIP] = C8_HANDLERS_schip,
+};
+
+typedef ui32 (*Chip8RunCycles)(Chip8 *chip8, const ui32 max_cycles, ui32 *events_out);
+static const Chip8RunCycles C8_QUIRKS_RUN_CYCLES[C8_NUM_QUIRKS] =
+{
+    [C8_QUIRKS_DEFAULT] = chip8_run_cycles_default,
+    [C8_QUIRKS_COSMAC] = chip8_run_cycles_cosmac,
+    [C8_QUIRKS_SCHIP] = chip8_run_cycles_schip,
+};
+
+static const Chip8Handler *chip8_quirks_handlers(const ui8 quirks)
+{
+    return C8_QUIRKS_HANDLERS[quirks];
+}
+
+ui32 chip8_run_cycles(Chip8 *chip8, const ui32 max_cycles, ui32 *events_out)
+{
+    return C8_QUIRKS_RUN_CYCLES[chip8->quirks](chip8, max_cycles, events_out);
+}
+
+void chip8_set_quirks(Chip8 *chip8, const ui8 quirks)
+{
+    const ui8 new_quirks = quirks < C8_NUM_QUIRKS ? quirks : C8_QUIRKS_DEFAULT;
+    if(new_quirks == chip8->quirks)
+        return;
+
+    // Decoded instructions point at the handlers of the old profile
+    chip8->quirks = new_quirks;
+    memset(chip8->decoded_instructions, 0, sizeof(chip8->decoded_instructions));
+    ++chip8->code_generation;
+    chip8->code_pages_written = ~0ULL;
+}
+
+ui32 chip8_quirks_flags(const ui8 quirks)
+{
+    return quirks < C8_NUM_QUIRKS ? C8_QUIRKS_FLAGS[quirks] : 0;
+}
+
+const char *chip8_quirks_name(const ui8 quirks)
+{
+    return quirks < C8_NUM_QUIRKS ? C8_QUIRKS_NAMES[quirks] : NULL;
+}
+
+
+ui64 chip8_run_frames(Chip8 *chip8, const ui32 num_frames, ui32 *events_out)
+{
+    ui64 num_cycles = 0;
+    ui32 events = 0;
+    for(ui32 frame = 0; frame < num_frames; ++frame)
+    {
+        ui32 frame_cycles = chip8_cycles_to_frame(chip8);
+        while(frame_cycles > 0)
         {
-            const ui8 register_index_x = (opcode & 0x0F00) >> 8;
-            const ui8 register_index_y = (opcode & 0x00F0) >> 4;
-            if(chip8->registers[register_index_x] != chip8->registers[register_index_y])
-                add_program_counter += 2;
-            break;
+            ui32 event = 0;
+            const ui32 run_cycles = chip8_run_cycles(chip8, frame_cycles, &event);
+            frame_cycles -= run_cycles;
+            num_cycles += run_cycles;
+            events |= event;
         }
-        case 0xA000:
-            chip8->index_register = (opcode & 0x0FFF);
-            break;
-        case 0xB000:
-            const ui16 next_program_counter = (opcode & 0x0FFF) + chip8->registers[0];
-            chip8->program_counter = next_program_counter;
-            add_program_counter = 0;
-            break;
-        case 0xC000:
+    }
+
+    if(events_out)
+        *events_out = events;
+
+    return num_cycles;
+}
+
+void chip8_set_cycles_per_frame(Chip8 *chip8, const ui32 cycles_per_frame)
+{
+    chip8->cycles_per_frame = cycles_per_frame != 0 ? cycles_per_frame : 1;
+    if(chip8->frame_cycles >= chip8->cycles_per_frame)
+        chip8->frame_cycles = 0;
+}
+
+ui32 chip8_cycles_to_frame(const Chip8 *chip8)
+{
+    return chip8->cycles_per_frame - chip8->frame_cycles;
+}
+
+void chip8_advance_clock(Chip8 *chip8, const ui32 num_cycles)
+{
+    chip8_clock_tick(chip8, num_cycles);
+}
+
+ui32 chip8_skip_idle(Chip8 *chip8, const ui32 max_cycles, ui32 *events_out)
+{
+    const ui32 cycles_to_frame = chip8_cycles_to_frame(chip8);
+    Chip8Instruction instruction_storage;
+    const Chip8Instruction *instruction = chip8_fetch_instruction(chip8, &instruction_storage);
+    const ui32 idle_cycles = chip8_idle_cycles(chip8, instruction, max_cycles < cycles_to_frame ? max_cycles : cycles_to_frame);
+    if(idle_cycles == 0)
+        return 0;
+
+    const ui32 events = instruction->op == C8_OP_LD_VX_K ? C8_EVENT_KEY_WAIT : 0;
+    if(events != 0)
+        chip8_queue_events(chip8, events, chip8->cycle_count);
+
+    chip8->idle_cycles_skipped += idle_cycles;
+    chip8_clock_tick(chip8, idle_cycles);
+    if(events_out)
+        *events_out = events;
+    return idle_cycles;
+}
+
+void chip8_update_timers(Chip8 *chip8)
+{
+    if(chip8_tick_timers(&chip8->delay_timer, &chip8->sound_timer))
+        chip8_queue_event(chip8, C8_EVENT_TYPE_SOUND_OFF, chip8->cycle_count, 0);
+}
+
+void chip8_feed_input(Chip8 *chip8, const Chip8InputKey *keys, const ui8 num_keys)
+{
+    if(keys == NULL || num_keys == 0)
+        return;
+    
+    for(ui8 i = 0; i < num_keys && i < C8_NUM_KEYS; ++i)
+        chip8->keys[keys[i].key_index] = keys[i].key_state;
+}
+
+/*
+    Framebuffer expansion kernels:
+    Turn `num_words` 64-bit screen words into one byte (0 or 1) or one 32-bit
+    palette color per pixel, most significant bit first. Words are read as
+    they are stored, the leftmost pixels are in the highest byte, which is
+    the last one in memory on the little-endian hosts these kernels target.
+*/
+
+#if C8_PIXELS_AVX2
+
+static void chip8_expand_pixels(const ui64 *rows, ui8 *pixels, const ui16 num_words)
+{
+    // Each 128-bit lane replicates two bytes of the word eight times, highest byte first
+    const __m256i replicate[2] =
+    {
+        _mm256_setr_epi8(
+            7, 7, 7, 7, 7, 7, 7, 7, 6, 6, 6, 6, 6, 6, 6, 6,
+            5, 5, 5, 5, 5, 5, 5, 5, 4, 4, 4, 4, 4, 4, 4, 4),
+        _mm256_setr_epi8(
+            3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2,
+            1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0),
+    };
+    const __m256i bits = _mm256_set1_epi64x(0x0102040810204080LL);
+    const __m256i ones = _mm256_set1_epi8(1);
+
+    for(ui16 word = 0; word < num_words; ++word)
+    {
+        const __m256i broadcast = _mm256_set1_epi64x((long long)rows[word]);
+        for(ui8 half = 0; half < 2; ++half)
         {
-            const ui8 register_index = (opcode & 0x0F00) >> 8;
-            const ui8 value = opcode & 0x00FF;
-            const ui8 random_value = rand() % 0xFF;
-            chip8->registers[register_index] = (ui8)(value & random_value);
-            break;
+            const __m256i bytes = _mm256_shuffle_epi8(broadcast, replicate[half]);
+            const __m256i set = _mm256_cmpeq_epi8(_mm256_and_si256(bytes, bits), bits);
+            _mm256_storeu_si256((__m256i*)&pixels[word * 64 + half * 32], _mm256_and_si256(set, ones));
         }
-        case 0xD000:
+    }
+}
+
+static void chip8_expand_pixels_palette(const ui64 *rows, ui32 *pixels, const ui16 num_words, const ui32 palette[2])
+{
+    const __m256i bits = _mm256_setr_epi32((int)0x80000000, 0x40000000, 0x20000000, 0x10000000, 0x08000000, 0x04000000, 0x02000000, 0x01000000);
+    const __m256i off = _mm256_set1_epi32((int)palette[0]);
+    const __m256i on = _mm256_set1_epi32((int)palette[1]);
+
+    for(ui16 word = 0; word < num_words; ++word)
+    {
+        for(ui8 half = 0; half < 2; ++half)
         {
-            const ui8 screen_position_x = chip8->registers[(opcode & 0x0F00) >> 8];
-            const ui8 screen_position_y = chip8->registers[(opcode & 0x00F0) >> 4];
-            const ui8 sprite_height = (ui8)(opcode & 0x000F);
-            const ui8 *sprite = &chip8->memory[chip8->index_register];
-
-            local_event = C8_EVENT_DRAW;
-
-            // Clear collision
-            chip8->registers[0xF] = 0;
-     
-            const ui8 sprite_offset_bits = screen_position_x & 0x7;
-            for(ui8 y = 0; y < sprite_height; ++y)
+            // Every byte of the half is shifted to the top in turn
+            __m256i data = _mm256_set1_epi32((int)(ui32)(rows[word] >> (32 - half * 32)));
+            for(ui8 byte = 0; byte < 4; ++byte)
             {
-                const ui8 screen_index_y = (screen_position_y + y) * C8_SCREEN_WIDTH_SIZE;
+                const __m256i set = _mm256_cmpeq_epi32(_mm256_and_si256(data, bits), bits);
+                _mm256_storeu_si256((__m256i*)&pixels[word * 64 + half * 32 + byte * 8], _mm256_blendv_epi8(off, on, set));
+                data = _mm256_slli_epi32(data, 8);
+            }
+        }
+    }
+}
 
-                const ui16 sprite_pixels = sprite[y] << 8 >> sprite_offset_bits;
-                const ui8 sprite_pixel_groups[2] = { (sprite_pixels & 0xFF00) >> 8, sprite_pixels & 0x00FF };
-                for(ui8 x = 0; x < 2; ++x)
-                {
-                    const ui8 screen_index_x = (screen_position_x / C8_SCREEN_WIDTH_SIZE + x) % C8_SCREEN_WIDTH_SIZE;
+#elif C8_PIXELS_SSE2
 
-                    const ui8 screen_pixel_group = chip8->screen_memory[screen_index_x + screen_index_y];
-                    const ui8 sprite_pixel_group = sprite_pixel_groups[x];
+static inline ui64 chip8_byte_swap(const ui64 value)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    return _byteswap_uint64(value);
+#else
+    return __builtin_bswap64(value);
+#endif
+}
 
-                    const ui8 new_screen_pixel_group = screen_pixel_group ^ sprite_pixel_group;
-                    chip8->screen_memory[screen_index_x + screen_index_y] = new_screen_pixel_group;
+static void chip8_expand_pixels(const ui64 *rows, ui8 *pixels, const ui16 num_words)
+{
+    const __m128i bits = _mm_set1_epi64x(0x0102040810204080LL);
+    const __m128i ones = _mm_set1_epi8(1);
 
-                    // Check for erased pixels (collision)
-                    if(new_screen_pixel_group < screen_pixel_group)
-                        chip8->registers[0xF] = 1;
-                }
-            }
-            break;
-        }
-        case 0xE000:
+    for(ui16 word = 0; word < num_words; ++word)
+    {
+        // Swapped so the leftmost byte comes first, then widened by unpacking with itself until every byte fills 8 lanes
+        const ui64 swapped = chip8_byte_swap(rows[word]);
+        const __m128i bytes = _mm_loadl_epi64((const __m128i*)&swapped);
+        const __m128i x2 = _mm_unpacklo_epi8(bytes, bytes);
+        const __m128i x4[2] = { _mm_unpacklo_epi16(x2, x2), _mm_unpackhi_epi16(x2, x2) };
+        for(ui8 half = 0; half < 2; ++half)
         {
-            const ui8 register_index = (opcode & 0x0F00) >> 8;
-            const ui8 sub_opcode = opcode & 0x00FF;
-            const ui8 key_index = chip8->registers[register_index];
-            const ui8 key_state = chip8->keys[key_index];
-            if((sub_opcode == 0x9E && key_state == 1) || (sub_opcode == 0xA1 && key_state == 0))
-                add_program_counter += 2;
-            break;
+            const __m128i x8[2] = { _mm_unpacklo_epi32(x4[half], x4[half]), _mm_unpackhi_epi32(x4[half], x4[half]) };
+            for(ui8 quarter = 0; quarter < 2; ++quarter)
+            {
+                const __m128i set = _mm_cmpeq_epi8(_mm_and_si128(x8[quarter], bits), bits);
+                _mm_storeu_si128((__m128i*)&pixels[word * 64 + (half * 4 + quarter * 2) * 8], _mm_and_si128(set, ones));
+            }
         }
-        case 0xF000:
+    }
+}
+
+static void chip8_expand_pixels_palette(const ui64 *rows, ui32 *pixels, const ui16 num_words, const ui32 palette[2])
+{
+    const __m128i bits[2] = { _mm_setr_epi32((int)0x80000000, 0x40000000, 0x20000000, 0x10000000), _mm_setr_epi32(0x08000000, 0x04000000, 0x02000000, 0x01000000) };
+    const __m128i off = _mm_set1_epi32((int)palette[0]);
+    const __m128i on = _mm_set1_epi32((int)palette[1]);
+
+    for(ui16 word = 0; word < num_words; ++word)
+    {
+        for(ui8 half = 0; half < 2; ++half)
         {
-            const ui8 register_index = (opcode & 0x0F00) >> 8;
-            const ui8 sub_opcode = opcode & 0x00FF;
-            switch(sub_opcode)
+            // Every byte of the half is shifted to the top in turn
+            __m128i data = _mm_set1_epi32((int)(ui32)(rows[word] >> (32 - half * 32)));
+            for(ui8 byte = 0; byte < 4; ++byte)
             {
-                case 0x07:
-                    chip8->registers[register_index] = chip8->delay_timer;
-                    break;
-                case 0x0A:
-                {
-                    add_program_counter = 0;
-                    for(ui8 i = 0; i < C8_NUM_KEYS; ++i)
-                    {
-                        if(chip8->keys[i] == 1)
-                        {
-                            chip8->registers[register_index] = i;
-                            add_program_counter = 2;
-                            break;
-                        }
-                    }
-                    break;
-                }
-                case 0x15:
-                    chip8->delay_timer = chip8->registers[register_index];
-                    break;
-                case 0x18:
-                    chip8->sound_timer = chip8->registers[register_index];
-                    break;
-                case 0x1E:
-                {
-                    const ui8 register_value = chip8->registers[register_index];
-                    chip8->index_register += register_value;
-                    break;
-                }
-                case 0x29:
-                {
-                    const ui8 font_sprite_index = chip8->registers[register_index] * C8_FONT_SIZE;
-                    chip8->index_register = font_sprite_index;
-                    break;
-                }
-                case 0x33:
-                {
-                    const ui8 decimal_value = chip8->registers[register_index];
-                    const ui8 hundreds = (decimal_value / 100) % 10;
-                    const ui8 tens = (decimal_value / 10) % 10;
-                    const ui8 ones = decimal_value % 10;
-                    chip8->memory[chip8->index_register + 0] = hundreds;
-                    chip8->memory[chip8->index_register + 1] = tens;
-                    chip8->memory[chip8->index_register + 2] = ones;
-                    break;
-                }
-                case 0x55:
+                for(ui8 quarter = 0; quarter < 2; ++quarter)
                 {
-                    for(ui8 i = 0; i <= register_index; ++i)
-                        chip8->memory[chip8->index_register + i] = chip8->registers[i];
-                    break;
+                    const __m128i set = _mm_cmpeq_epi32(_mm_and_si128(data, bits[quarter]), bits[quarter]);
+                    const __m128i color = _mm_or_si128(_mm_and_si128(set, on), _mm_andnot_si128(set, off));
+                    _mm_storeu_si128((__m128i*)&pixels[word * 64 + half * 32 + byte * 8 + quarter * 4], color);
                 }
-                case 0x65:
-                {
-                    for(ui8 i = 0; i <= register_index; ++i)
-                        chip8->registers[i] = chip8->memory[chip8->index_register + i];
-                    break;
-                }
-                default:
-                    printf("Unsupported opcode %X\n", opcode);
+                data = _mm_slli_epi32(data, 8);
             }
-            break;
         }
-        default:
-            printf("Unsupported opcode %X\n", opcode);
     }
+}
 
-    if(event)
-        *event = local_event;
+#elif C8_PIXELS_NEON
+
+static void chip8_expand_pixels(const ui64 *rows, ui8 *pixels, const ui16 num_words)
+{
+    const uint8x8_t bits = { 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01 };
+    const uint8x8_t ones = vdup_n_u8(1);
 
-    chip8->program_counter += add_program_counter;
+    for(ui16 word = 0; word < num_words; ++word)
+    {
+        // Table lookups replicate one byte of the word, highest byte first
+        const uint8x8_t bytes = vcreate_u8(rows[word]);
+        for(ui8 byte = 0; byte < 8; ++byte)
+        {
+            const uint8x8_t replicated = vtbl1_u8(bytes, vdup_n_u8(7 - byte));
+            vst1_u8(&pixels[word * 64 + byte * 8], vand_u8(vtst_u8(replicated, bits), ones));
+        }
+    }
 }
 
-void chip8_update_timers(Chip8 *chip8)
+static void chip8_expand_pixels_palette(const ui64 *rows, ui32 *pixels, const ui16 num_words, const ui32 palette[2])
 {
-    if(chip8->delay_timer > 0)
-        --chip8->delay_timer;
+    const uint32x4_t bits[2] = { { 0x80000000, 0x40000000, 0x20000000, 0x10000000 }, { 0x08000000, 0x04000000, 0x02000000, 0x01000000 } };
+    const uint32x4_t off = vdupq_n_u32(palette[0]);
+    const uint32x4_t on = vdupq_n_u32(palette[1]);
 
-    if(chip8->sound_timer > 0)
+    for(ui16 word = 0; word < num_words; ++word)
     {
-        if(--chip8->sound_timer == 0)
-            printf("BEEP\n");
+        for(ui8 half = 0; half < 2; ++half)
+        {
+            // Every byte of the half is shifted to the top in turn
+            uint32x4_t data = vdupq_n_u32((ui32)(rows[word] >> (32 - half * 32)));
+            for(ui8 byte = 0; byte < 4; ++byte)
+            {
+                for(ui8 quarter = 0; quarter < 2; ++quarter)
+                    vst1q_u32(&pixels[word * 64 + half * 32 + byte * 8 + quarter * 4], vbslq_u32(vtstq_u32(data, bits[quarter]), on, off));
+                data = vshlq_n_u32(data, 8);
+            }
+        }
     }
 }
 
-void chip8_feed_input(Chip8 *chip8, const Chip8InputKey *keys, const ui8 num_keys)
+#else
+
+static void chip8_expand_pixels(const ui64 *rows, ui8 *pixels, const ui16 num_words)
 {
-    if(keys == NULL || num_keys == 0)
-        return;
-    
-    for(ui8 i = 0; i < num_keys && i < C8_NUM_KEYS; ++i)
-        chip8->keys[keys[i].key_index] = keys[i].key_state;
+    for(ui16 word = 0; word < num_words; ++word)
+    {
+        for(ui8 byte = 0; byte < 8; ++byte)
+        {
+            // SWAR: broadcast the byte, isolate one bit per byte and turn every non-zero byte into 1
+            const ui64 broadcast = (ui8)(rows[word] >> (56 - byte * 8)) * 0x0101010101010101ULL;
+            const ui64 set = broadcast & 0x0102040810204080ULL;
+            const ui64 expanded = ((set + 0x7F7F7F7F7F7F7F7FULL) >> 7) & 0x0101010101010101ULL;
+            for(ui8 pixel = 0; pixel < 8; ++pixel)
+                pixels[word * 64 + byte * 8 + pixel] = (ui8)(expanded >> (pixel * 8));
+        }
+    }
+}
+
+static void chip8_expand_pixels_palette(const ui64 *rows, ui32 *pixels, const ui16 num_words, const ui32 palette[2])
+{
+    for(ui16 word = 0; word < num_words; ++word)
+        for(ui8 pixel = 0; pixel < 64; ++pixel)
+            pixels[word * 64 + pixel] = palette[(rows[word] >> (63 - pixel)) & 1];
+}
+
+#endif
+
+// Converts screen words to the packed byte layout of `chip8_screen_packed`, hi-res rows are two consecutive words
+static void chip8_pack_rows(const ui64 *rows, ui8 *packed, const ui16 num_words)
+{
+    for(ui16 word = 0; word < num_words; ++word)
+        for(ui8 byte = 0; byte < 8; ++byte)
+            packed[word * 8 + byte] = (ui8)(rows[word] >> (56 - byte * 8));
+}
+
+ui32 chip8_screen_width(const Chip8 *chip8)
+{
+    return chip8->hires ? C8_HIRES_SCREEN_WIDTH : C8_SCREEN_WIDTH;
+}
+
+ui32 chip8_screen_height(const Chip8 *chip8)
+{
+    return chip8->hires ? C8_HIRES_SCREEN_HEIGHT : C8_SCREEN_HEIGHT;
 }
 
 void chip8_pixel_data(Chip8 *chip8, ui8 *pixels, const ui16 num_pixels)
@@ -377,26 +1373,81 @@ void chip8_pixel_data(Chip8 *chip8, ui8 *pixels, const ui16 num_pixels)
     if(pixels == NULL || num_pixels == 0)
         return;
 
-    memset(pixels, 0, num_pixels);
+    // Only whole rows are expanded, anything past the screen is cleared
+    const ui32 width = chip8_screen_width(chip8);
+    const ui32 height = chip8_screen_height(chip8);
+    const ui16 num_rows = num_pixels / width < height ? num_pixels / width : height;
+    const ui16 num_expanded_pixels = num_rows * width;
+    chip8_expand_pixels(chip8->screen_memory, pixels, num_rows * width / 64);
+    memset(&pixels[num_expanded_pixels], 0, num_pixels - num_expanded_pixels);
+}
+
+void chip8_pixel_data_rgba(Chip8 *chip8, ui32 *pixels, const ui16 num_pixels, const ui32 palette[2])
+{
+    if(pixels == NULL || num_pixels == 0 || palette == NULL)
+        return;
+
+    const ui32 width = chip8_screen_width(chip8);
+    const ui32 height = chip8_screen_height(chip8);
+    const ui16 num_rows = num_pixels / width < height ? num_pixels / width : height;
+    const ui16 num_expanded_pixels = num_rows * width;
+    chip8_expand_pixels_palette(chip8->screen_memory, pixels, num_rows * width / 64, palette);
+    for(ui16 i = num_expanded_pixels; i < num_pixels; ++i)
+        pixels[i] = palette[0];
+}
+
+ui32 chip8_dirty_rows(const Chip8 *chip8)
+{
+    return chip8->dirty_rows;
+}
+
+ui32 chip8_pixel_data_incremental(Chip8 *chip8, ui8 *pixels, const ui16 num_pixels)
+{
+    const ui32 width = chip8_screen_width(chip8);
+    if(pixels == NULL || num_pixels < width)
+        return 0;
+
+    // Bands cover one lo-res or two hi-res rows, i.e. always two words of the screen in hi-res
+    const ui32 rows_per_band = chip8->hires ? 2 : 1;
+    const ui32 height = chip8_screen_height(chip8);
+    const ui16 num_rows = num_pixels / width < height ? num_pixels / width : height;
+    const ui32 num_bands = num_rows / rows_per_band;
+    const ui32 band_mask = num_bands == 32 ? 0xFFFFFFFF : (1u << num_bands) - 1;
+    const ui32 bands = chip8->dirty_rows & band_mask;
 
-    for(ui8 screen_position_y = 0; screen_position_y < C8_SCREEN_HEIGHT; ++screen_position_y)
+    for(ui32 band = 0; band < num_bands; ++band)
     {
-        const ui8 screen_index_y = screen_position_y * C8_SCREEN_WIDTH_SIZE;
-        for(ui8 screen_position_x = 0; screen_position_x < C8_SCREEN_WIDTH; screen_position_x += 8)
+        if(bands & (1u << band))
         {
-            const ui8 screen_index_x = screen_position_x / C8_SCREEN_WIDTH_SIZE;
-            const ui8 C8_SCREEN_PIXELS = chip8->screen_memory[screen_index_x + screen_index_y];
-            if(C8_SCREEN_PIXELS == 0)
-                continue;
-
-            for(ui8 pixel = 0; pixel < 8; ++pixel)
-            {
-                const ui16 pixel_index = (ui16)(screen_position_x + pixel) + (ui16)screen_position_y * C8_SCREEN_WIDTH;
-                const ui8 pixel_bit = 0x80 >> pixel;
-                pixels[pixel_index] = (C8_SCREEN_PIXELS & pixel_bit) != 0;
-            }
+            const ui32 band_words = rows_per_band * width / 64;
+            chip8_expand_pixels(&chip8->screen_memory[band * band_words], &pixels[band * rows_per_band * width], band_words);
         }
     }
+
+    chip8->dirty_rows &= ~bands;
+    return bands;
+}
+
+ui8 chip8_screen_pixel(const Chip8 *chip8, const ui8 x, const ui8 y)
+{
+    const ui32 width = chip8_screen_width(chip8);
+    const ui32 column = x % width;
+    const ui32 words_per_row = width / 64;
+    return (chip8->screen_memory[(y % chip8_screen_height(chip8)) * words_per_row + column / 64] >> (63 - column % 64)) & 1;
+}
+
+ui32 chip8_screen_packed(const Chip8 *chip8, ui8 *packed)
+{
+    const ui32 size = chip8_screen_width(chip8) * chip8_screen_height(chip8) / 8;
+    chip8_pack_rows(chip8->screen_memory, packed, size / 8);
+    return size;
+}
+
+ui8 chip8_frame_pixel(const Chip8Frame *frame, const ui32 x, const ui32 y)
+{
+    if(frame->hires)
+        return (frame->rows[(y % C8_HIRES_SCREEN_HEIGHT) * 2 + (x % C8_HIRES_SCREEN_WIDTH) / 64] >> (63 - x % 64)) & 1;
+    return (frame->rows[y % C8_SCREEN_HEIGHT] >> (C8_SCREEN_WIDTH - 1 - x % C8_SCREEN_WIDTH)) & 1;
 }
 
 ui8 chip8_screen_index(const ui8 x, const ui8 y)
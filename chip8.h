@@ -1,7 +1,11 @@
+#pragma once
+
 typedef unsigned char ui8;
 typedef unsigned short ui16;
-typedef unsigned long ui32;
-typedef signed long i32;
+typedef unsigned int ui32;
+typedef signed short i16;
+typedef signed int i32;
+typedef unsigned long long ui64;
 
 enum
 {
@@ -12,16 +16,88 @@ enum
     C8_SCREEN_HEIGHT = 32,
     C8_SCREEN_SIZE = C8_SCREEN_WIDTH_SIZE * C8_SCREEN_HEIGHT,
     C8_SCREEN_PIXELS = C8_SCREEN_WIDTH * C8_SCREEN_HEIGHT,
+    // SCHIP hi-res screen, see `Chip8.hires`
+    C8_HIRES_SCREEN_WIDTH = 128,
+    C8_HIRES_SCREEN_WIDTH_SIZE = C8_HIRES_SCREEN_WIDTH / 8,
+    C8_HIRES_SCREEN_HEIGHT = 64,
+    C8_HIRES_SCREEN_SIZE = C8_HIRES_SCREEN_WIDTH_SIZE * C8_HIRES_SCREEN_HEIGHT,
+    C8_HIRES_SCREEN_PIXELS = C8_HIRES_SCREEN_WIDTH * C8_HIRES_SCREEN_HEIGHT,
+    C8_SCREEN_WORDS = C8_HIRES_SCREEN_SIZE / 8,
     C8_NUM_STACK_LEVELS = 16,
     C8_NUM_KEYS = 16,
     C8_NUM_FONTS = 16,
     C8_FONT_SIZE = 5,
+    // SCHIP 8x10 digits, stored right after the small ones
+    C8_BIG_FONT_SIZE = 10,
+    C8_BIG_FONT_ADDRESS = C8_NUM_FONTS * C8_FONT_SIZE,
     C8_ROM_PLACEMENT = 0x200,
+    C8_MAX_ROM_SIZE = C8_MEMORY_SIZE - C8_ROM_PLACEMENT,
+    C8_NUM_DECODED_INSTRUCTIONS = C8_MEMORY_SIZE / 2,
+    // Granularity of `code_pages_written`, one bit of a ui64 per page
+    C8_CODE_PAGE_SIZE = C8_MEMORY_SIZE / 64,
+    C8_FRAMES_PER_SECOND = 60,
+    C8_DEFAULT_CYCLES_PER_FRAME = 10,
+    // Power of two
+    C8_EVENT_RING_SIZE = 256,
+};
+
+// Returned by the run functions, every one of them ends a run
+enum
+{
+    C8_EVENT_DRAW = 0x01,
+    C8_EVENT_KEY_WAIT = 0x02,
+    C8_EVENT_SOUND = 0x04,
+    C8_EVENT_FAULT = 0x08,
+};
+
+// Types of the events queued in the event ring
+enum
+{
+    // `data` holds the screen bands changed since the last incremental pixel export
+    C8_EVENT_TYPE_DRAW = 1,
+    // `data` holds the sound timer
+    C8_EVENT_TYPE_SOUND_ON,
+    C8_EVENT_TYPE_SOUND_OFF,
+    // `data` holds the register that receives the key, queued once per wait
+    C8_EVENT_TYPE_KEY_WAIT,
+    // `data` holds the unsupported opcode
+    C8_EVENT_TYPE_FAULT,
 };
 
+// Interpreter variants that roms disagree on, see the `C8_QUIRKS_*` profiles
 enum
 {
-    C8_EVENT_DRAW = 0x01
+    // 8XY6/8XYE shift VY into VX instead of shifting VX
+    C8_QUIRK_SHIFT_VY = 0x01,
+    // FX55/FX65 leave I past the last register instead of unchanged
+    C8_QUIRK_LOAD_STORE_INCREMENT = 0x02,
+    // BXNN jumps to XNN + VX instead of NNN + V0
+    C8_QUIRK_JUMP_VX = 0x04,
+    // DXYN clips sprites at the screen edges instead of wrapping them
+    C8_QUIRK_CLIP = 0x08,
+    // 8XY1/8XY2/8XY3 clear VF
+    C8_QUIRK_VF_RESET = 0x10,
+};
+
+// Quirks profiles, each one runs on its own copy of the interpreter
+enum
+{
+    // No quirk set, the behavior of this interpreter before profiles existed
+    C8_QUIRKS_DEFAULT = 0,
+    C8_QUIRKS_COSMAC,
+    C8_QUIRKS_SCHIP,
+    C8_NUM_QUIRKS,
+};
+
+// Status codes returned by rom loading
+enum
+{
+    C8_LOAD_OK = 0,
+    C8_LOAD_OPEN_FAILED,
+    C8_LOAD_READ_FAILED,
+    C8_LOAD_EMPTY,
+    C8_LOAD_TOO_LARGE,
+    C8_LOAD_OUT_OF_MEMORY,
 };
 
 /*
@@ -52,6 +128,36 @@ enum
     C8_KEY_F = 0xF
 };
 
+struct Chip8;
+struct Chip8Instruction;
+struct Chip8Profile;
+
+typedef ui8 (*Chip8Handler)(struct Chip8 *chip8, const struct Chip8Instruction *instruction);
+
+/*
+    Predecoded instruction:
+    Opcode fields extracted once, plus the handler that executes it.
+    A NULL `handler` marks an entry that still needs decoding.
+*/
+typedef struct Chip8Instruction
+{
+    Chip8Handler handler;
+    ui16 nnn;
+    ui8 op;
+    ui8 x;
+    ui8 y;
+    ui8 n;
+    ui8 nn;
+} Chip8Instruction;
+
+typedef struct Chip8Event
+{
+    // `cycle_count` when the instruction that raised it started, or when the timers ticked
+    ui64 cycle;
+    ui32 data;
+    ui8 type;
+} Chip8Event;
+
 typedef struct Chip8
 {
     ui8 memory[C8_MEMORY_SIZE];
@@ -61,7 +167,17 @@ typedef struct Chip8
     ui16 index_register;
     ui16 program_counter;
 
-    ui8 screen_memory[C8_SCREEN_SIZE];
+    /*
+        Screen:
+        Lo-res rows are the first `C8_SCREEN_HEIGHT` words, hi-res rows two
+        words each, the left half first. The most significant bit is the
+        leftmost pixel and words outside the current resolution stay zero.
+    */
+    ui64 screen_memory[C8_SCREEN_WORDS];
+    // Set by 00FF, cleared by 00FE, both clear the screen
+    ui8 hires;
+    // One bit per screen band changed since the last incremental export, a band is a lo-res row or two hi-res rows
+    ui32 dirty_rows;
 
     ui8 delay_timer;
     ui8 sound_timer;
@@ -70,20 +186,127 @@ typedef struct Chip8
     ui16 stack_pointer;
 
     ui8 keys[C8_NUM_KEYS];
+    // SCHIP flag registers, FX75/FX85, kept across rom loads
+    ui8 flag_registers[C8_NUM_REGISTERS];
+
+    // xorshift64* state used by CXNN, never zero
+    ui64 random_state;
+    // Instructions executed since `chip8_init`
+    ui64 cycle_count;
+    // Part of `cycle_count` spent in idle loops that were skipped instead of run
+    ui64 idle_cycles_skipped;
+    // Virtual clock, the timers tick once every `cycles_per_frame` instructions
+    ui32 cycles_per_frame;
+    ui32 frame_cycles;
+    // FNV-1a of the loaded rom, see `chip8_rom_hash`
+    ui64 rom_hash;
+    // `C8_QUIRKS_*` profile, see `chip8_set_quirks`
+    ui8 quirks;
+
+    // Unsupported opcodes executed so far, and the last one
+    ui32 num_faults;
+    ui16 fault_opcode;
+
+    // Decode cache, one entry per even address
+    Chip8Instruction decoded_instructions[C8_NUM_DECODED_INSTRUCTIONS];
+    // Bumped whenever decoded code is overwritten or a new rom is loaded
+    ui32 code_generation;
+    // One bit per `C8_CODE_PAGE_SIZE` bytes whose decoded code changed, set alongside `code_generation` and cleared by the tier that caught up
+    ui64 code_pages_written;
+
+    /*
+        Event ring:
+        Single producer, the thread running the instance, and single
+        consumer, see `chip8_poll_event`. Events are dropped and counted
+        while the ring is full, the instance never waits for the consumer.
+    */
+    ui32 event_head;
+    ui32 num_dropped_events;
+    ui8 key_wait_queued;
+    Chip8Event events[C8_EVENT_RING_SIZE];
+    ui32 event_tail;
+
+#ifdef C8_PROFILE
+    // See `chip8_profile_attach`
+    struct Chip8Profile *profile;
+#endif
 } Chip8;
 
+// Copy of the screen at one point of a run, see the render thread and the video recorder
+typedef struct Chip8Frame
+{
+    // Same layout as `Chip8.screen_memory`
+    ui64 rows[C8_SCREEN_WORDS];
+    ui8 hires;
+    // `cycle_count` when the frame was taken
+    ui64 cycle;
+    // Frames taken before this one
+    ui64 sequence;
+} Chip8Frame;
+
 typedef struct Chip8InputKey
 {
     ui8 key_index;
     ui8 key_state;
 } Chip8InputKey;
 
+// Seeds the generator from the current time, call `chip8_seed` afterwards for reproducible runs
 void chip8_init(Chip8 *chip8);
-void chip8_load_rom(Chip8 *chip8, const char *rom_file_path);
+void chip8_seed(Chip8 *chip8, const ui64 seed);
+// Loads through the rom cache, returns a `C8_LOAD_*` status and leaves the instance untouched on failure
+i32 chip8_load_rom(Chip8 *chip8, const char *rom_file_path);
+i32 chip8_load_rom_data(Chip8 *chip8, const ui8 *data, const ui32 size);
+// Runs a single instruction without advancing the virtual clock, its events are queued in the event ring as well
 void chip8_run_program(Chip8 *chip8, ui8 *event);
+// Runs up to `max_cycles` instructions, stopping early after any `C8_EVENT_*`
+ui32 chip8_run_cycles(Chip8 *chip8, const ui32 max_cycles, ui32 *events_out);
+// Runs until the timers ticked `num_frames` times, events do not stop it and `events_out` receives all of them
+ui64 chip8_run_frames(Chip8 *chip8, const ui32 num_frames, ui32 *events_out);
 void chip8_update_timers(Chip8 *chip8);
+
+void chip8_set_cycles_per_frame(Chip8 *chip8, const ui32 cycles_per_frame);
+// Loading a rom picks its profile from `chip8_rom_quirks`, call this afterwards to override it
+void chip8_set_quirks(Chip8 *chip8, const ui8 quirks);
+// `C8_QUIRK_*` flags of a profile
+ui32 chip8_quirks_flags(const ui8 quirks);
+// Short lowercase name of a profile, NULL past the last one
+const char *chip8_quirks_name(const ui8 quirks);
+// Instructions left until the next timer tick
+ui32 chip8_cycles_to_frame(const Chip8 *chip8);
+// Accounts for instructions run by `chip8_run_program`, ticking the timers on every frame boundary crossed
+void chip8_advance_clock(Chip8 *chip8, const ui32 num_cycles);
+// Skips up to `max_cycles` of an idle loop at `program_counter` without crossing a timer tick, returns 0 when not idle
+ui32 chip8_skip_idle(Chip8 *chip8, const ui32 max_cycles, ui32 *events_out);
 void chip8_feed_input(Chip8 *chip8, const Chip8InputKey *keys, const ui8 num_keys);
+// Consumer side of the event ring, safe to call from another thread, returns 0 when it is empty
+ui8 chip8_poll_event(Chip8 *chip8, Chip8Event *event);
+// Pixels of the current resolution row by row, `C8_HIRES_SCREEN_PIXELS` of them hold either
 void chip8_pixel_data(Chip8 *chip8, ui8 *pixels, const ui16 num_pixels);
+// Writes `palette[0]` for unset and `palette[1]` for set pixels, e.g. RGBA colors
+void chip8_pixel_data_rgba(Chip8 *chip8, ui32 *pixels, const ui16 num_pixels, const ui32 palette[2]);
+ui32 chip8_dirty_rows(const Chip8 *chip8);
+// Only rewrites the dirty bands of `pixels`, clears their dirty bits and returns them
+ui32 chip8_pixel_data_incremental(Chip8 *chip8, ui8 *pixels, const ui16 num_pixels);
+
+void chip8_decode_instruction(const Chip8 *chip8, const ui16 address, Chip8Instruction *instruction);
+// Name of the opcode class in `Chip8Instruction.op`, NULL past the last one
+const char *chip8_op_name(const ui8 op);
+// Must be called after writing to `memory` from outside the core
+void chip8_invalidate_instructions(Chip8 *chip8, const ui16 address, const ui16 size);
+
+// Screen accessors in the current resolution, `packed` receives one bit per pixel row by row and needs `C8_HIRES_SCREEN_SIZE` bytes
+ui32 chip8_screen_width(const Chip8 *chip8);
+ui32 chip8_screen_height(const Chip8 *chip8);
+ui8 chip8_screen_pixel(const Chip8 *chip8, const ui8 x, const ui8 y);
+// Returns the number of bytes written
+ui32 chip8_screen_packed(const Chip8 *chip8, ui8 *packed);
+// Pixel of a frame in the resolution it was taken in
+ui8 chip8_frame_pixel(const Chip8Frame *frame, const ui32 x, const ui32 y);
+
+// Per-instance generator, shared with the batched engine
+ui64 chip8_random_state_from_seed(const ui64 seed);
+ui8 chip8_random_byte(ui64 *random_state);
 
+// Lo-res layouts of `chip8_screen_packed` and `chip8_pixel_data`
 ui8 chip8_screen_index(const ui8 x, const ui8 y);
 ui16 chip8_pixel_index(const ui16 x, const ui16 y);
\ No newline at end of file
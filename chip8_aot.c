@@ -0,0 +1,153 @@
+#include "chip8_aot.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct Chip8Aot
+{
+    Chip8 *chip8;
+    const Chip8AotProgram *program;
+    ui32 code_generation;
+
+    // Index + 1 of the block starting at every address, 0 where there is none
+    ui16 block_indices[C8_MEMORY_SIZE];
+    // One flag per block of `program`, set while its bytes match the translated rom
+    ui8 *valid_blocks;
+};
+
+/*
+    Rechecks the blocks on the `pages` of `code_pages_written`, enabling
+    those whose bytes still match the translated rom. Their instructions
+    are decoded either way, overwriting them bumps `code_generation` and
+    brings the instance back here.
+*/
+static void chip8_aot_validate(Chip8Aot *aot, const ui64 pages)
+{
+    Chip8 *chip8 = aot->chip8;
+    const Chip8AotProgram *program = aot->program;
+
+    aot->code_generation = chip8->code_generation;
+    const ui8 same_rom = chip8->rom_hash == program->rom_hash && chip8->quirks == program->quirks;
+    for(ui32 i = 0; i < program->num_blocks; ++i)
+    {
+        const Chip8AotBlock *block = &program->blocks[i];
+        const ui32 size = block->num_instructions * 2u;
+        const ui32 first_page = block->address / C8_CODE_PAGE_SIZE;
+        const ui32 last_page = (block->address + size - 1) / C8_CODE_PAGE_SIZE;
+        // Bits first_page to last_page, 2 << 63 wraps to 0 and still leaves the right ones
+        if((pages & ((2ULL << last_page) - (1ULL << first_page))) == 0)
+            continue;
+
+        aot->valid_blocks[i] = same_rom && memcmp(&chip8->memory[block->address], &program->rom[block->address - C8_ROM_PLACEMENT], size) == 0;
+
+        // Roms running at odd addresses are covered by the decoded instructions overlapping them
+        for(ui32 address = block->address & ~1u; address < block->address + size && address < C8_MEMORY_SIZE; address += 2)
+        {
+            Chip8Instruction *decoded = &chip8->decoded_instructions[address >> 1];
+            if(decoded->handler == NULL)
+                chip8_decode_instruction(chip8, (ui16)address, decoded);
+        }
+    }
+}
+
+// Revalidates what the instance overwrote since the last check
+static void chip8_aot_catch_up(Chip8Aot *aot)
+{
+    const ui64 pages = aot->chip8->code_pages_written;
+    aot->chip8->code_pages_written = 0;
+    chip8_aot_validate(aot, pages);
+}
+
+Chip8Aot *chip8_aot_create(const Chip8AotProgram *program, Chip8 *chip8)
+{
+    if(program == NULL || chip8->rom_hash != program->rom_hash || chip8->quirks != program->quirks)
+        return NULL;
+
+    Chip8Aot *aot = calloc(1, sizeof(Chip8Aot));
+    if(aot == NULL)
+        return NULL;
+
+    // One more so roms without blocks still get an allocation
+    aot->valid_blocks = calloc(program->num_blocks + 1, sizeof(ui8));
+    if(aot->valid_blocks == NULL)
+    {
+        free(aot);
+        return NULL;
+    }
+
+    for(ui32 i = 0; i < program->num_blocks; ++i)
+        aot->block_indices[program->blocks[i].address] = (ui16)(i + 1);
+
+    aot->chip8 = chip8;
+    aot->program = program;
+    chip8_aot_reset(aot);
+    return aot;
+}
+
+void chip8_aot_destroy(Chip8Aot *aot)
+{
+    if(aot == NULL)
+        return;
+
+    free(aot->valid_blocks);
+    free(aot);
+}
+
+void chip8_aot_reset(Chip8Aot *aot)
+{
+    if(aot == NULL)
+        return;
+
+    aot->chip8->code_pages_written = 0;
+    chip8_aot_validate(aot, ~0ULL);
+}
+
+ui32 chip8_aot_run_cycles(Chip8Aot *aot, Chip8 *chip8, const ui32 max_cycles, ui32 *events_out)
+{
+    if(aot == NULL || aot->chip8 != chip8)
+        return chip8_run_cycles(chip8, max_cycles, events_out);
+
+    if(aot->code_generation != chip8->code_generation)
+        chip8_aot_catch_up(aot);
+
+    ui32 num_cycles = 0;
+    ui32 events = 0;
+    while(num_cycles < max_cycles)
+    {
+        const ui16 program_counter = chip8->program_counter;
+        const ui32 budget = max_cycles - num_cycles;
+
+        // Idle loops are cheaper to skip than to run, even translated
+        if(program_counter < C8_MEMORY_SIZE && (chip8->memory[program_counter] & 0xF0) == 0xF0
+            && (chip8->memory[(program_counter + 1) & (C8_MEMORY_SIZE - 1)] == 0x07 || chip8->memory[(program_counter + 1) & (C8_MEMORY_SIZE - 1)] == 0x0A))
+        {
+            const ui32 idle_cycles = chip8_skip_idle(chip8, budget, &events);
+            num_cycles += idle_cycles;
+            if(events != 0)
+                break;
+            if(idle_cycles != 0)
+                continue;
+        }
+
+        ui32 run_cycles = 0;
+        const ui16 block_index = program_counter < C8_MEMORY_SIZE ? aot->block_indices[program_counter] : 0;
+        if(block_index != 0 && aot->valid_blocks[block_index - 1])
+            run_cycles = aot->program->run(chip8, aot->valid_blocks, budget, &events);
+
+        // Untranslated and overwritten code, and blocks longer than the rest of the budget, run on the interpreter up to the next timer tick
+        if(run_cycles == 0)
+            run_cycles = chip8_run_cycles(chip8, budget < chip8_cycles_to_frame(chip8) ? budget : chip8_cycles_to_frame(chip8), &events);
+        num_cycles += run_cycles;
+
+        if(chip8->code_generation != aot->code_generation)
+            chip8_aot_catch_up(aot);
+
+        if(events != 0)
+            break;
+    }
+
+    if(events_out)
+        *events_out = events;
+
+    return num_cycles;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "chip8.h"
+
+/*
+    Ahead-of-time translated roms:
+    `chip8_translate` recovers the control-flow graph of a rom and writes it
+    as one C function over the `Chip8` struct, every basic block a label
+    that jumps straight to the next one. Draws, key waits, sound, memory
+    stores, BNNN and unsupported opcodes end their block with a call back
+    into the interpreter, addresses that were never translated run on the
+    interpreter as well.
+
+    Translations assume the rom bytes they were made from and the quirks
+    profile they were made for. Blocks whose bytes the instance overwrote
+    are skipped until the bytes match again, so self-modifying code keeps
+    running on the interpreter.
+
+    An aot is bound to one `Chip8` instance. Call `chip8_aot_reset` after
+    re-initializing it or loading another rom.
+*/
+
+/*
+    Translated program: runs `chip8` from `program_counter` for at most
+    `max_cycles` instructions, block after block, ticking the timers on
+    frame boundaries. Only blocks whose flag in `valid_blocks` is set run,
+    the program returns at any other address, at an event, an overwritten
+    block or a block that does not fit the rest of the budget. Returns the
+    number of instructions executed, 0 when the block at
+    `program_counter` could not run.
+*/
+typedef ui32 (*Chip8AotRun)(Chip8 *chip8, const ui8 *valid_blocks, const ui32 max_cycles, ui32 *events_out);
+
+typedef struct Chip8AotBlock
+{
+    ui16 address;
+    ui8 num_instructions;
+} Chip8AotBlock;
+
+typedef struct Chip8AotProgram
+{
+    const char *name;
+    ui64 rom_hash;
+    // `C8_QUIRKS_*` profile the blocks implement
+    ui8 quirks;
+    // Rom the blocks were translated from, placed at `C8_ROM_PLACEMENT`
+    const ui8 *rom;
+    ui32 rom_size;
+    // In the order of `valid_blocks`
+    const Chip8AotBlock *blocks;
+    ui32 num_blocks;
+    Chip8AotRun run;
+} Chip8AotProgram;
+
+typedef struct Chip8Aot Chip8Aot;
+
+/*
+    Used by translated programs, which keep the cycles left to the next
+    frame boundary in `frame_left` and only bring the clock up to date on
+    the boundary and once they return.
+*/
+static inline ui32 chip8_aot_tick(Chip8 *chip8)
+{
+    chip8_advance_clock(chip8, chip8_cycles_to_frame(chip8));
+    return chip8_cycles_to_frame(chip8);
+}
+
+// Used by translated programs, runs the instruction at `address` on the interpreter
+static inline ui32 chip8_aot_interpret(Chip8 *chip8, const ui16 address, const ui32 frame_left)
+{
+    // Events are stamped with the cycle of the instruction, the clock is behind by the ones run since the last tick
+    const ui32 num_preceding = chip8_cycles_to_frame(chip8) - frame_left;
+    ui8 event = 0;
+    chip8->program_counter = address;
+    chip8->cycle_count += num_preceding;
+    chip8_run_program(chip8, &event);
+    chip8->cycle_count -= num_preceding;
+    return event;
+}
+
+// Counts one instruction off the frame
+#define C8_AOT_COUNT() \
+    if(--frame_left == 0) \
+        frame_left = chip8_aot_tick(chip8)
+
+// Starts a block, returns at it unless it is valid and fits the budget
+#define C8_AOT_BLOCK(index, address, num_instructions) \
+    if(!valid_blocks[index] || budget < (num_instructions)) \
+    { \
+        chip8->program_counter = (address); \
+        goto done; \
+    } \
+    budget -= (num_instructions)
+
+// Skips the idle loop at `address`, which starts a block, and comes back to the block afterwards
+#define C8_AOT_SKIP_IDLE(address, label) \
+    chip8->program_counter = (address); \
+    chip8_advance_clock(chip8, chip8_cycles_to_frame(chip8) - frame_left); \
+    idle_cycles = chip8_skip_idle(chip8, budget, &events); \
+    frame_left = chip8_cycles_to_frame(chip8); \
+    budget -= idle_cycles; \
+    if(events != 0) \
+        goto done; \
+    if(idle_cycles != 0) \
+        goto label
+
+// Ends a block with an instruction run by the interpreter, code stores make the program return
+#define C8_AOT_INTERPRET(address) \
+    events = chip8_aot_interpret(chip8, (address), frame_left); \
+    C8_AOT_COUNT(); \
+    if(events != 0 || chip8->code_generation != code_generation) \
+        goto done; \
+    goto dispatch
+
+// Defined by the file `chip8_translate` writes, returns NULL for roms it has no translation of
+const Chip8AotProgram *chip8_aot_find(const ui64 rom_hash);
+
+// Returns NULL when `program` was translated from another rom or for another quirks profile
+Chip8Aot *chip8_aot_create(const Chip8AotProgram *program, Chip8 *chip8);
+void chip8_aot_destroy(Chip8Aot *aot);
+void chip8_aot_reset(Chip8Aot *aot);
+
+// Same contract as `chip8_run_cycles`, `chip8` must be the instance the aot was created for
+ui32 chip8_aot_run_cycles(Chip8Aot *aot, Chip8 *chip8, const ui32 max_cycles, ui32 *events_out);
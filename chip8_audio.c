@@ -0,0 +1,515 @@
+#include "chip8_audio.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #define C8_AUDIO_LOAD(pointer) ((ui32)InterlockedCompareExchange((volatile LONG*)(pointer), 0, 0))
+    #define C8_AUDIO_STORE(pointer, value) ((void)InterlockedExchange((volatile LONG*)(pointer), (LONG)(value)))
+#else
+    #include <errno.h>
+    #include <pthread.h>
+    #include <time.h>
+    #define C8_AUDIO_LOAD(pointer) __atomic_load_n(pointer, __ATOMIC_ACQUIRE)
+    #define C8_AUDIO_STORE(pointer, value) __atomic_store_n(pointer, value, __ATOMIC_RELEASE)
+#endif
+
+enum
+{
+    C8_AUDIO_AMPLITUDE = 8192,
+    C8_AUDIO_CACHE_LINE = 64,
+    // The sink thread naps this long whenever it found the ring empty, and so does a thread waiting for room
+    C8_AUDIO_IDLE_MS = 1,
+    // One step of the phase accumulator per pattern bit, the phase wraps after the 128th
+    C8_AUDIO_BIT_SHIFT = 25,
+    C8_AUDIO_WAV_HEADER_SIZE = 44,
+    // Samples the sink thread synthesizes before handing them to the sink
+    C8_AUDIO_CHUNK_SAMPLES = 4096,
+    C8_AUDIO_MAX_SPAN_SAMPLES = 0xFFFFFFFF,
+};
+
+enum
+{
+    C8_AUDIO_SPAN_SILENCE,
+    C8_AUDIO_SPAN_TONE,
+    // Switches the pattern for the spans after it
+    C8_AUDIO_SPAN_PATTERN,
+};
+
+typedef struct Chip8AudioSpan
+{
+    ui8 type;
+    // Samples of silence or of the tone
+    ui32 num_samples;
+    ui8 pattern[C8_AUDIO_PATTERN_SIZE];
+    ui32 bit_rate;
+} Chip8AudioSpan;
+
+// From the start of a pattern bit to the next change of level
+typedef struct Chip8AudioChange
+{
+    i16 level;
+    // Phase to the change, 0 for a pattern without any
+    ui32 phase;
+    // `phase` is `num_steps` steps of the phase accumulator and `remainder`
+    ui32 num_steps;
+    ui32 remainder;
+} Chip8AudioChange;
+
+/*
+    Span ring:
+    `write_position` is only advanced by the thread feeding the audio and
+    `read_position` only by the sink thread, both count spans forever and
+    wrap, the ring index is their low bits. Spans past `write_position` up
+    to `next_position` are written but not handed over yet, the last of
+    them still grows while the sound timer stays on or off.
+*/
+struct Chip8Audio
+{
+    Chip8AudioSink sink;
+    ui32 sample_rate;
+    Chip8AudioSpan *ring;
+    ui32 ring_mask;
+
+    _Alignas(C8_AUDIO_CACHE_LINE) ui32 write_position;
+    _Alignas(C8_AUDIO_CACHE_LINE) ui32 read_position;
+    _Alignas(C8_AUDIO_CACHE_LINE) ui32 stop;
+
+    // Owned by the feeding thread
+    _Alignas(C8_AUDIO_CACHE_LINE) ui32 next_position;
+    // Last `read_position` seen, saves loading it for every span
+    ui32 seen_read_position;
+    ui64 cycle;
+    // Cycles times the sample rate not yet worth a whole sample
+    ui64 cycle_remainder;
+    ui8 playing;
+    Chip8AudioStats stats;
+
+    // Synthesis state, owned by the sink thread
+    _Alignas(C8_AUDIO_CACHE_LINE) ui32 phase;
+    ui32 phase_step;
+    Chip8AudioChange changes[C8_AUDIO_PATTERN_SIZE * 8];
+    ui32 num_samples;
+    i16 samples[C8_AUDIO_CHUNK_SAMPLES];
+
+#if defined(_WIN32)
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+};
+
+static ui8 chip8_audio_pattern_bit(const ui8 *pattern, const ui32 bit)
+{
+    return (pattern[(bit >> 3) % C8_AUDIO_PATTERN_SIZE] >> (7 - (bit & 7))) & 1;
+}
+
+static void chip8_audio_apply_pattern(Chip8Audio *audio, const ui8 *pattern, const ui32 bit_rate)
+{
+    audio->phase_step = (ui32)(((ui64)bit_rate << C8_AUDIO_BIT_SHIFT) / audio->sample_rate);
+
+    const ui32 num_bits = C8_AUDIO_PATTERN_SIZE * 8;
+    for(ui32 bit = 0; bit < num_bits; ++bit)
+    {
+        ui32 length = 1;
+        while(length < num_bits && chip8_audio_pattern_bit(pattern, bit + length) == chip8_audio_pattern_bit(pattern, bit))
+            ++length;
+
+        // Under 2^32 as a flat pattern has no level change
+        Chip8AudioChange *change = &audio->changes[bit];
+        change->level = chip8_audio_pattern_bit(pattern, bit) ? C8_AUDIO_AMPLITUDE : -C8_AUDIO_AMPLITUDE;
+        change->phase = length < num_bits ? length << C8_AUDIO_BIT_SHIFT : 0;
+        change->num_steps = audio->phase_step != 0 ? change->phase / audio->phase_step : 0;
+        change->remainder = audio->phase_step != 0 ? change->phase % audio->phase_step : 0;
+    }
+}
+
+// Appends `count` samples of `level`, handing every full chunk to the sink
+static void chip8_audio_write_level(Chip8Audio *audio, const i16 level, ui32 count)
+{
+    const ui64 levels = (ui16)level * 0x0001000100010001ull;
+    while(count > 0)
+    {
+        const ui32 room = C8_AUDIO_CHUNK_SAMPLES - audio->num_samples;
+        const ui32 run = count < room ? count : room;
+
+        // Four samples per store
+        i16 *samples = &audio->samples[audio->num_samples];
+        ui32 i = 0;
+        for(; i + 4 <= run; i += 4)
+            memcpy(&samples[i], &levels, sizeof(levels));
+        for(; i < run; ++i)
+            samples[i] = level;
+
+        audio->num_samples += run;
+        count -= run;
+        if(audio->num_samples == C8_AUDIO_CHUNK_SAMPLES)
+        {
+            audio->sink.write(audio->sink.context, audio->samples, audio->num_samples);
+            audio->num_samples = 0;
+        }
+    }
+}
+
+/*
+    Synthesis:
+    The output only changes where the phase crosses into a pattern bit of
+    the other level, so only those crossings are worked out and the
+    samples between them are written as runs of one level. A square wave
+    is two runs per period of the tone.
+*/
+static void chip8_audio_synthesize(Chip8Audio *audio, ui32 num_samples)
+{
+    const ui32 bit_mask = (1u << C8_AUDIO_BIT_SHIFT) - 1;
+    const ui32 phase_step = audio->phase_step;
+    ui32 phase = audio->phase;
+    while(num_samples > 0)
+    {
+        const Chip8AudioChange *change = &audio->changes[phase >> C8_AUDIO_BIT_SHIFT];
+
+        // Samples until the phase reaches the other level, all of them for a stopped or flat pattern
+        ui32 run = num_samples;
+        if(phase_step != 0 && change->phase != 0)
+        {
+            // A run that started on a change is less than a step into its bit, the steps to the next one follow from the table
+            const ui32 offset = phase & bit_mask;
+            ui32 steps = change->num_steps + (change->remainder > offset);
+            if(offset >= phase_step)
+            {
+                const ui32 to_change = change->phase - offset;
+                steps = to_change / phase_step + (to_change % phase_step != 0);
+            }
+            if(run > steps)
+                run = steps;
+        }
+
+        chip8_audio_write_level(audio, change->level, run);
+        num_samples -= run;
+        phase += phase_step * run;
+    }
+    audio->phase = phase;
+}
+
+// Synthesizes the spans handed over so far for the sink, each span is given back as soon as it was read
+static ui8 chip8_audio_drain(Chip8Audio *audio)
+{
+    const ui32 write_position = C8_AUDIO_LOAD(&audio->write_position);
+    ui32 read_position = audio->read_position;
+    if(read_position == write_position)
+        return 0;
+
+    while(read_position != write_position)
+    {
+        const Chip8AudioSpan span = audio->ring[read_position & audio->ring_mask];
+        C8_AUDIO_STORE(&audio->read_position, ++read_position);
+
+        if(span.type == C8_AUDIO_SPAN_PATTERN)
+            chip8_audio_apply_pattern(audio, span.pattern, span.bit_rate);
+        else if(span.type == C8_AUDIO_SPAN_TONE)
+            chip8_audio_synthesize(audio, span.num_samples);
+        else
+            chip8_audio_write_level(audio, 0, span.num_samples);
+    }
+    if(audio->num_samples != 0)
+        audio->sink.write(audio->sink.context, audio->samples, audio->num_samples);
+    audio->num_samples = 0;
+    return 1;
+}
+
+static void chip8_audio_sleep(void)
+{
+#if defined(_WIN32)
+    Sleep(C8_AUDIO_IDLE_MS);
+#else
+    const struct timespec duration = { 0, C8_AUDIO_IDLE_MS * 1000000L };
+    nanosleep(&duration, NULL);
+#endif
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI chip8_audio_main(LPVOID parameter)
+#else
+static void *chip8_audio_main(void *parameter)
+#endif
+{
+    Chip8Audio *audio = (Chip8Audio*)parameter;
+    while(!C8_AUDIO_LOAD(&audio->stop))
+    {
+        if(!chip8_audio_drain(audio))
+            chip8_audio_sleep();
+    }
+
+    // Everything rendered before the stop was requested still reaches the sink
+    chip8_audio_drain(audio);
+    if(audio->sink.close != NULL)
+        audio->sink.close(audio->sink.context);
+#if defined(_WIN32)
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+Chip8Audio *chip8_audio_create(const Chip8AudioDesc *desc, const Chip8AudioSink *sink, const Chip8 *chip8)
+{
+    const ui32 ring_size = desc != NULL ? desc->ring_size : 0;
+    if(desc == NULL || sink == NULL || sink->write == NULL || desc->sample_rate == 0 || ring_size < 2 || (ring_size & (ring_size - 1)) != 0)
+        return NULL;
+
+    Chip8Audio *audio = calloc(1, sizeof(Chip8Audio));
+    if(audio == NULL)
+        return NULL;
+
+    audio->ring = malloc(ring_size * sizeof(Chip8AudioSpan));
+    if(audio->ring == NULL)
+    {
+        free(audio);
+        return NULL;
+    }
+
+    audio->sink = *sink;
+    audio->sample_rate = desc->sample_rate;
+    audio->ring_mask = ring_size - 1;
+    audio->cycle = chip8->cycle_count;
+    audio->playing = chip8->sound_timer != 0;
+
+    // A square wave is half a pattern of ones, played once per period of the tone
+    static const ui8 square[C8_AUDIO_PATTERN_SIZE] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    chip8_audio_set_pattern(audio, square, C8_AUDIO_DEFAULT_TONE * C8_AUDIO_PATTERN_SIZE * 8);
+
+#if defined(_WIN32)
+    audio->thread = CreateThread(NULL, 0, chip8_audio_main, audio, 0, NULL);
+    if(audio->thread == NULL)
+#else
+    if(pthread_create(&audio->thread, NULL, chip8_audio_main, audio) != 0)
+#endif
+    {
+        free(audio->ring);
+        free(audio);
+        return NULL;
+    }
+
+    return audio;
+}
+
+void chip8_audio_destroy(Chip8Audio *audio, Chip8AudioStats *stats)
+{
+    if(audio == NULL)
+        return;
+
+    C8_AUDIO_STORE(&audio->stop, 1);
+#if defined(_WIN32)
+    WaitForSingleObject(audio->thread, INFINITE);
+    CloseHandle(audio->thread);
+#else
+    pthread_join(audio->thread, NULL);
+#endif
+
+    if(stats != NULL)
+        *stats = audio->stats;
+    free(audio->ring);
+    free(audio);
+}
+
+static void chip8_audio_wait(Chip8Audio *audio)
+{
+    C8_AUDIO_STORE(&audio->write_position, audio->next_position);
+    do
+    {
+        chip8_audio_sleep();
+        audio->seen_read_position = C8_AUDIO_LOAD(&audio->read_position);
+    }
+    while(audio->next_position - audio->seen_read_position > audio->ring_mask);
+}
+
+// Waits for room in the ring, a real-time sink drops the samples of a span instead, returns 0 for a dropped span
+static ui8 chip8_audio_reserve(Chip8Audio *audio, const ui8 type, const ui32 num_samples)
+{
+    if(audio->next_position - audio->seen_read_position <= audio->ring_mask)
+        return 1;
+
+    audio->seen_read_position = C8_AUDIO_LOAD(&audio->read_position);
+    if(audio->next_position - audio->seen_read_position <= audio->ring_mask)
+        return 1;
+
+    if(audio->sink.real_time && type != C8_AUDIO_SPAN_PATTERN)
+    {
+        audio->stats.num_dropped += num_samples;
+        return 0;
+    }
+    chip8_audio_wait(audio);
+    return 1;
+}
+
+void chip8_audio_set_pattern(Chip8Audio *audio, const ui8 pattern[C8_AUDIO_PATTERN_SIZE], const ui32 bit_rate)
+{
+    chip8_audio_reserve(audio, C8_AUDIO_SPAN_PATTERN, 0);
+    Chip8AudioSpan *span = &audio->ring[audio->next_position++ & audio->ring_mask];
+    span->type = C8_AUDIO_SPAN_PATTERN;
+    span->num_samples = 0;
+    memcpy(span->pattern, pattern, C8_AUDIO_PATTERN_SIZE);
+    span->bit_rate = bit_rate;
+    C8_AUDIO_STORE(&audio->write_position, audio->next_position);
+}
+
+// Only the sound timer being on or off is worked out here, synthesizing the tone is left to the sink thread
+static void chip8_audio_render(Chip8Audio *audio, ui64 num_samples)
+{
+    const ui8 type = audio->playing ? C8_AUDIO_SPAN_TONE : C8_AUDIO_SPAN_SILENCE;
+    audio->stats.num_samples += num_samples;
+    while(num_samples > 0)
+    {
+        const ui32 count = num_samples < C8_AUDIO_MAX_SPAN_SAMPLES ? (ui32)num_samples : C8_AUDIO_MAX_SPAN_SAMPLES;
+        num_samples -= count;
+
+        // Spans not handed over yet still grow
+        Chip8AudioSpan *last = &audio->ring[(audio->next_position - 1) & audio->ring_mask];
+        if(audio->next_position != audio->write_position && last->type == type && last->num_samples <= C8_AUDIO_MAX_SPAN_SAMPLES - count)
+        {
+            last->num_samples += count;
+            continue;
+        }
+
+        if(chip8_audio_reserve(audio, type, count))
+        {
+            Chip8AudioSpan *span = &audio->ring[audio->next_position++ & audio->ring_mask];
+            span->type = type;
+            span->num_samples = count;
+        }
+    }
+    C8_AUDIO_STORE(&audio->write_position, audio->next_position);
+}
+
+// Renders every sample due between the last rendered cycle and `cycle`
+static void chip8_audio_render_until(Chip8Audio *audio, const Chip8 *chip8, const ui64 cycle)
+{
+    if(cycle <= audio->cycle)
+        return;
+
+    const ui64 cycles_per_second = (ui64)chip8->cycles_per_frame * C8_FRAMES_PER_SECOND;
+    const ui64 scaled_cycles = (cycle - audio->cycle) * audio->sample_rate + audio->cycle_remainder;
+    audio->cycle = cycle;
+    audio->cycle_remainder = scaled_cycles % cycles_per_second;
+    chip8_audio_render(audio, scaled_cycles / cycles_per_second);
+}
+
+void chip8_audio_event(Chip8Audio *audio, const Chip8 *chip8, const Chip8Event *event)
+{
+    if(event->type != C8_EVENT_TYPE_SOUND_ON && event->type != C8_EVENT_TYPE_SOUND_OFF)
+        return;
+
+    chip8_audio_render_until(audio, chip8, event->cycle);
+    audio->playing = event->type == C8_EVENT_TYPE_SOUND_ON;
+}
+
+void chip8_audio_update(Chip8Audio *audio, const Chip8 *chip8)
+{
+    chip8_audio_render_until(audio, chip8, chip8->cycle_count);
+    audio->playing = chip8->sound_timer != 0;
+}
+
+/*
+    WAV sink:
+    A canonical 44-byte RIFF header, rewritten with the final sizes once
+    the sink is closed. Samples are stored little-endian whatever the host.
+*/
+typedef struct Chip8AudioWav
+{
+    FILE *file;
+    ui32 sample_rate;
+    ui64 data_size;
+} Chip8AudioWav;
+
+static void chip8_audio_store(ui8 *bytes, ui32 value, const ui8 size)
+{
+    for(ui8 i = 0; i < size; ++i, value >>= 8)
+        bytes[i] = (ui8)value;
+}
+
+static void chip8_audio_wav_header(ui8 *header, const ui32 sample_rate, const ui32 data_size)
+{
+    memcpy(&header[0], "RIFF", 4);
+    chip8_audio_store(&header[4], 36 + data_size, 4);
+    memcpy(&header[8], "WAVEfmt ", 8);
+    chip8_audio_store(&header[16], 16, 4);
+    // PCM, mono, 16 bits
+    chip8_audio_store(&header[20], 1, 2);
+    chip8_audio_store(&header[22], 1, 2);
+    chip8_audio_store(&header[24], sample_rate, 4);
+    chip8_audio_store(&header[28], sample_rate * 2, 4);
+    chip8_audio_store(&header[32], 2, 2);
+    chip8_audio_store(&header[34], 16, 2);
+    memcpy(&header[36], "data", 4);
+    chip8_audio_store(&header[40], data_size, 4);
+}
+
+static void chip8_audio_wav_write(void *context, const i16 *samples, const ui32 num_samples)
+{
+    Chip8AudioWav *wav = (Chip8AudioWav*)context;
+    ui8 bytes[C8_AUDIO_CHUNK_SAMPLES * 2];
+    for(ui32 first = 0; first < num_samples; first += C8_AUDIO_CHUNK_SAMPLES)
+    {
+        const ui32 count = num_samples - first < C8_AUDIO_CHUNK_SAMPLES ? num_samples - first : C8_AUDIO_CHUNK_SAMPLES;
+        for(ui32 i = 0; i < count; ++i)
+            chip8_audio_store(&bytes[i * 2], (ui16)samples[first + i], 2);
+        wav->data_size += fwrite(bytes, 1, count * 2, wav->file);
+    }
+}
+
+static void chip8_audio_wav_close(void *context)
+{
+    Chip8AudioWav *wav = (Chip8AudioWav*)context;
+
+    // RIFF sizes are 32 bits, longer recordings keep the sizes of a full file
+    ui8 header[C8_AUDIO_WAV_HEADER_SIZE];
+    const ui32 max_data_size = 0xFFFFFFFFu - 36;
+    chip8_audio_wav_header(header, wav->sample_rate, wav->data_size < max_data_size ? (ui32)wav->data_size : max_data_size);
+    if(fseek(wav->file, 0, SEEK_SET) == 0)
+        fwrite(header, 1, sizeof(header), wav->file);
+    fclose(wav->file);
+    free(wav);
+}
+
+i32 chip8_audio_sink_wav(const char *wav_file_path, const ui32 sample_rate, Chip8AudioSink *sink)
+{
+    Chip8AudioWav *wav = calloc(1, sizeof(Chip8AudioWav));
+    if(wav == NULL)
+        return C8_AUDIO_OUT_OF_MEMORY;
+
+    wav->file = fopen(wav_file_path, "wb");
+    if(wav->file == NULL)
+    {
+        free(wav);
+        return C8_AUDIO_OPEN_FAILED;
+    }
+
+    ui8 header[C8_AUDIO_WAV_HEADER_SIZE];
+    chip8_audio_wav_header(header, sample_rate, 0);
+    if(fwrite(header, 1, sizeof(header), wav->file) != sizeof(header))
+    {
+        fclose(wav->file);
+        free(wav);
+        return C8_AUDIO_OPEN_FAILED;
+    }
+
+    wav->sample_rate = sample_rate;
+    sink->write = chip8_audio_wav_write;
+    sink->close = chip8_audio_wav_close;
+    sink->context = wav;
+    sink->real_time = 0;
+    return C8_AUDIO_OK;
+}
+
+static void chip8_audio_null_write(void *context, const i16 *samples, const ui32 num_samples)
+{
+    (void)context; (void)samples; (void)num_samples;
+}
+
+Chip8AudioSink chip8_audio_sink_null(void)
+{
+    const Chip8AudioSink sink = { chip8_audio_null_write, NULL, NULL, 0 };
+    return sink;
+}
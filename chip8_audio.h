@@ -0,0 +1,89 @@
+#pragma once
+
+#include "chip8.h"
+
+/*
+    Audio:
+    Synthesizes the tone of an instance from its sound timer. The thread
+    running the instance forwards the sound events it polls, which carry
+    the cycle the timer started or stopped on, and the tone is rendered
+    sample-accurately between them at the configured sample rate. That
+    thread only pushes spans of silence and of the tone, counted in
+    samples, into a single-producer single-consumer ring. A sink thread
+    synthesizes them as runs of one level and hands the samples to the
+    sink.
+
+    A real-time sink, one playing the samples as they come, never stalls
+    emulation: while the ring is full its samples are dropped and counted.
+    Every other sink makes the feeding thread wait for room instead and
+    gets every sample, so a file written from the same events is the same
+    whichever tier ran the instance.
+
+    The tone is a 128-bit waveform pattern played in a loop, a square wave
+    by default. `chip8_audio_set_pattern` takes the pattern buffers of
+    XO-CHIP style roms.
+
+    An audio is bound to the instance it was created for and fed from the
+    thread running it.
+*/
+
+enum
+{
+    C8_AUDIO_OK = 0,
+    C8_AUDIO_OPEN_FAILED,
+    C8_AUDIO_OUT_OF_MEMORY,
+};
+
+enum
+{
+    C8_AUDIO_DEFAULT_SAMPLE_RATE = 44100,
+    // Spans, about one per call feeding the audio
+    C8_AUDIO_DEFAULT_RING_SIZE = 1 << 14,
+    C8_AUDIO_DEFAULT_TONE = 440,
+    C8_AUDIO_PATTERN_SIZE = 16,
+};
+
+typedef struct Chip8AudioSink
+{
+    // Called on the sink thread with mono 16-bit samples
+    void (*write)(void *context, const i16 *samples, const ui32 num_samples);
+    // Called once the sink thread stopped, may be NULL
+    void (*close)(void *context);
+    void *context;
+    // Drop samples while the ring is full rather than wait for room
+    ui8 real_time;
+} Chip8AudioSink;
+
+typedef struct Chip8AudioDesc
+{
+    ui32 sample_rate;
+    // Spans the ring holds, a power of two
+    ui32 ring_size;
+} Chip8AudioDesc;
+
+typedef struct Chip8AudioStats
+{
+    ui64 num_samples;
+    // Part of `num_samples` that found the ring full, only a real-time sink drops any
+    ui64 num_dropped;
+} Chip8AudioStats;
+
+typedef struct Chip8Audio Chip8Audio;
+
+// Starts a sink thread, rendering starts at the current cycle of `chip8`, NULL on failure
+Chip8Audio *chip8_audio_create(const Chip8AudioDesc *desc, const Chip8AudioSink *sink, const Chip8 *chip8);
+// Hands the samples rendered so far to the sink, stops the sink thread and closes the sink
+void chip8_audio_destroy(Chip8Audio *audio, Chip8AudioStats *stats);
+
+// Plays `pattern` from its most significant bit, `bit_rate` bits per second, instead of the square wave from the next sample rendered
+void chip8_audio_set_pattern(Chip8Audio *audio, const ui8 pattern[C8_AUDIO_PATTERN_SIZE], const ui32 bit_rate);
+
+// Renders up to the cycle of a sound event and switches the tone, other events are ignored
+void chip8_audio_event(Chip8Audio *audio, const Chip8 *chip8, const Chip8Event *event);
+// Renders up to the current cycle of `chip8` and follows its sound timer, covering events that were dropped or not forwarded
+void chip8_audio_update(Chip8Audio *audio, const Chip8 *chip8);
+
+// Writes a 16-bit mono WAV file, its sizes are filled in when the sink is closed
+i32 chip8_audio_sink_wav(const char *wav_file_path, const ui32 sample_rate, Chip8AudioSink *sink);
+// Discards every sample, for measuring the cost of synthesis itself
+Chip8AudioSink chip8_audio_sink_null(void);
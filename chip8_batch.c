@@ -0,0 +1,567 @@
+#include "chip8_batch.h"
+#include "chip8_ops.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static ui8 chip8_batch_read(const Chip8Batch *batch, const ui32 lane, const ui16 address)
+{
+    const ui16 wrapped_address = address & (C8_MEMORY_SIZE - 1);
+    const ui8 *page = batch->pages[lane * C8_BATCH_NUM_PAGES + wrapped_address / C8_BATCH_PAGE_SIZE];
+    return page[wrapped_address % C8_BATCH_PAGE_SIZE];
+}
+
+/*
+    Copy on first write:
+    Stores first make the lane own every page they touch, so a lane that
+    cannot get a private copy faults before it changed anything. Returns 0
+    when a copy could not be allocated.
+*/
+static ui8 chip8_batch_reserve(Chip8Batch *batch, const ui32 lane, const ui16 address, const ui16 size)
+{
+    for(ui16 offset = 0; offset < size; ++offset)
+    {
+        const ui16 page_index = ((address + offset) & (C8_MEMORY_SIZE - 1)) / C8_BATCH_PAGE_SIZE;
+        ui8 **page = &batch->pages[lane * C8_BATCH_NUM_PAGES + page_index];
+        ui8 *shared_page = &batch->shared_memory[page_index * C8_BATCH_PAGE_SIZE];
+        if(*page != shared_page)
+            continue;
+
+        ui8 *private_page = malloc(C8_BATCH_PAGE_SIZE);
+        if(private_page == NULL)
+            return 0;
+        memcpy(private_page, shared_page, C8_BATCH_PAGE_SIZE);
+        *page = private_page;
+    }
+    return 1;
+}
+
+// Only after `chip8_batch_reserve` succeeded for the address
+static void chip8_batch_write(Chip8Batch *batch, const ui32 lane, const ui16 address, const ui8 value)
+{
+    const ui16 wrapped_address = address & (C8_MEMORY_SIZE - 1);
+    batch->pages[lane * C8_BATCH_NUM_PAGES + wrapped_address / C8_BATCH_PAGE_SIZE][wrapped_address % C8_BATCH_PAGE_SIZE] = value;
+}
+
+static ui16 chip8_batch_fetch(const Chip8Batch *batch, const ui32 lane)
+{
+    const ui16 program_counter = batch->program_counter[lane];
+    return chip8_batch_read(batch, lane, program_counter) << 8 | chip8_batch_read(batch, lane, program_counter + 1);
+}
+
+static void chip8_batch_advance(Chip8Batch *batch)
+{
+    for(ui32 lane = 0; lane < batch->num_lanes; ++lane)
+        batch->program_counter[lane] += 2;
+}
+
+/*
+    Runs `opcode` on every lane at once. Returns 0 for instructions that
+    have no lane-parallel form, those are stepped per lane instead.
+*/
+static ui8 chip8_batch_step_uniform(Chip8Batch *batch, const ui16 opcode)
+{
+    const ui32 num_lanes = batch->num_lanes;
+    const ui8 x = (opcode & 0x0F00) >> 8;
+    const ui8 y = (opcode & 0x00F0) >> 4;
+    const ui8 nn = opcode & 0x00FF;
+    const ui16 nnn = opcode & 0x0FFF;
+    ui8 *vx = batch->registers[x];
+    ui8 *vy = batch->registers[y];
+    ui8 *vf = batch->registers[0xF];
+    ui16 *program_counter = batch->program_counter;
+
+    switch(opcode & 0xF000)
+    {
+        case 0x1000:
+            for(ui32 lane = 0; lane < num_lanes; ++lane)
+                program_counter[lane] = nnn;
+            return 1;
+        case 0x3000:
+            for(ui32 lane = 0; lane < num_lanes; ++lane)
+                program_counter[lane] += vx[lane] == nn ? 4 : 2;
+            return 1;
+        case 0x4000:
+            for(ui32 lane = 0; lane < num_lanes; ++lane)
+                program_counter[lane] += vx[lane] != nn ? 4 : 2;
+            return 1;
+        case 0x5000:
+            for(ui32 lane = 0; lane < num_lanes; ++lane)
+                program_counter[lane] += vx[lane] == vy[lane] ? 4 : 2;
+            return 1;
+        case 0x9000:
+            for(ui32 lane = 0; lane < num_lanes; ++lane)
+                program_counter[lane] += vx[lane] != vy[lane] ? 4 : 2;
+            return 1;
+        case 0x6000:
+            memset(vx, nn, num_lanes);
+            chip8_batch_advance(batch);
+            return 1;
+        case 0x7000:
+            for(ui32 lane = 0; lane < num_lanes; ++lane)
+                vx[lane] += nn;
+            chip8_batch_advance(batch);
+            return 1;
+        case 0x8000:
+        {
+            // Constant ops let each loop keep only its own ALU op
+            const ui32 quirk_flags = batch->quirk_flags;
+            switch(opcode & 0x000F)
+            {
+                #define C8_BATCH_ALU_CASE(n) \
+                    case n: \
+                        for(ui32 lane = 0; lane < num_lanes; ++lane) \
+                            chip8_alu(n, &vx[lane], vy[lane], &vf[lane], quirk_flags); \
+                        break;
+                C8_BATCH_ALU_CASE(0x0)
+                C8_BATCH_ALU_CASE(0x1)
+                C8_BATCH_ALU_CASE(0x2)
+                C8_BATCH_ALU_CASE(0x3)
+                C8_BATCH_ALU_CASE(0x4)
+                C8_BATCH_ALU_CASE(0x5)
+                C8_BATCH_ALU_CASE(0x6)
+                C8_BATCH_ALU_CASE(0x7)
+                C8_BATCH_ALU_CASE(0xE)
+                #undef C8_BATCH_ALU_CASE
+                default:
+                    return 0;
+            }
+            chip8_batch_advance(batch);
+            return 1;
+        }
+        case 0xA000:
+            for(ui32 lane = 0; lane < num_lanes; ++lane)
+                batch->index_register[lane] = nnn;
+            chip8_batch_advance(batch);
+            return 1;
+        case 0xF000:
+            switch(nn)
+            {
+                case 0x07:
+                    memcpy(vx, batch->delay_timer, num_lanes);
+                    break;
+                case 0x15:
+                    memcpy(batch->delay_timer, vx, num_lanes);
+                    break;
+                case 0x18:
+                    memcpy(batch->sound_timer, vx, num_lanes);
+                    break;
+                case 0x1E:
+                    for(ui32 lane = 0; lane < num_lanes; ++lane)
+                        batch->index_register[lane] = (batch->index_register[lane] + vx[lane]) & (C8_MEMORY_SIZE - 1);
+                    break;
+                default:
+                    return 0;
+            }
+            chip8_batch_advance(batch);
+            return 1;
+    }
+
+    return 0;
+}
+
+// Stops a lane on the instruction it could not run or does not implement, see `Chip8Batch.halted`
+static ui8 chip8_batch_halt(Chip8Batch *batch, const ui32 lane)
+{
+    batch->halted[lane] = 1;
+    ++batch->num_halted;
+    return C8_EVENT_FAULT;
+}
+
+// Runs `opcode` on a single lane with the semantics of the core handlers
+static ui8 chip8_batch_step_lane(Chip8Batch *batch, const ui32 lane, const ui16 opcode)
+{
+    if(batch->halted[lane])
+        return C8_EVENT_FAULT;
+
+    const ui8 x = (opcode & 0x0F00) >> 8;
+    const ui8 y = (opcode & 0x00F0) >> 4;
+    const ui8 n = opcode & 0x000F;
+    const ui8 nn = opcode & 0x00FF;
+    const ui16 nnn = opcode & 0x0FFF;
+    ui8 *vx = &batch->registers[x][lane];
+    ui8 *vy = &batch->registers[y][lane];
+    ui8 *vf = &batch->registers[0xF][lane];
+    ui16 *program_counter = &batch->program_counter[lane];
+    ui16 *index_register = &batch->index_register[lane];
+    ui16 *stack_pointer = &batch->stack_pointer[lane];
+
+    ui16 add_program_counter = 2;
+    ui8 event = 0;
+    switch(opcode & 0xF000)
+    {
+        case 0x0000:
+            if(nn == 0xE0)
+            {
+                memset(batch->screen_memory[lane], 0, sizeof(batch->screen_memory[lane]));
+                batch->dirty_rows[lane] = 0xFFFFFFFF;
+            }
+            else if(nn == 0xEE)
+            {
+                // Like the core, returning from an empty stack faults and steps past the return
+                if(*stack_pointer - 1u >= C8_NUM_STACK_LEVELS)
+                {
+                    event = C8_EVENT_FAULT;
+                    break;
+                }
+                --*stack_pointer;
+                *program_counter = batch->stack_levels[*stack_pointer][lane];
+            }
+            else
+                return chip8_batch_halt(batch, lane);
+            break;
+        case 0x1000:
+            *program_counter = nnn;
+            add_program_counter = 0;
+            break;
+        case 0x2000:
+            // And so does a call with every level taken
+            if(*stack_pointer >= C8_NUM_STACK_LEVELS)
+            {
+                event = C8_EVENT_FAULT;
+                break;
+            }
+            batch->stack_levels[*stack_pointer][lane] = *program_counter;
+            ++*stack_pointer;
+            *program_counter = nnn;
+            add_program_counter = 0;
+            break;
+        case 0x3000:
+            if(*vx == nn)
+                add_program_counter += 2;
+            break;
+        case 0x4000:
+            if(*vx != nn)
+                add_program_counter += 2;
+            break;
+        case 0x5000:
+            if(*vx == *vy)
+                add_program_counter += 2;
+            break;
+        case 0x6000:
+            *vx = nn;
+            break;
+        case 0x7000:
+            *vx += nn;
+            break;
+        case 0x8000:
+            if(n > 0x7 && n != 0xE)
+                return chip8_batch_halt(batch, lane);
+            chip8_alu(n, vx, *vy, vf, batch->quirk_flags);
+            break;
+        case 0x9000:
+            if(*vx != *vy)
+                add_program_counter += 2;
+            break;
+        case 0xA000:
+            *index_register = nnn;
+            break;
+        case 0xB000:
+            *program_counter = chip8_jump_offset_target(nnn, batch->registers[0][lane], *vx, batch->quirk_flags);
+            add_program_counter = 0;
+            break;
+        case 0xC000:
+            *vx = (ui8)(nn & chip8_random_byte(&batch->random_state[lane]));
+            break;
+        case 0xD000:
+        {
+            // DXY0 draws a 16x16 SCHIP sprite
+            if(n == 0)
+                return chip8_batch_halt(batch, lane);
+
+            const ui8 screen_position_x = *vx % C8_SCREEN_WIDTH;
+            const ui8 screen_position_y = *vy % C8_SCREEN_HEIGHT;
+            const ui8 sprite_height = chip8_sprite_height(n, screen_position_y, batch->quirk_flags);
+            ui64 *screen_memory = batch->screen_memory[lane];
+
+            ui64 collision = 0;
+            ui32 dirty_rows = 0;
+            for(ui8 row = 0; row < sprite_height; ++row)
+            {
+                const ui8 screen_row = (screen_position_y + row) % C8_SCREEN_HEIGHT;
+                const ui64 sprite_pixels = chip8_sprite_row(chip8_batch_read(batch, lane, *index_register + row), screen_position_x, batch->quirk_flags);
+
+                collision |= screen_memory[screen_row] & sprite_pixels;
+                screen_memory[screen_row] ^= sprite_pixels;
+                dirty_rows |= (ui32)(sprite_pixels != 0) << screen_row;
+            }
+
+            *vf = collision != 0;
+            batch->dirty_rows[lane] |= dirty_rows;
+            event = C8_EVENT_DRAW;
+            break;
+        }
+        case 0xE000:
+        {
+            if(nn != 0x9E && nn != 0xA1)
+                return chip8_batch_halt(batch, lane);
+            const ui8 key_state = (batch->keys[lane] >> (*vx % C8_NUM_KEYS)) & 1;
+            if((nn == 0x9E && key_state == 1) || (nn == 0xA1 && key_state == 0))
+                add_program_counter += 2;
+            break;
+        }
+        case 0xF000:
+            switch(nn)
+            {
+                case 0x07:
+                    *vx = batch->delay_timer[lane];
+                    break;
+                case 0x0A:
+                    if(batch->keys[lane] == 0)
+                    {
+                        add_program_counter = 0;
+                        event = C8_EVENT_KEY_WAIT;
+                        break;
+                    }
+                    for(ui8 i = 0; i < C8_NUM_KEYS; ++i)
+                    {
+                        if(batch->keys[lane] & (1 << i))
+                        {
+                            *vx = i;
+                            break;
+                        }
+                    }
+                    break;
+                case 0x15:
+                    batch->delay_timer[lane] = *vx;
+                    break;
+                case 0x18:
+                    batch->sound_timer[lane] = *vx;
+                    break;
+                case 0x1E:
+                    *index_register = (*index_register + *vx) & (C8_MEMORY_SIZE - 1);
+                    break;
+                case 0x29:
+                    *index_register = chip8_font_address(*vx);
+                    break;
+                case 0x33:
+                {
+                    if(!chip8_batch_reserve(batch, lane, *index_register, 3))
+                        return chip8_batch_halt(batch, lane);
+                    ui8 digits[3];
+                    chip8_bcd(*vx, digits);
+                    for(ui8 i = 0; i < 3; ++i)
+                        chip8_batch_write(batch, lane, *index_register + i, digits[i]);
+                    break;
+                }
+                case 0x55:
+                    if(!chip8_batch_reserve(batch, lane, *index_register, x + 1))
+                        return chip8_batch_halt(batch, lane);
+                    for(ui8 i = 0; i <= x; ++i)
+                        chip8_batch_write(batch, lane, *index_register + i, batch->registers[i][lane]);
+                    *index_register += chip8_load_store_increment(x, batch->quirk_flags);
+                    break;
+                case 0x65:
+                    for(ui8 i = 0; i <= x; ++i)
+                        batch->registers[i][lane] = chip8_batch_read(batch, lane, *index_register + i);
+                    *index_register += chip8_load_store_increment(x, batch->quirk_flags);
+                    break;
+                default:
+                    return chip8_batch_halt(batch, lane);
+            }
+            break;
+    }
+
+    *program_counter += add_program_counter;
+    return event;
+}
+
+Chip8Batch *chip8_batch_create(const ui32 num_lanes, const Chip8 *image)
+{
+    if(num_lanes == 0 || image == NULL || image->hires)
+        return NULL;
+
+    Chip8Batch *batch = calloc(1, sizeof(Chip8Batch));
+    if(batch == NULL)
+        return NULL;
+
+    batch->num_lanes = num_lanes;
+
+    ui8 allocated = 1;
+    for(ui8 i = 0; i < C8_NUM_REGISTERS; ++i)
+        allocated &= (batch->registers[i] = calloc(num_lanes, sizeof(ui8))) != NULL;
+    for(ui8 i = 0; i < C8_NUM_STACK_LEVELS; ++i)
+        allocated &= (batch->stack_levels[i] = calloc(num_lanes, sizeof(ui16))) != NULL;
+    allocated &= (batch->index_register = calloc(num_lanes, sizeof(ui16))) != NULL;
+    allocated &= (batch->program_counter = calloc(num_lanes, sizeof(ui16))) != NULL;
+    allocated &= (batch->screen_memory = calloc(num_lanes, sizeof(*batch->screen_memory))) != NULL;
+    allocated &= (batch->dirty_rows = calloc(num_lanes, sizeof(ui32))) != NULL;
+    allocated &= (batch->delay_timer = calloc(num_lanes, sizeof(ui8))) != NULL;
+    allocated &= (batch->sound_timer = calloc(num_lanes, sizeof(ui8))) != NULL;
+    allocated &= (batch->stack_pointer = calloc(num_lanes, sizeof(ui16))) != NULL;
+    allocated &= (batch->keys = calloc(num_lanes, sizeof(ui16))) != NULL;
+    allocated &= (batch->random_state = calloc(num_lanes, sizeof(ui64))) != NULL;
+    allocated &= (batch->halted = calloc(num_lanes, sizeof(ui8))) != NULL;
+    allocated &= (batch->pages = calloc((size_t)num_lanes * C8_BATCH_NUM_PAGES, sizeof(ui8*))) != NULL;
+    allocated &= (batch->shared_memory = malloc(C8_MEMORY_SIZE)) != NULL;
+    if(!allocated)
+    {
+        chip8_batch_destroy(batch);
+        return NULL;
+    }
+
+    memcpy(batch->shared_memory, image->memory, C8_MEMORY_SIZE);
+    batch->cycle_count = image->cycle_count;
+    batch->cycles_per_frame = image->cycles_per_frame != 0 ? image->cycles_per_frame : C8_DEFAULT_CYCLES_PER_FRAME;
+    batch->frame_cycles = image->frame_cycles % batch->cycles_per_frame;
+    batch->rom_hash = image->rom_hash;
+    batch->quirks = image->quirks;
+    batch->quirk_flags = chip8_quirks_flags(image->quirks);
+
+    ui16 keys = 0;
+    for(ui8 i = 0; i < C8_NUM_KEYS; ++i)
+        keys |= (image->keys[i] != 0) << i;
+
+    for(ui32 lane = 0; lane < num_lanes; ++lane)
+    {
+        for(ui8 i = 0; i < C8_NUM_REGISTERS; ++i)
+            batch->registers[i][lane] = image->registers[i];
+        for(ui8 i = 0; i < C8_NUM_STACK_LEVELS; ++i)
+            batch->stack_levels[i][lane] = image->stack_levels[i];
+        for(ui16 page = 0; page < C8_BATCH_NUM_PAGES; ++page)
+            batch->pages[lane * C8_BATCH_NUM_PAGES + page] = &batch->shared_memory[page * C8_BATCH_PAGE_SIZE];
+
+        batch->index_register[lane] = image->index_register;
+        batch->program_counter[lane] = image->program_counter;
+        memcpy(batch->screen_memory[lane], image->screen_memory, sizeof(batch->screen_memory[lane]));
+        batch->dirty_rows[lane] = image->dirty_rows;
+        batch->delay_timer[lane] = image->delay_timer;
+        batch->sound_timer[lane] = image->sound_timer;
+        batch->stack_pointer[lane] = image->stack_pointer;
+        batch->keys[lane] = keys;
+        batch->random_state[lane] = image->random_state;
+    }
+
+    return batch;
+}
+
+void chip8_batch_destroy(Chip8Batch *batch)
+{
+    if(batch == NULL)
+        return;
+
+    if(batch->pages != NULL && batch->shared_memory != NULL)
+    {
+        for(ui32 lane = 0; lane < batch->num_lanes; ++lane)
+        {
+            for(ui16 page = 0; page < C8_BATCH_NUM_PAGES; ++page)
+            {
+                ui8 *lane_page = batch->pages[lane * C8_BATCH_NUM_PAGES + page];
+                if(lane_page != &batch->shared_memory[page * C8_BATCH_PAGE_SIZE])
+                    free(lane_page);
+            }
+        }
+    }
+
+    for(ui8 i = 0; i < C8_NUM_REGISTERS; ++i)
+        free(batch->registers[i]);
+    for(ui8 i = 0; i < C8_NUM_STACK_LEVELS; ++i)
+        free(batch->stack_levels[i]);
+    free(batch->index_register);
+    free(batch->program_counter);
+    free(batch->screen_memory);
+    free(batch->dirty_rows);
+    free(batch->delay_timer);
+    free(batch->sound_timer);
+    free(batch->stack_pointer);
+    free(batch->keys);
+    free(batch->random_state);
+    free(batch->halted);
+    free(batch->pages);
+    free(batch->shared_memory);
+    free(batch);
+}
+
+void chip8_batch_step(Chip8Batch *batch, ui8 *events)
+{
+    const ui32 num_lanes = batch->num_lanes;
+    ++batch->cycle_count;
+    ++batch->frame_cycles;
+
+    // Lanes running in lockstep usually share the opcode
+    const ui16 opcode = chip8_batch_fetch(batch, 0);
+    ui32 lane = 1;
+    while(lane < num_lanes && chip8_batch_fetch(batch, lane) == opcode)
+        ++lane;
+
+    if(lane == num_lanes && batch->num_halted == 0 && chip8_batch_step_uniform(batch, opcode))
+    {
+        if(events)
+            memset(events, 0, num_lanes);
+    }
+    else
+    {
+        for(lane = 0; lane < num_lanes; ++lane)
+        {
+            const ui8 event = chip8_batch_step_lane(batch, lane, chip8_batch_fetch(batch, lane));
+            if(events)
+                events[lane] = event;
+        }
+    }
+
+    if(batch->frame_cycles == batch->cycles_per_frame)
+    {
+        batch->frame_cycles = 0;
+        chip8_batch_update_timers(batch);
+    }
+}
+
+void chip8_batch_update_timers(Chip8Batch *batch)
+{
+    for(ui32 lane = 0; lane < batch->num_lanes; ++lane)
+        chip8_tick_timers(&batch->delay_timer[lane], &batch->sound_timer[lane]);
+}
+
+void chip8_batch_feed_input(Chip8Batch *batch, const ui32 lane, const Chip8InputKey *keys, const ui8 num_keys)
+{
+    if(keys == NULL || num_keys == 0 || lane >= batch->num_lanes)
+        return;
+
+    for(ui8 i = 0; i < num_keys && i < C8_NUM_KEYS; ++i)
+    {
+        const ui16 key_bit = 1 << (keys[i].key_index % C8_NUM_KEYS);
+        if(keys[i].key_state)
+            batch->keys[lane] |= key_bit;
+        else
+            batch->keys[lane] &= ~key_bit;
+    }
+}
+
+void chip8_batch_extract(const Chip8Batch *batch, const ui32 lane, Chip8 *chip8)
+{
+    memset(chip8, 0, sizeof(Chip8));
+
+    for(ui16 page = 0; page < C8_BATCH_NUM_PAGES; ++page)
+        memcpy(&chip8->memory[page * C8_BATCH_PAGE_SIZE], batch->pages[lane * C8_BATCH_NUM_PAGES + page], C8_BATCH_PAGE_SIZE);
+    for(ui8 i = 0; i < C8_NUM_REGISTERS; ++i)
+        chip8->registers[i] = batch->registers[i][lane];
+    for(ui8 i = 0; i < C8_NUM_STACK_LEVELS; ++i)
+        chip8->stack_levels[i] = batch->stack_levels[i][lane];
+    for(ui8 i = 0; i < C8_NUM_KEYS; ++i)
+        chip8->keys[i] = (batch->keys[lane] >> i) & 1;
+
+    chip8->index_register = batch->index_register[lane];
+    chip8->program_counter = batch->program_counter[lane];
+    memcpy(chip8->screen_memory, batch->screen_memory[lane], sizeof(batch->screen_memory[lane]));
+    chip8->dirty_rows = batch->dirty_rows[lane];
+    chip8->delay_timer = batch->delay_timer[lane];
+    chip8->sound_timer = batch->sound_timer[lane];
+    chip8->stack_pointer = batch->stack_pointer[lane];
+    chip8->random_state = batch->random_state[lane];
+    if(batch->halted[lane])
+    {
+        chip8->num_faults = 1;
+        chip8->fault_opcode = chip8_batch_fetch(batch, lane);
+    }
+    chip8->cycle_count = batch->cycle_count;
+    chip8->cycles_per_frame = batch->cycles_per_frame;
+    chip8->frame_cycles = batch->frame_cycles;
+    chip8->rom_hash = batch->rom_hash;
+    chip8->quirks = batch->quirks;
+}
+
+void chip8_batch_seed(Chip8Batch *batch, const ui32 lane, const ui64 seed)
+{
+    if(lane < batch->num_lanes)
+        batch->random_state[lane] = chip8_random_state_from_seed(seed);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "chip8.h"
+
+/*
+    Batched multi-instance engine:
+    Keeps the machine state of `num_lanes` instances in structure-of-arrays
+    layout and steps every lane in lockstep with `chip8_run_program`
+    semantics. When all lanes fetch the same opcode the instruction runs as
+    one loop over the lane arrays, otherwise each lane is stepped on its own.
+
+    Memory is split into pages. Every lane starts out mapping the pages of a
+    shared read-only image and gets a private copy of a page on its first
+    write to it.
+
+    Lanes keep the lo-res screen only. A lane halts on any instruction the
+    engine does not implement: SCHIP opcodes (00CN, 00FB to 00FF, DXY0,
+    FX30, FX75 and FX85) and the opcodes the core does not decode either.
+    So does a lane that cannot get the private copy of a page it stores to,
+    nothing of the store written. A halted lane keeps `program_counter` on
+    that instruction and every later step reports `C8_EVENT_FAULT` for it.
+
+    Calls into a full stack and returns from an empty one report
+    `C8_EVENT_FAULT` and step past the instruction, like in the core.
+*/
+
+enum
+{
+    C8_BATCH_PAGE_SIZE = 256,
+    C8_BATCH_NUM_PAGES = C8_MEMORY_SIZE / C8_BATCH_PAGE_SIZE,
+};
+
+typedef struct Chip8Batch
+{
+    ui32 num_lanes;
+    // Lanes run in lockstep and share one instruction count, virtual clock and rom
+    ui64 cycle_count;
+    ui32 cycles_per_frame;
+    ui32 frame_cycles;
+    ui64 rom_hash;
+    // Quirks profile of the image, its `C8_QUIRK_*` flags are tested per instruction
+    ui8 quirks;
+    ui32 quirk_flags;
+
+    // Every array below has one entry per lane
+    ui8 *registers[C8_NUM_REGISTERS];
+    ui16 *index_register;
+    ui16 *program_counter;
+
+    ui64 (*screen_memory)[C8_SCREEN_HEIGHT];
+    ui32 *dirty_rows;
+
+    ui8 *delay_timer;
+    ui8 *sound_timer;
+
+    ui16 *stack_levels[C8_NUM_STACK_LEVELS];
+    ui16 *stack_pointer;
+
+    // One bit per key
+    ui16 *keys;
+    ui64 *random_state;
+    ui8 *halted;
+    // Lanes halted so far, any of them keeps the batch off the lane-parallel path
+    ui32 num_halted;
+
+    // `num_lanes * C8_BATCH_NUM_PAGES` page pointers, into `shared_memory` until written
+    ui8 **pages;
+    ui8 *shared_memory;
+} Chip8Batch;
+
+// Every lane starts as a copy of `image`, typically an instance after `chip8_init` and `chip8_load_rom`, returns NULL for a hi-res image
+Chip8Batch *chip8_batch_create(const ui32 num_lanes, const Chip8 *image);
+void chip8_batch_destroy(Chip8Batch *batch);
+
+// Runs one instruction on every lane and ticks the timers on frame boundaries, `events` receives one event per lane and may be NULL
+void chip8_batch_step(Chip8Batch *batch, ui8 *events);
+void chip8_batch_update_timers(Chip8Batch *batch);
+// Lanes start with the generator state of the image, reseed them to let them diverge
+void chip8_batch_seed(Chip8Batch *batch, const ui32 lane, const ui64 seed);
+void chip8_batch_feed_input(Chip8Batch *batch, const ui32 lane, const Chip8InputKey *keys, const ui8 num_keys);
+
+// Copies the state of one lane into a regular instance
+void chip8_batch_extract(const Chip8Batch *batch, const ui32 lane, Chip8 *chip8);
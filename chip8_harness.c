@@ -0,0 +1,75 @@
+#include "chip8_harness.h"
+
+#include <time.h>
+
+ui64 chip8_hash_bytes(ui64 hash, const void *data, const size_t size)
+{
+    const ui8 *bytes = (const ui8*)data;
+    for(size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+ui64 chip8_state_hash(const Chip8 *chip8)
+{
+    ui64 hash = 0xCBF29CE484222325ULL;
+    hash = chip8_hash_bytes(hash, chip8->memory, sizeof(chip8->memory));
+    hash = chip8_hash_bytes(hash, chip8->registers, sizeof(chip8->registers));
+    hash = chip8_hash_bytes(hash, &chip8->index_register, sizeof(chip8->index_register));
+    hash = chip8_hash_bytes(hash, &chip8->program_counter, sizeof(chip8->program_counter));
+    ui8 screen[C8_HIRES_SCREEN_SIZE];
+    const ui32 screen_size = chip8_screen_packed(chip8, screen);
+    hash = chip8_hash_bytes(hash, screen, screen_size);
+    hash = chip8_hash_bytes(hash, &chip8->delay_timer, sizeof(chip8->delay_timer));
+    hash = chip8_hash_bytes(hash, &chip8->sound_timer, sizeof(chip8->sound_timer));
+    hash = chip8_hash_bytes(hash, chip8->stack_levels, sizeof(chip8->stack_levels));
+    hash = chip8_hash_bytes(hash, &chip8->stack_pointer, sizeof(chip8->stack_pointer));
+    return hash;
+}
+
+double chip8_now_seconds(void)
+{
+    struct timespec time_now;
+    timespec_get(&time_now, TIME_UTC);
+    return (double)time_now.tv_sec + (double)time_now.tv_nsec * 1e-9;
+}
+
+// Draws one byte per frame until one flips a key, returns how many frames ahead that is
+static ui64 chip8_key_script_frames(Chip8KeyScript *script)
+{
+    for(ui64 num_frames = 1;; ++num_frames)
+    {
+        const ui8 random = chip8_random_byte(&script->random_state);
+        if(random % C8_KEY_SCRIPT_PERIOD == 0)
+        {
+            script->key_index = (random >> 4) % C8_NUM_KEYS;
+            return num_frames;
+        }
+    }
+}
+
+void chip8_key_script_start(Chip8KeyScript *script, const Chip8 *chip8, const ui64 seed)
+{
+    script->random_state = chip8_random_state_from_seed(seed);
+    script->key_index = 0;
+    script->next_cycle = chip8->cycle_count + chip8_cycles_to_frame(chip8) + (chip8_key_script_frames(script) - 1) * chip8->cycles_per_frame;
+}
+
+ui64 chip8_key_script_cycles(const Chip8KeyScript *script, const Chip8 *chip8)
+{
+    return script->next_cycle - chip8->cycle_count;
+}
+
+ui8 chip8_key_script_next(Chip8KeyScript *script, const Chip8 *chip8, Chip8InputKey *key)
+{
+    if(chip8->cycle_count != script->next_cycle)
+        return 0;
+
+    key->key_index = script->key_index;
+    key->key_state = !chip8->keys[script->key_index];
+    script->next_cycle += chip8_key_script_frames(script) * chip8->cycles_per_frame;
+    return 1;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "chip8.h"
+
+#include <stddef.h>
+
+/*
+    Tool harness:
+    What the headless runner and the benchmark suite share, a hash of the
+    machine state their results are compared by, a wall clock and the
+    scripted random keys both drive roms with.
+*/
+
+enum
+{
+    // Scripted input flips one random key every this many frames on average
+    C8_KEY_SCRIPT_PERIOD = 4,
+};
+
+// FNV-1a of `data` continuing from `hash`
+ui64 chip8_hash_bytes(ui64 hash, const void *data, const size_t size);
+// Memory, registers, screen, timers and stack, equal hashes mean the same behaviour so far
+ui64 chip8_state_hash(const Chip8 *chip8);
+double chip8_now_seconds(void);
+
+/*
+    Scripted input:
+    Key edges land on frame boundaries only, so every tier reaches them on
+    the same cycle. The script is a function of its seed and the frames
+    run, so runs with the same seed press the same keys.
+*/
+
+typedef struct Chip8KeyScript
+{
+    ui64 random_state;
+    // `Chip8.cycle_count` of the next edge and the key it flips
+    ui64 next_cycle;
+    ui8 key_index;
+} Chip8KeyScript;
+
+void chip8_key_script_start(Chip8KeyScript *script, const Chip8 *chip8, const ui64 seed);
+// Cycles until the next edge, runs stopping there let `chip8_key_script_next` see it
+ui64 chip8_key_script_cycles(const Chip8KeyScript *script, const Chip8 *chip8);
+// Returns 1 and the edge to feed when `chip8` is on it, and schedules the next one
+ui8 chip8_key_script_next(Chip8KeyScript *script, const Chip8 *chip8, Chip8InputKey *key);
@@ -0,0 +1,248 @@
+/*
+    Specialized interpreter:
+    Included by chip8.c once per quirks profile, with `C8_QUIRKS` set to the
+    `C8_QUIRK_*` flags of the profile and `C8_QUIRKS_NAME(name)` giving the
+    names of that copy. Every quirk is tested on the constant `C8_QUIRKS`,
+    so each copy of the handlers below and of the dispatch loop only keeps
+    the code of its own variants.
+*/
+
+// 8XY1: VX |= VY
+static ui8 C8_QUIRKS_NAME(chip8_op_or)(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8_alu(0x1, &chip8->registers[instruction->x], chip8->registers[instruction->y], &chip8->registers[0xF], C8_QUIRKS);
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// 8XY2: VX &= VY
+static ui8 C8_QUIRKS_NAME(chip8_op_and)(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8_alu(0x2, &chip8->registers[instruction->x], chip8->registers[instruction->y], &chip8->registers[0xF], C8_QUIRKS);
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// 8XY3: VX ^= VY
+static ui8 C8_QUIRKS_NAME(chip8_op_xor)(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8_alu(0x3, &chip8->registers[instruction->x], chip8->registers[instruction->y], &chip8->registers[0xF], C8_QUIRKS);
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// 8XY6: VX = VX >> 1, or VY >> 1, VF = shifted out bit
+static ui8 C8_QUIRKS_NAME(chip8_op_shr)(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8_alu(0x6, &chip8->registers[instruction->x], chip8->registers[instruction->y], &chip8->registers[0xF], C8_QUIRKS);
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// 8XYE: VX = VX << 1, or VY << 1, VF = shifted out bit
+static ui8 C8_QUIRKS_NAME(chip8_op_shl)(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8_alu(0xE, &chip8->registers[instruction->x], chip8->registers[instruction->y], &chip8->registers[0xF], C8_QUIRKS);
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// BNNN: Jump to NNN + V0, or to XNN + VX
+static ui8 C8_QUIRKS_NAME(chip8_op_jp_offset)(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    chip8->program_counter = chip8_jump_offset_target(instruction->nnn, chip8->registers[0], chip8->registers[instruction->x], C8_QUIRKS);
+    return 0;
+}
+
+// DXYN: Draw N byte sprite from I at (VX, VY), VF = collision
+static ui8 C8_QUIRKS_NAME(chip8_op_drw)(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    // SCHIP sprites and the hi-res screen keep off the lo-res fast path
+    if(chip8->hires || instruction->n == 0)
+        return chip8_draw_extended(chip8, instruction, (C8_QUIRKS & C8_QUIRK_CLIP) != 0);
+
+    const ui8 screen_position_x = chip8->registers[instruction->x] % C8_SCREEN_WIDTH;
+    const ui8 screen_position_y = chip8->registers[instruction->y] % C8_SCREEN_HEIGHT;
+
+    // Clipped sprites lose the rows below the screen, wrapped ones continue at the top
+    const ui8 sprite_height = chip8_sprite_height(instruction->n, screen_position_y, C8_QUIRKS);
+
+    // Wrapping sprites around the side edges is a rotate, clipping them a shift
+    ui64 collision = 0;
+    ui32 dirty_rows = 0;
+    for(ui8 y = 0; y < sprite_height; ++y)
+    {
+        const ui8 screen_row = (screen_position_y + y) % C8_SCREEN_HEIGHT;
+        const ui8 sprite_row = chip8->memory[(chip8->index_register + y) & (C8_MEMORY_SIZE - 1)];
+        const ui64 sprite_pixels = chip8_sprite_row(sprite_row, screen_position_x, C8_QUIRKS);
+
+        collision |= chip8->screen_memory[screen_row] & sprite_pixels;
+        chip8->screen_memory[screen_row] ^= sprite_pixels;
+        dirty_rows |= (ui32)(sprite_pixels != 0) << screen_row;
+    }
+
+    chip8->registers[0xF] = collision != 0;
+    chip8->dirty_rows |= dirty_rows;
+
+#ifdef C8_PROFILE
+    if(chip8->profile != NULL)
+    {
+        ++chip8->profile->num_draws;
+        chip8->profile->num_collisions += collision != 0;
+    }
+#endif
+
+    chip8->program_counter += 2;
+    return C8_EVENT_DRAW;
+}
+
+// FX55: Store V0..VX at I, I += X + 1 with the increment quirk
+static ui8 C8_QUIRKS_NAME(chip8_op_ld_store)(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    for(ui8 i = 0; i <= instruction->x; ++i)
+        chip8->memory[(chip8->index_register + i) & (C8_MEMORY_SIZE - 1)] = chip8->registers[i];
+    chip8_invalidate_instructions(chip8, chip8->index_register, instruction->x + 1);
+    chip8->index_register += chip8_load_store_increment(instruction->x, C8_QUIRKS);
+    chip8->program_counter += 2;
+    return 0;
+}
+
+// FX65: Load V0..VX from I, I += X + 1 with the increment quirk
+static ui8 C8_QUIRKS_NAME(chip8_op_ld_load)(Chip8 *chip8, const Chip8Instruction *instruction)
+{
+    for(ui8 i = 0; i <= instruction->x; ++i)
+        chip8->registers[i] = chip8->memory[(chip8->index_register + i) & (C8_MEMORY_SIZE - 1)];
+    chip8->index_register += chip8_load_store_increment(instruction->x, C8_QUIRKS);
+    chip8->program_counter += 2;
+    return 0;
+}
+
+#define C8_OP_HANDLER(name, handler) handler,
+static const Chip8Handler C8_QUIRKS_NAME(C8_HANDLERS)[C8_NUM_OPS] = { C8_OPS(C8_OP_HANDLER) };
+#undef C8_OP_HANDLER
+
+static ui32 C8_QUIRKS_NAME(chip8_run_cycles)(Chip8 *chip8, const ui32 max_cycles, ui32 *events_out)
+{
+    Chip8Instruction instruction_storage;
+    const Chip8Instruction *instruction = NULL;
+    ui32 num_cycles = 0;
+    ui32 frame_start = 0;
+    ui32 frame_end = 0;
+    ui32 idle_cycles = 0;
+    ui8 event = 0;
+#ifdef C8_PROFILE
+    ui64 profile_ticks = 0;
+#endif
+
+    // Only the ops that can start an idle loop pay for the check
+    #define C8_IDLE_CHECK(name) \
+        ((C8_OP_##name == C8_OP_LD_VX_DT || C8_OP_##name == C8_OP_LD_VX_K) \
+            && (idle_cycles = chip8_idle_cycles(chip8, instruction, frame_end - num_cycles + 1)) != 0)
+
+#if C8_THREADED_DISPATCH
+    // Computed goto: every handler ends in its own indirect jump to the next one
+    #define C8_OP_LABEL_ADDRESS(name, handler) &&op_##name,
+    static void *const dispatch_table[C8_NUM_OPS] = { C8_OPS(C8_OP_LABEL_ADDRESS) };
+    #undef C8_OP_LABEL_ADDRESS
+
+    #define C8_DISPATCH_NEXT() \
+        if(num_cycles == frame_end) \
+            goto frame_done; \
+        instruction = chip8_fetch_instruction(chip8, &instruction_storage); \
+        ++num_cycles; \
+        goto *dispatch_table[instruction->op]
+
+next_frame:
+    // Every timer tick ends a run of instructions
+    frame_start = num_cycles;
+    frame_end = num_cycles + (max_cycles - num_cycles < chip8_cycles_to_frame(chip8) ? max_cycles - num_cycles : chip8_cycles_to_frame(chip8));
+    C8_DISPATCH_NEXT();
+
+    #define C8_OP_LABEL(name, handler) \
+        op_##name: \
+            C8_PROFILE_ENTER(C8_OP_##name); \
+            if(C8_IDLE_CHECK(name)) \
+                goto idle_skipped; \
+            event = handler(chip8, instruction); \
+            C8_PROFILE_LEAVE(C8_OP_##name); \
+            if(event != 0) \
+                goto frame_done; \
+            C8_DISPATCH_NEXT();
+    C8_OPS(C8_OP_LABEL)
+    #undef C8_OP_LABEL
+
+idle_skipped:
+    C8_PROFILE_LEAVE(instruction->op);
+    chip8->idle_cycles_skipped += idle_cycles;
+    // Key waits end the run, their skipped cycles are counted once the event is queued
+    if(instruction->op == C8_OP_LD_VX_K)
+    {
+        event = C8_EVENT_KEY_WAIT;
+        goto frame_done;
+    }
+    // The wait itself was already counted when it was fetched
+    num_cycles += idle_cycles - 1;
+    C8_DISPATCH_NEXT();
+    #undef C8_DISPATCH_NEXT
+
+frame_done:
+    if(event != 0)
+        chip8_queue_events(chip8, event, chip8->cycle_count + (num_cycles - frame_start) - 1);
+    // `idle_cycles` is the check of the FX0A that raised a key wait, 0 when it ran
+    if(event == C8_EVENT_KEY_WAIT && idle_cycles != 0)
+        num_cycles += idle_cycles - 1;
+    chip8_clock_tick(chip8, num_cycles - frame_start);
+    if(num_cycles < max_cycles && event == 0)
+        goto next_frame;
+#else
+    while(num_cycles < max_cycles && event == 0)
+    {
+        // Every timer tick ends a run of instructions
+        frame_start = num_cycles;
+        frame_end = num_cycles + (max_cycles - num_cycles < chip8_cycles_to_frame(chip8) ? max_cycles - num_cycles : chip8_cycles_to_frame(chip8));
+        while(num_cycles < frame_end)
+        {
+            instruction = chip8_fetch_instruction(chip8, &instruction_storage);
+            ++num_cycles;
+
+            switch(instruction->op)
+            {
+                #define C8_OP_CASE(name, handler) \
+                    case C8_OP_##name: \
+                        C8_PROFILE_ENTER(C8_OP_##name); \
+                        if(C8_IDLE_CHECK(name)) \
+                        { \
+                            chip8->idle_cycles_skipped += idle_cycles; \
+                            if(C8_OP_##name == C8_OP_LD_VX_K) \
+                                event = C8_EVENT_KEY_WAIT; \
+                            else \
+                                num_cycles += idle_cycles - 1; \
+                        } \
+                        else \
+                            event = handler(chip8, instruction); \
+                        C8_PROFILE_LEAVE(C8_OP_##name); \
+                        break;
+                C8_OPS(C8_OP_CASE)
+                #undef C8_OP_CASE
+            }
+
+            // Events end the run early
+            if(event != 0)
+                break;
+        }
+        if(event != 0)
+            chip8_queue_events(chip8, event, chip8->cycle_count + (num_cycles - frame_start) - 1);
+        // Same as `frame_done` above
+        if(event == C8_EVENT_KEY_WAIT && idle_cycles != 0)
+            num_cycles += idle_cycles - 1;
+        chip8_clock_tick(chip8, num_cycles - frame_start);
+    }
+#endif
+
+    #undef C8_IDLE_CHECK
+
+    if(events_out)
+        *events_out = event;
+
+    return num_cycles;
+}
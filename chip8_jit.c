@@ -0,0 +1,850 @@
+#include "chip8_jit.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+    #define C8_JIT_SUPPORTED 1
+    #include <sys/mman.h>
+    #include <unistd.h>
+#else
+    #define C8_JIT_SUPPORTED 0
+#endif
+
+#if C8_JIT_SUPPORTED
+
+enum
+{
+    C8_JIT_ARENA_SIZE = 1 << 20,
+    C8_JIT_MAX_BLOCK_INSTRUCTIONS = 32,
+    // Worst case instruction is 8XY4/8XY5/8XY7 at 33 bytes plus its frame countdown, plus the block prologue and exits
+    C8_JIT_MAX_BLOCK_SIZE = C8_JIT_MAX_BLOCK_INSTRUCTIONS * 48 + 256,
+    C8_JIT_HOT_THRESHOLD = 16,
+    // Marks addresses where compilation failed
+    C8_JIT_NOT_COMPILABLE = 0xFF,
+    // Both sides of a skip
+    C8_JIT_MAX_BLOCK_EXITS = 2,
+    C8_JIT_MAX_LINKS = 1 << 14,
+};
+
+/*
+    Native entry stub: runs the block at `code` and the blocks it chains
+    into on `chip8` for at most `budget` instructions. `cycles_to_frame` is
+    counted down per instruction and the timers tick natively when it
+    reaches 0. Returns the cycles left to the next frame boundary in the low
+    32 bits and the events raised in the high 32 bits, the clock is behind
+    by the instructions run since the last tick.
+*/
+typedef ui64 (*Chip8JitEntry)(Chip8 *chip8, const ui32 cycles_to_frame, const ui32 budget, const void *code);
+
+typedef struct Chip8JitBlock
+{
+    const ui8 *code;
+    ui8 num_instructions;
+    ui8 hits;
+} Chip8JitBlock;
+
+// A `jmp rel32` at arena offset `site` waiting for its target to be compiled
+typedef struct Chip8JitLink
+{
+    ui32 site;
+    ui32 next;
+} Chip8JitLink;
+
+struct Chip8Jit
+{
+    Chip8 *chip8;
+    ui32 code_generation;
+
+    ui8 *arena;
+    ui32 arena_used;
+    ui32 page_size;
+
+    // Shared stubs at the start of the arena
+    Chip8JitEntry enter;
+    const ui8 *bail;
+    const ui8 *epilogue;
+    const ui8 *dispatch;
+    const ui8 *tick;
+    ui32 stubs_size;
+
+    // Indexed by address, roms run code at odd addresses too
+    Chip8JitBlock blocks[C8_MEMORY_SIZE];
+    // Block entries other blocks jump to directly, NULL where the dispatcher has to return to the host
+    const ui8 *link_targets[C8_MEMORY_SIZE];
+    // Unlinked exits chained per target address, 1-based indices into `links`
+    ui32 pending_links[C8_MEMORY_SIZE];
+    Chip8JitLink links[C8_JIT_MAX_LINKS];
+    ui32 num_links;
+};
+
+/*
+    x86-64 emitter:
+    Native code keeps the `Chip8` pointer in rbx, the cycles left to the
+    next frame boundary in r12d and the remaining instruction budget in
+    r14d, every machine state access is an [rbx + disp32] operand. Blocks
+    start by taking their instruction count off the budget and leave by
+    jumping either straight into the next block or to the dispatch stub,
+    which looks the block up by `program_counter` and returns to the host
+    when there is none.
+*/
+
+typedef struct Chip8JitExit
+{
+    ui32 site;
+    ui16 target;
+} Chip8JitExit;
+
+typedef struct Chip8JitEmitter
+{
+    const Chip8Jit *jit;
+    ui8 *code;
+    ui32 size;
+    ui32 num_exits;
+    Chip8JitExit exits[C8_JIT_MAX_BLOCK_EXITS];
+} Chip8JitEmitter;
+
+enum
+{
+    C8_X86_EAX = 0,
+    C8_X86_ECX = 1,
+    C8_X86_EDX = 2,
+};
+
+static void emit8(Chip8JitEmitter *emitter, const ui8 value)
+{
+    emitter->code[emitter->size++] = value;
+}
+
+static void emit16(Chip8JitEmitter *emitter, const ui16 value)
+{
+    emit8(emitter, value & 0xFF);
+    emit8(emitter, value >> 8);
+}
+
+static void emit32(Chip8JitEmitter *emitter, const ui32 value)
+{
+    emit16(emitter, value & 0xFFFF);
+    emit16(emitter, value >> 16);
+}
+
+static void emit64(Chip8JitEmitter *emitter, const ui64 value)
+{
+    emit32(emitter, (ui32)value);
+    emit32(emitter, (ui32)(value >> 32));
+}
+
+// Displacement of a rel32 operand emitted next
+static void emit_rel32(Chip8JitEmitter *emitter, const ui8 *target)
+{
+    emit32(emitter, (ui32)(target - (emitter->code + emitter->size + 4)));
+}
+
+// ModRM for [rbx + disp32] with `reg` in the reg field
+static void emit_state_operand(Chip8JitEmitter *emitter, const ui8 reg, const ui32 offset)
+{
+    emit8(emitter, 0x80 | (reg << 3) | 0x3);
+    emit32(emitter, offset);
+}
+
+static ui32 register_offset(const ui8 register_index)
+{
+    return (ui32)offsetof(Chip8, registers) + register_index;
+}
+
+// movzx reg, byte [rbx + offset]
+static void emit_load_byte(Chip8JitEmitter *emitter, const ui8 reg, const ui32 offset)
+{
+    emit8(emitter, 0x0F);
+    emit8(emitter, 0xB6);
+    emit_state_operand(emitter, reg, offset);
+}
+
+// mov byte [rbx + offset], reg8
+static void emit_store_byte(Chip8JitEmitter *emitter, const ui8 reg, const ui32 offset)
+{
+    emit8(emitter, 0x88);
+    emit_state_operand(emitter, reg, offset);
+}
+
+// mov word [rbx + offset], imm16
+static void emit_store_word_imm(Chip8JitEmitter *emitter, const ui32 offset, const ui16 value)
+{
+    emit8(emitter, 0x66);
+    emit8(emitter, 0xC7);
+    emit_state_operand(emitter, 0, offset);
+    emit16(emitter, value);
+}
+
+// mov rax, imm64; call rax
+static void emit_call(Chip8JitEmitter *emitter, const void *function)
+{
+    emit8(emitter, 0x48); emit8(emitter, 0xB8);
+    emit64(emitter, (ui64)(size_t)function);
+    emit8(emitter, 0xFF); emit8(emitter, 0xD0);
+}
+
+// Counts one instruction off the frame, the tick stub runs the timers on the boundary
+static void emit_countdown(Chip8JitEmitter *emitter)
+{
+    emit8(emitter, 0x41); emit8(emitter, 0xFF); emit8(emitter, 0xCC); // dec r12d
+    emit8(emitter, 0x75); emit8(emitter, 5); // jnz over the call
+    emit8(emitter, 0xE8); // call tick
+    emit_rel32(emitter, emitter->jit->tick);
+}
+
+// Sets `program_counter` and jumps to the dispatcher until the target block gets linked
+static void emit_exit(Chip8JitEmitter *emitter, const ui16 program_counter)
+{
+    emit_store_word_imm(emitter, (ui32)offsetof(Chip8, program_counter), program_counter);
+    emit8(emitter, 0xE9); // jmp rel32
+    Chip8JitExit *exit = &emitter->exits[emitter->num_exits++];
+    exit->site = (ui32)(emitter->code + emitter->size - emitter->jit->arena);
+    exit->target = program_counter;
+    emit_rel32(emitter, emitter->jit->dispatch);
+}
+
+// Ends a block on a conditional skip, flags are already set by a compare
+static void emit_skip_exit(Chip8JitEmitter *emitter, const ui16 program_counter, const ui8 skip_if_equal)
+{
+    // je/jne over the not taken exit, 9 bytes of store and 5 of jump
+    emit8(emitter, skip_if_equal ? 0x74 : 0x75);
+    emit8(emitter, 14);
+    emit_exit(emitter, program_counter + 2);
+    emit_exit(emitter, program_counter + 4);
+}
+
+// Called from native code to run one instruction the emitter does not handle
+static ui32 chip8_jit_interpret(Chip8 *chip8, const ui32 cycles_to_frame)
+{
+    // The clock only catches up on frame boundaries, events are stamped with the cycle of the instruction
+    const ui32 num_preceding = chip8->cycles_per_frame - chip8->frame_cycles - cycles_to_frame;
+    chip8->cycle_count += num_preceding;
+    ui8 event = 0;
+    chip8_run_program(chip8, &event);
+    chip8->cycle_count -= num_preceding;
+    return event;
+}
+
+// Called from the tick stub when the native frame countdown runs out
+static ui32 chip8_jit_tick(Chip8 *chip8)
+{
+    chip8_advance_clock(chip8, chip8_cycles_to_frame(chip8));
+    return chip8_cycles_to_frame(chip8);
+}
+
+// Ends a block by handing the instruction at `program_counter` to the interpreter
+static void emit_interpret_exit(Chip8JitEmitter *emitter, const ui16 program_counter)
+{
+    const Chip8Jit *jit = emitter->jit;
+    emit_store_word_imm(emitter, (ui32)offsetof(Chip8, program_counter), program_counter);
+    emit8(emitter, 0x48); emit8(emitter, 0x89); emit8(emitter, 0xDF); // mov rdi, rbx
+    emit8(emitter, 0x44); emit8(emitter, 0x89); emit8(emitter, 0xE6); // mov esi, r12d
+    emit_call(emitter, (const void*)chip8_jit_interpret);
+    // Timers tick after the instruction like in the interpreter, the tick stub keeps eax
+    emit_countdown(emitter);
+    emit8(emitter, 0x85); emit8(emitter, 0xC0); // test eax, eax
+    emit8(emitter, 0x0F); emit8(emitter, 0x85); // jnz epilogue
+    emit_rel32(emitter, jit->epilogue);
+    // Code stores drop every block, including this one
+    emit8(emitter, 0x8B); // mov ecx, dword [rbx + code_generation]
+    emit_state_operand(emitter, C8_X86_ECX, (ui32)offsetof(Chip8, code_generation));
+    emit8(emitter, 0x81); emit8(emitter, 0xF9); // cmp ecx, imm32
+    emit32(emitter, jit->code_generation);
+    emit8(emitter, 0x0F); emit8(emitter, 0x85); // jne epilogue
+    emit_rel32(emitter, jit->epilogue);
+    emit8(emitter, 0xE9); // jmp dispatch
+    emit_rel32(emitter, jit->dispatch);
+}
+
+// Checks the stack pointer before a call or return, jae to the site returned when it is out of range
+static ui32 emit_stack_guard(Chip8JitEmitter *emitter, const ui8 is_return)
+{
+    emit8(emitter, 0x0F); // movzx eax, word [rbx + SP]
+    emit8(emitter, 0xB7);
+    emit_state_operand(emitter, C8_X86_EAX, (ui32)offsetof(Chip8, stack_pointer));
+    if(is_return)
+    {
+        emit8(emitter, 0xFF); emit8(emitter, 0xC8); // dec eax
+    }
+    emit8(emitter, 0x83); emit8(emitter, 0xF8); emit8(emitter, C8_NUM_STACK_LEVELS); // cmp eax, imm8
+    emit8(emitter, 0x0F); emit8(emitter, 0x83); // jae rel32
+    const ui32 site = emitter->size;
+    emit32(emitter, 0);
+    return site;
+}
+
+// Lands the guard at `site` on the interpreter, which raises the fault
+static void emit_stack_fault(Chip8JitEmitter *emitter, const ui32 site, const ui16 program_counter)
+{
+    const ui32 displacement = emitter->size - (site + 4);
+    memcpy(emitter->code + site, &displacement, sizeof(displacement));
+    emit_interpret_exit(emitter, program_counter);
+}
+
+/*
+    Emits one instruction. Returns 1 if it was compiled, 0 if the block has
+    to end before it. `*ends_block` is set for instructions that change
+    `program_counter`, those emit the block exits themselves and count
+    themselves off the frame first, as they never touch the timers. Only the
+    variants of the default quirks profile are compiled, the others are
+    left to the interpreter copy of their profile.
+*/
+static ui8 emit_instruction(Chip8JitEmitter *emitter, const ui16 opcode, const ui16 program_counter, const ui32 quirks, ui8 *ends_block)
+{
+    const ui8 x = (opcode & 0x0F00) >> 8;
+    const ui8 y = (opcode & 0x00F0) >> 4;
+    const ui8 nn = opcode & 0x00FF;
+    const ui16 nnn = opcode & 0x0FFF;
+
+    *ends_block = 0;
+
+    switch(opcode & 0xF000)
+    {
+        case 0x0000:
+        {
+            if(opcode != 0x00EE)
+                return 0;
+            const ui32 guard_site = emit_stack_guard(emitter, 1);
+            emit_countdown(emitter);
+            emit8(emitter, 0x0F); // movzx eax, word [rbx + SP]
+            emit8(emitter, 0xB7);
+            emit_state_operand(emitter, C8_X86_EAX, (ui32)offsetof(Chip8, stack_pointer));
+            emit8(emitter, 0xFF); emit8(emitter, 0xC8); // dec eax
+            emit8(emitter, 0x66); // mov word [rbx + SP], ax
+            emit8(emitter, 0x89);
+            emit_state_operand(emitter, C8_X86_EAX, (ui32)offsetof(Chip8, stack_pointer));
+            emit8(emitter, 0x0F); // movzx ecx, word [rbx + rax * 2 + stack]
+            emit8(emitter, 0xB7);
+            emit8(emitter, 0x8C);
+            emit8(emitter, 0x43);
+            emit32(emitter, (ui32)offsetof(Chip8, stack_levels));
+            emit8(emitter, 0x83); emit8(emitter, 0xC1); emit8(emitter, 2); // add ecx, 2
+            emit8(emitter, 0x66); // mov word [rbx + PC], cx
+            emit8(emitter, 0x89);
+            emit_state_operand(emitter, C8_X86_ECX, (ui32)offsetof(Chip8, program_counter));
+            emit8(emitter, 0xE9); // jmp dispatch
+            emit_rel32(emitter, emitter->jit->dispatch);
+            emit_stack_fault(emitter, guard_site, program_counter);
+            *ends_block = 1;
+            return 1;
+        }
+        case 0x1000:
+            emit_countdown(emitter);
+            emit_exit(emitter, nnn);
+            *ends_block = 1;
+            return 1;
+        case 0x2000:
+        {
+            const ui32 guard_site = emit_stack_guard(emitter, 0);
+            emit_countdown(emitter);
+            emit8(emitter, 0x0F); // movzx eax, word [rbx + SP]
+            emit8(emitter, 0xB7);
+            emit_state_operand(emitter, C8_X86_EAX, (ui32)offsetof(Chip8, stack_pointer));
+            emit8(emitter, 0x66); // mov word [rbx + rax * 2 + stack], imm16
+            emit8(emitter, 0xC7);
+            emit8(emitter, 0x84);
+            emit8(emitter, 0x43);
+            emit32(emitter, (ui32)offsetof(Chip8, stack_levels));
+            emit16(emitter, program_counter);
+            emit8(emitter, 0xFF); emit8(emitter, 0xC0); // inc eax
+            emit8(emitter, 0x66); // mov word [rbx + SP], ax
+            emit8(emitter, 0x89);
+            emit_state_operand(emitter, C8_X86_EAX, (ui32)offsetof(Chip8, stack_pointer));
+            emit_exit(emitter, nnn);
+            emit_stack_fault(emitter, guard_site, program_counter);
+            *ends_block = 1;
+            return 1;
+        }
+        case 0x3000:
+        case 0x4000:
+            emit_countdown(emitter);
+            emit8(emitter, 0x80); // cmp byte [rbx + VX], imm8
+            emit_state_operand(emitter, 7, register_offset(x));
+            emit8(emitter, nn);
+            emit_skip_exit(emitter, program_counter, (opcode & 0xF000) == 0x3000);
+            *ends_block = 1;
+            return 1;
+        case 0x5000:
+        case 0x9000:
+            if((opcode & 0x000F) != 0)
+                return 0;
+            emit_countdown(emitter);
+            emit_load_byte(emitter, C8_X86_EAX, register_offset(x));
+            emit8(emitter, 0x3A); // cmp al, byte [rbx + VY]
+            emit_state_operand(emitter, C8_X86_EAX, register_offset(y));
+            emit_skip_exit(emitter, program_counter, (opcode & 0xF000) == 0x5000);
+            *ends_block = 1;
+            return 1;
+        case 0x6000:
+            emit8(emitter, 0xC6); // mov byte [rbx + VX], imm8
+            emit_state_operand(emitter, 0, register_offset(x));
+            emit8(emitter, nn);
+            return 1;
+        case 0x7000:
+            emit8(emitter, 0x80); // add byte [rbx + VX], imm8
+            emit_state_operand(emitter, 0, register_offset(x));
+            emit8(emitter, nn);
+            return 1;
+        case 0x8000:
+        {
+            const ui8 sub_opcode = opcode & 0x000F;
+            if(sub_opcode > 0x7 && sub_opcode != 0xE)
+                return 0;
+            if((quirks & C8_QUIRK_VF_RESET) && sub_opcode >= 0x1 && sub_opcode <= 0x3)
+                return 0;
+            if((quirks & C8_QUIRK_SHIFT_VY) && (sub_opcode == 0x6 || sub_opcode == 0xE))
+                return 0;
+
+            emit_load_byte(emitter, C8_X86_EAX, register_offset(x));
+            emit_load_byte(emitter, C8_X86_ECX, register_offset(y));
+            switch(sub_opcode)
+            {
+                case 0x0:
+                    emit_store_byte(emitter, C8_X86_ECX, register_offset(x));
+                    return 1;
+                case 0x1:
+                case 0x2:
+                case 0x3:
+                {
+                    // or/and/xor al, cl
+                    const ui8 operation[4] = { 0, 0x08, 0x20, 0x30 };
+                    emit8(emitter, operation[sub_opcode]);
+                    emit8(emitter, 0xC8);
+                    emit_store_byte(emitter, C8_X86_EAX, register_offset(x));
+                    return 1;
+                }
+                case 0x4:
+                    emit8(emitter, 0x01); emit8(emitter, 0xC8); // add eax, ecx
+                    emit8(emitter, 0x89); emit8(emitter, 0xC2); // mov edx, eax
+                    emit8(emitter, 0xC1); emit8(emitter, 0xEA); emit8(emitter, 8); // shr edx, 8
+                    emit_store_byte(emitter, C8_X86_EDX, register_offset(0xF));
+                    emit_store_byte(emitter, C8_X86_EAX, register_offset(x));
+                    return 1;
+                case 0x5:
+                    emit8(emitter, 0x38); emit8(emitter, 0xC8); // cmp al, cl
+                    emit8(emitter, 0x0F); emit8(emitter, 0x97); emit8(emitter, 0xC2); // seta dl
+                    emit8(emitter, 0x28); emit8(emitter, 0xC8); // sub al, cl
+                    emit_store_byte(emitter, C8_X86_EDX, register_offset(0xF));
+                    emit_store_byte(emitter, C8_X86_EAX, register_offset(x));
+                    return 1;
+                case 0x6:
+                    emit8(emitter, 0x89); emit8(emitter, 0xC2); // mov edx, eax
+                    emit8(emitter, 0x83); emit8(emitter, 0xE2); emit8(emitter, 1); // and edx, 1
+                    emit8(emitter, 0xD0); emit8(emitter, 0xE8); // shr al, 1
+                    emit_store_byte(emitter, C8_X86_EDX, register_offset(0xF));
+                    emit_store_byte(emitter, C8_X86_EAX, register_offset(x));
+                    return 1;
+                case 0x7:
+                    emit8(emitter, 0x38); emit8(emitter, 0xC1); // cmp cl, al
+                    emit8(emitter, 0x0F); emit8(emitter, 0x97); emit8(emitter, 0xC2); // seta dl
+                    emit8(emitter, 0x28); emit8(emitter, 0xC1); // sub cl, al
+                    emit_store_byte(emitter, C8_X86_EDX, register_offset(0xF));
+                    emit_store_byte(emitter, C8_X86_ECX, register_offset(x));
+                    return 1;
+                case 0xE:
+                    emit8(emitter, 0x89); emit8(emitter, 0xC2); // mov edx, eax
+                    emit8(emitter, 0xC1); emit8(emitter, 0xEA); emit8(emitter, 7); // shr edx, 7
+                    emit8(emitter, 0xD0); emit8(emitter, 0xE0); // shl al, 1
+                    emit_store_byte(emitter, C8_X86_EDX, register_offset(0xF));
+                    emit_store_byte(emitter, C8_X86_EAX, register_offset(x));
+                    return 1;
+            }
+            return 0;
+        }
+        case 0xA000:
+            emit_store_word_imm(emitter, (ui32)offsetof(Chip8, index_register), nnn);
+            return 1;
+        case 0xE000:
+            if(nn != 0x9E && nn != 0xA1)
+                return 0;
+            emit_countdown(emitter);
+            emit_load_byte(emitter, C8_X86_EAX, register_offset(x));
+            emit8(emitter, 0x80); // cmp byte [rbx + rax + keys], imm8
+            emit8(emitter, 0xBC);
+            emit8(emitter, 0x03);
+            emit32(emitter, (ui32)offsetof(Chip8, keys));
+            emit8(emitter, nn == 0x9E ? 1 : 0);
+            emit_skip_exit(emitter, program_counter, 1);
+            *ends_block = 1;
+            return 1;
+        case 0xF000:
+            switch(nn)
+            {
+                case 0x07:
+                    emit_load_byte(emitter, C8_X86_EAX, (ui32)offsetof(Chip8, delay_timer));
+                    emit_store_byte(emitter, C8_X86_EAX, register_offset(x));
+                    return 1;
+                case 0x15:
+                    emit_load_byte(emitter, C8_X86_EAX, register_offset(x));
+                    emit_store_byte(emitter, C8_X86_EAX, (ui32)offsetof(Chip8, delay_timer));
+                    return 1;
+                case 0x1E:
+                    emit_load_byte(emitter, C8_X86_EAX, register_offset(x));
+                    emit8(emitter, 0x66); // add word [rbx + I], ax
+                    emit8(emitter, 0x01);
+                    emit_state_operand(emitter, C8_X86_EAX, (ui32)offsetof(Chip8, index_register));
+                    emit8(emitter, 0x66); // and word [rbx + I], C8_MEMORY_SIZE - 1
+                    emit8(emitter, 0x81);
+                    emit_state_operand(emitter, 4, (ui32)offsetof(Chip8, index_register));
+                    emit16(emitter, C8_MEMORY_SIZE - 1);
+                    return 1;
+            }
+            return 0;
+    }
+
+    return 0;
+}
+
+// Changes the protection of the pages covering [offset, offset + size) of the arena
+static ui8 chip8_jit_protect(const Chip8Jit *jit, const ui32 offset, const ui32 size, const int protection)
+{
+    const ui32 page_mask = jit->page_size - 1;
+    const ui32 start = offset & ~page_mask;
+    const ui32 end = (offset + size + page_mask) & ~page_mask;
+    return mprotect(jit->arena + start, end - start, protection) == 0;
+}
+
+// Points the rel32 operand at arena offset `site` to `target`
+static void chip8_jit_patch(Chip8Jit *jit, const ui32 site, const ui8 *target)
+{
+    const ui32 displacement = (ui32)(target - (jit->arena + site + 4));
+    memcpy(jit->arena + site, &displacement, sizeof(displacement));
+}
+
+static void chip8_jit_flush(Chip8Jit *jit)
+{
+    memset(jit->blocks, 0, sizeof(jit->blocks));
+    memset(jit->link_targets, 0, sizeof(jit->link_targets));
+    memset(jit->pending_links, 0, sizeof(jit->pending_links));
+    jit->num_links = 0;
+    jit->arena_used = jit->stubs_size;
+    jit->code_generation = jit->chip8->code_generation;
+}
+
+static void chip8_jit_emit_stubs(Chip8Jit *jit)
+{
+    Chip8JitEmitter emitter = { jit, jit->arena, 0, 0, { { 0, 0 } } };
+
+    // Entry: saves the callee saved registers it uses, rsp stays 16 byte aligned for helper calls
+    jit->enter = (Chip8JitEntry)(void*)emitter.code;
+    emit8(&emitter, 0x53); // push rbx
+    emit8(&emitter, 0x41); emit8(&emitter, 0x54); // push r12
+    emit8(&emitter, 0x41); emit8(&emitter, 0x56); // push r14
+    emit8(&emitter, 0x48); emit8(&emitter, 0x89); emit8(&emitter, 0xFB); // mov rbx, rdi
+    emit8(&emitter, 0x41); emit8(&emitter, 0x89); emit8(&emitter, 0xF4); // mov r12d, esi
+    emit8(&emitter, 0x41); emit8(&emitter, 0x89); emit8(&emitter, 0xD6); // mov r14d, edx
+    emit8(&emitter, 0xFF); emit8(&emitter, 0xE1); // jmp rcx
+
+    // Bail: returns without events
+    jit->bail = emitter.code + emitter.size;
+    emit8(&emitter, 0x31); emit8(&emitter, 0xC0); // xor eax, eax
+
+    // Epilogue: events from eax in the high half, cycles left to the frame in the low half
+    jit->epilogue = emitter.code + emitter.size;
+    emit8(&emitter, 0x48); emit8(&emitter, 0xC1); emit8(&emitter, 0xE0); emit8(&emitter, 32); // shl rax, 32
+    emit8(&emitter, 0x4C); emit8(&emitter, 0x09); emit8(&emitter, 0xE0); // or rax, r12
+    emit8(&emitter, 0x41); emit8(&emitter, 0x5E); // pop r14
+    emit8(&emitter, 0x41); emit8(&emitter, 0x5C); // pop r12
+    emit8(&emitter, 0x5B); // pop rbx
+    emit8(&emitter, 0xC3); // ret
+
+    // Tick: advances the clock to the frame boundary and restarts the countdown, keeps eax
+    jit->tick = emitter.code + emitter.size;
+    emit8(&emitter, 0x50); // push rax
+    emit8(&emitter, 0x48); emit8(&emitter, 0x89); emit8(&emitter, 0xDF); // mov rdi, rbx
+    emit_call(&emitter, (const void*)chip8_jit_tick);
+    emit8(&emitter, 0x41); emit8(&emitter, 0x89); emit8(&emitter, 0xC4); // mov r12d, eax
+    emit8(&emitter, 0x58); // pop rax
+    emit8(&emitter, 0xC3); // ret
+
+    // Dispatch: jumps to the linkable block at `program_counter` or bails
+    jit->dispatch = emitter.code + emitter.size;
+    emit8(&emitter, 0x0F); emit8(&emitter, 0xB7); // movzx eax, word [rbx + PC]
+    emit_state_operand(&emitter, C8_X86_EAX, (ui32)offsetof(Chip8, program_counter));
+    emit8(&emitter, 0xA9); // test eax, imm32
+    emit32(&emitter, (ui32)(0x10000 - C8_MEMORY_SIZE));
+    emit8(&emitter, 0x0F); emit8(&emitter, 0x85); // jnz bail
+    emit_rel32(&emitter, jit->bail);
+    emit8(&emitter, 0x48); emit8(&emitter, 0xB9); // mov rcx, imm64
+    emit64(&emitter, (ui64)(size_t)jit->link_targets);
+    emit8(&emitter, 0x48); emit8(&emitter, 0x8B); emit8(&emitter, 0x0C); emit8(&emitter, 0xC1); // mov rcx, [rcx + rax * 8]
+    emit8(&emitter, 0x48); emit8(&emitter, 0x85); emit8(&emitter, 0xC9); // test rcx, rcx
+    emit8(&emitter, 0x0F); emit8(&emitter, 0x84); // jz bail
+    emit_rel32(&emitter, jit->bail);
+    emit8(&emitter, 0xFF); emit8(&emitter, 0xE1); // jmp rcx
+
+    jit->stubs_size = (emitter.size + 15) & ~15u;
+}
+
+// FX07 and FX0A can start idle loops, `chip8_skip_idle` has to see them before they run
+static ui8 chip8_jit_idle_entry(const Chip8 *chip8, const ui16 address)
+{
+    if(address + 1 >= C8_MEMORY_SIZE || (chip8->memory[address] & 0xF0) != 0xF0)
+        return 0;
+    return chip8->memory[address + 1] == 0x07 || chip8->memory[address + 1] == 0x0A;
+}
+
+// Decodes the cache entry holding the byte at `address` so stores to it bump `code_generation`
+static void chip8_jit_watch(Chip8 *chip8, const ui16 address)
+{
+    const ui16 even_address = address & ~1;
+    if(even_address >= C8_MEMORY_SIZE)
+        return;
+
+    Chip8Instruction *decoded = &chip8->decoded_instructions[even_address >> 1];
+    if(decoded->handler == NULL)
+        chip8_decode_instruction(chip8, even_address, decoded);
+}
+
+static void chip8_jit_compile(Chip8Jit *jit, const ui16 start_address)
+{
+    Chip8 *chip8 = jit->chip8;
+    Chip8JitBlock *block = &jit->blocks[start_address];
+
+    if(jit->arena_used + C8_JIT_MAX_BLOCK_SIZE > C8_JIT_ARENA_SIZE)
+        chip8_jit_flush(jit);
+
+    // Blocks at timer reads and key waits are only entered from the host, which skips idle loops there
+    const ui8 linkable = !chip8_jit_idle_entry(chip8, start_address);
+
+    // One write window covers the new block and the exits of older blocks waiting on it
+    const ui32 block_offset = jit->arena_used;
+    ui32 writable_offset = block_offset;
+    if(linkable)
+    {
+        for(ui32 link_index = jit->pending_links[start_address]; link_index != 0; link_index = jit->links[link_index - 1].next)
+        {
+            if(jit->links[link_index - 1].site < writable_offset)
+                writable_offset = jit->links[link_index - 1].site;
+        }
+    }
+    const ui32 writable_size = block_offset + C8_JIT_MAX_BLOCK_SIZE - writable_offset;
+    if(!chip8_jit_protect(jit, writable_offset, writable_size, PROT_READ | PROT_WRITE))
+    {
+        block->hits = C8_JIT_NOT_COMPILABLE;
+        return;
+    }
+
+    Chip8JitEmitter emitter = { jit, jit->arena + block_offset, 0, 0, { { 0, 0 } } };
+
+    // Prologue: bails unless the whole block fits the budget, the count is patched in once known
+    emit8(&emitter, 0x41); emit8(&emitter, 0x81); emit8(&emitter, 0xFE); // cmp r14d, imm32
+    const ui32 compare_offset = emitter.size;
+    emit32(&emitter, 0);
+    emit8(&emitter, 0x0F); emit8(&emitter, 0x82); // jb bail
+    emit_rel32(&emitter, jit->bail);
+    emit8(&emitter, 0x41); emit8(&emitter, 0x81); emit8(&emitter, 0xEE); // sub r14d, imm32
+    const ui32 subtract_offset = emitter.size;
+    emit32(&emitter, 0);
+
+    ui32 num_instructions = 0;
+    ui16 address = start_address;
+    ui8 ends_block = 0;
+    const ui32 quirks = chip8_quirks_flags(chip8->quirks);
+    while(num_instructions < C8_JIT_MAX_BLOCK_INSTRUCTIONS && address + 1 < C8_MEMORY_SIZE)
+    {
+        // Idle loops start a block of their own so the host sees them
+        if(num_instructions != 0 && chip8_jit_idle_entry(chip8, address))
+            break;
+
+        const ui16 opcode = chip8->memory[address] << 8 | chip8->memory[address + 1];
+        if(!emit_instruction(&emitter, opcode, address, quirks, &ends_block))
+        {
+            // Draws, stores, key waits, sound and the rest go through the interpreter so they raise their events
+            emit_interpret_exit(&emitter, address);
+            ends_block = 1;
+        }
+        else if(!ends_block)
+            emit_countdown(&emitter);
+
+        // Overwriting compiled code must invalidate it, which requires decoded entries over both bytes
+        chip8_jit_watch(chip8, address);
+        chip8_jit_watch(chip8, address + 1);
+
+        ++num_instructions;
+        address += 2;
+        if(ends_block)
+            break;
+    }
+
+    if(!ends_block)
+        emit_exit(&emitter, address);
+
+    memcpy(emitter.code + compare_offset, &num_instructions, sizeof(num_instructions));
+    memcpy(emitter.code + subtract_offset, &num_instructions, sizeof(num_instructions));
+
+    block->code = emitter.code;
+    block->num_instructions = (ui8)num_instructions;
+
+    if(linkable)
+        jit->link_targets[start_address] = emitter.code;
+
+    for(ui32 i = 0; i < emitter.num_exits; ++i)
+    {
+        const Chip8JitExit *exit = &emitter.exits[i];
+        if(exit->target >= C8_MEMORY_SIZE)
+            continue;
+
+        const ui8 *target = jit->link_targets[exit->target];
+        if(target != NULL)
+            chip8_jit_patch(jit, exit->site, target);
+        else if(jit->num_links < C8_JIT_MAX_LINKS)
+        {
+            // Past the capacity exits keep going through the dispatcher
+            Chip8JitLink *link = &jit->links[jit->num_links++];
+            link->site = exit->site;
+            link->next = jit->pending_links[exit->target];
+            jit->pending_links[exit->target] = jit->num_links;
+        }
+    }
+
+    // Exits already waiting on this block now jump straight into it
+    if(linkable)
+    {
+        for(ui32 link_index = jit->pending_links[start_address]; link_index != 0; link_index = jit->links[link_index - 1].next)
+            chip8_jit_patch(jit, jit->links[link_index - 1].site, emitter.code);
+        jit->pending_links[start_address] = 0;
+    }
+
+    // Keep blocks 16 byte aligned
+    jit->arena_used += (emitter.size + 15) & ~15u;
+    chip8_jit_protect(jit, writable_offset, writable_size, PROT_READ | PROT_EXEC);
+}
+
+Chip8Jit *chip8_jit_create(Chip8 *chip8)
+{
+    Chip8Jit *jit = calloc(1, sizeof(Chip8Jit));
+    if(jit == NULL)
+        return NULL;
+
+    const long page_size = sysconf(_SC_PAGESIZE);
+    void *arena = page_size > 0 ? mmap(NULL, C8_JIT_ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) : MAP_FAILED;
+    if(arena == MAP_FAILED)
+    {
+        free(jit);
+        return NULL;
+    }
+
+    jit->chip8 = chip8;
+    jit->arena = arena;
+    jit->page_size = (ui32)page_size;
+    chip8_jit_emit_stubs(jit);
+    if(mprotect(arena, C8_JIT_ARENA_SIZE, PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(arena, C8_JIT_ARENA_SIZE);
+        free(jit);
+        return NULL;
+    }
+
+    chip8_jit_flush(jit);
+    return jit;
+}
+
+void chip8_jit_destroy(Chip8Jit *jit)
+{
+    if(jit == NULL)
+        return;
+
+    munmap(jit->arena, C8_JIT_ARENA_SIZE);
+    free(jit);
+}
+
+void chip8_jit_reset(Chip8Jit *jit)
+{
+    if(jit != NULL)
+        chip8_jit_flush(jit);
+}
+
+ui32 chip8_jit_run_cycles(Chip8Jit *jit, Chip8 *chip8, const ui32 max_cycles, ui32 *events_out)
+{
+    if(jit == NULL || jit->chip8 != chip8)
+        return chip8_run_cycles(chip8, max_cycles, events_out);
+
+    if(jit->code_generation != chip8->code_generation)
+        chip8_jit_flush(jit);
+
+    ui32 num_cycles = 0;
+    ui32 events = 0;
+    while(num_cycles < max_cycles)
+    {
+        const ui16 program_counter = chip8->program_counter;
+        const ui32 budget = max_cycles - num_cycles;
+
+        // Idle loops are cheaper to skip than to run, even compiled, and key waits sit at odd addresses too
+        if(chip8_jit_idle_entry(chip8, program_counter))
+        {
+            const ui32 idle_cycles = chip8_skip_idle(chip8, budget, &events);
+            num_cycles += idle_cycles;
+            if(events != 0)
+                break;
+            if(idle_cycles != 0)
+                continue;
+        }
+
+        if(program_counter < C8_MEMORY_SIZE)
+        {
+            Chip8JitBlock *block = &jit->blocks[program_counter];
+            if(block->code == NULL && block->hits != C8_JIT_NOT_COMPILABLE && ++block->hits == C8_JIT_HOT_THRESHOLD)
+                chip8_jit_compile(jit, program_counter);
+
+            if(block->code != NULL && block->num_instructions <= budget)
+            {
+                const ui64 start_cycle = chip8->cycle_count;
+                const ui64 result = jit->enter(chip8, chip8->cycles_per_frame - chip8->frame_cycles, budget, block->code);
+                // Native code ticks the timers on frame boundaries, the instructions since the last tick never reach one
+                const ui32 num_behind = chip8->cycles_per_frame - chip8->frame_cycles - (ui32)result;
+                chip8->cycle_count += num_behind;
+                chip8->frame_cycles += num_behind;
+                num_cycles += (ui32)(chip8->cycle_count - start_cycle);
+                events = (ui32)(result >> 32);
+                if(chip8->code_generation != jit->code_generation)
+                    chip8_jit_flush(jit);
+                if(events != 0)
+                    break;
+                continue;
+            }
+        }
+
+        // Code that is not compiled runs on the interpreter a block at a time, it stops early on events
+        num_cycles += chip8_run_cycles(chip8, budget < C8_JIT_MAX_BLOCK_INSTRUCTIONS ? budget : C8_JIT_MAX_BLOCK_INSTRUCTIONS, &events);
+
+        if(chip8->code_generation != jit->code_generation)
+            chip8_jit_flush(jit);
+
+        if(events != 0)
+            break;
+    }
+
+    if(events_out)
+        *events_out = events;
+
+    return num_cycles;
+}
+
+#else
+
+Chip8Jit *chip8_jit_create(Chip8 *chip8)
+{
+    (void)chip8;
+    return NULL;
+}
+
+void chip8_jit_destroy(Chip8Jit *jit)
+{
+    (void)jit;
+}
+
+void chip8_jit_reset(Chip8Jit *jit)
+{
+    (void)jit;
+}
+
+ui32 chip8_jit_run_cycles(Chip8Jit *jit, Chip8 *chip8, const ui32 max_cycles, ui32 *events_out)
+{
+    (void)jit;
+    return chip8_run_cycles(chip8, max_cycles, events_out);
+}
+
+#endif
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "chip8.h"
+
+/*
+    Optional x86-64 JIT tier:
+    Straight-line runs of register, timer, key and branch instructions that the
+    interpreter executes often are compiled to native code. Draws, key waits,
+    memory stores and everything else end a block with a call back into the
+    interpreter, and compiled code is dropped whenever the instance
+    overwrites decoded code. Blocks jump straight into each other and tick
+    the timers themselves, they only return to the host on events, idle
+    loops, the end of the budget or code that is not compiled yet.
+
+    A jit is bound to one `Chip8` instance. Call `chip8_jit_reset` after
+    re-initializing it or loading another rom.
+*/
+
+typedef struct Chip8Jit Chip8Jit;
+
+// Returns NULL when the platform is not supported, callers can still pass NULL to `chip8_jit_run_cycles`
+Chip8Jit *chip8_jit_create(Chip8 *chip8);
+void chip8_jit_destroy(Chip8Jit *jit);
+void chip8_jit_reset(Chip8Jit *jit);
+
+// Same contract as `chip8_run_cycles`, `chip8` must be the instance the jit was created for
+ui32 chip8_jit_run_cycles(Chip8Jit *jit, Chip8 *chip8, const ui32 max_cycles, ui32 *events_out);
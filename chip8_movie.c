@@ -0,0 +1,283 @@
+#include "chip8_movie.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum
+{
+    C8_MOVIE_VERSION = 1,
+    C8_MOVIE_HEADER_SIZE = 32,
+    C8_MOVIE_END = 0xFF,
+    C8_MOVIE_KEY_STATE_BIT = 0x10,
+    C8_MOVIE_READ_BUFFER_SIZE = 4096,
+};
+
+static const ui8 chip8_movie_magic[4] = { 'C', '8', 'M', 'V' };
+
+struct Chip8MovieRecorder
+{
+    FILE *file;
+    ui64 start_cycle;
+    // Relative instruction count of the last record
+    ui64 last_cycle;
+    ui8 failed;
+};
+
+struct Chip8MoviePlayer
+{
+    FILE *file;
+    Chip8MovieHeader header;
+
+    ui8 buffer[C8_MOVIE_READ_BUFFER_SIZE];
+    ui32 buffer_size;
+    ui32 buffer_position;
+
+    // Instructions since the start of the movie
+    ui64 cycle;
+
+    // Next record not applied yet
+    ui64 record_cycle;
+    ui8 record_code;
+    ui8 has_record;
+    ui8 finished;
+};
+
+static void chip8_movie_store(ui8 *bytes, ui64 value, const ui8 size)
+{
+    for(ui8 i = 0; i < size; ++i, value >>= 8)
+        bytes[i] = (ui8)value;
+}
+
+static ui64 chip8_movie_load(const ui8 *bytes, const ui8 size)
+{
+    ui64 value = 0;
+    for(ui8 i = size; i > 0; --i)
+        value = value << 8 | bytes[i - 1];
+    return value;
+}
+
+static void chip8_movie_write_record(Chip8MovieRecorder *recorder, const ui64 cycle, const ui8 code)
+{
+    ui8 record[11];
+    ui8 size = 0;
+
+    // LEB128
+    ui64 cycle_delta = cycle - recorder->last_cycle;
+    do
+    {
+        record[size] = cycle_delta & 0x7F;
+        cycle_delta >>= 7;
+        record[size++] |= cycle_delta != 0 ? 0x80 : 0;
+    }
+    while(cycle_delta != 0);
+    record[size++] = code;
+
+    recorder->last_cycle = cycle;
+    if(fwrite(record, 1, size, recorder->file) != size)
+        recorder->failed = 1;
+}
+
+i32 chip8_movie_record(const char *movie_file_path, const Chip8 *chip8, Chip8MovieRecorder **recorder)
+{
+    Chip8MovieRecorder *new_recorder = calloc(1, sizeof(Chip8MovieRecorder));
+    if(new_recorder == NULL)
+        return C8_MOVIE_OUT_OF_MEMORY;
+
+    new_recorder->file = fopen(movie_file_path, "wb");
+    if(new_recorder->file == NULL)
+    {
+        free(new_recorder);
+        return C8_MOVIE_OPEN_FAILED;
+    }
+
+    ui8 header[C8_MOVIE_HEADER_SIZE] = {0};
+    memcpy(header, chip8_movie_magic, sizeof(chip8_movie_magic));
+    chip8_movie_store(&header[4], C8_MOVIE_VERSION, 2);
+    chip8_movie_store(&header[6], chip8->quirks, 2);
+    chip8_movie_store(&header[8], chip8->cycles_per_frame, 4);
+    chip8_movie_store(&header[12], chip8->frame_cycles, 4);
+    chip8_movie_store(&header[16], chip8->rom_hash, 8);
+    chip8_movie_store(&header[24], chip8->random_state, 8);
+    if(fwrite(header, 1, sizeof(header), new_recorder->file) != sizeof(header))
+    {
+        fclose(new_recorder->file);
+        free(new_recorder);
+        return C8_MOVIE_WRITE_FAILED;
+    }
+
+    new_recorder->start_cycle = chip8->cycle_count;
+    *recorder = new_recorder;
+    return C8_MOVIE_OK;
+}
+
+void chip8_movie_record_input(Chip8MovieRecorder *recorder, Chip8 *chip8, const Chip8InputKey *keys, const ui8 num_keys)
+{
+    if(keys == NULL)
+        return;
+
+    const ui64 cycle = chip8->cycle_count - recorder->start_cycle;
+    for(ui8 i = 0; i < num_keys && i < C8_NUM_KEYS; ++i)
+    {
+        if(keys[i].key_index >= C8_NUM_KEYS)
+            continue;
+
+        const Chip8InputKey key = { keys[i].key_index, keys[i].key_state != 0 };
+        if(chip8->keys[key.key_index] == key.key_state)
+            continue;
+
+        chip8_movie_write_record(recorder, cycle, key.key_index | (key.key_state ? C8_MOVIE_KEY_STATE_BIT : 0));
+        chip8_feed_input(chip8, &key, 1);
+    }
+}
+
+i32 chip8_movie_record_finish(Chip8MovieRecorder *recorder, const Chip8 *chip8)
+{
+    chip8_movie_write_record(recorder, chip8->cycle_count - recorder->start_cycle, C8_MOVIE_END);
+    const ui8 failed = fclose(recorder->file) != 0 || recorder->failed;
+    free(recorder);
+    return failed ? C8_MOVIE_WRITE_FAILED : C8_MOVIE_OK;
+}
+
+static ui8 chip8_movie_read_byte(Chip8MoviePlayer *player, ui8 *byte)
+{
+    if(player->buffer_position == player->buffer_size)
+    {
+        player->buffer_size = (ui32)fread(player->buffer, 1, sizeof(player->buffer), player->file);
+        player->buffer_position = 0;
+        if(player->buffer_size == 0)
+            return 0;
+    }
+
+    *byte = player->buffer[player->buffer_position++];
+    return 1;
+}
+
+// Reads the next record, a truncated movie simply ends at its last complete record
+static void chip8_movie_read_record(Chip8MoviePlayer *player)
+{
+    player->has_record = 0;
+
+    ui64 cycle_delta = 0;
+    ui8 byte = 0;
+    for(ui8 shift = 0; ; shift += 7)
+    {
+        if(shift > 63 || !chip8_movie_read_byte(player, &byte))
+            return;
+        cycle_delta |= (ui64)(byte & 0x7F) << shift;
+        if((byte & 0x80) == 0)
+            break;
+    }
+
+    if(!chip8_movie_read_byte(player, &player->record_code))
+        return;
+
+    player->record_cycle += cycle_delta;
+    player->has_record = 1;
+}
+
+i32 chip8_movie_play(const char *movie_file_path, Chip8MoviePlayer **player)
+{
+    Chip8MoviePlayer *new_player = calloc(1, sizeof(Chip8MoviePlayer));
+    if(new_player == NULL)
+        return C8_MOVIE_OUT_OF_MEMORY;
+
+    new_player->file = fopen(movie_file_path, "rb");
+    if(new_player->file == NULL)
+    {
+        free(new_player);
+        return C8_MOVIE_OPEN_FAILED;
+    }
+
+    ui8 header[C8_MOVIE_HEADER_SIZE];
+    const ui8 valid = fread(header, 1, sizeof(header), new_player->file) == sizeof(header)
+        && memcmp(header, chip8_movie_magic, sizeof(chip8_movie_magic)) == 0
+        && chip8_movie_load(&header[4], 2) == C8_MOVIE_VERSION
+        && chip8_movie_load(&header[6], 2) < C8_NUM_QUIRKS
+        && chip8_movie_load(&header[8], 4) != 0
+        && chip8_movie_load(&header[12], 4) < chip8_movie_load(&header[8], 4);
+    if(!valid)
+    {
+        chip8_movie_play_close(new_player);
+        return C8_MOVIE_BAD_HEADER;
+    }
+
+    new_player->header.cycles_per_frame = (ui32)chip8_movie_load(&header[8], 4);
+    new_player->header.frame_cycles = (ui32)chip8_movie_load(&header[12], 4);
+    new_player->header.rom_hash = chip8_movie_load(&header[16], 8);
+    new_player->header.random_state = chip8_movie_load(&header[24], 8);
+    new_player->header.quirks = (ui8)chip8_movie_load(&header[6], 2);
+    chip8_movie_read_record(new_player);
+
+    *player = new_player;
+    return C8_MOVIE_OK;
+}
+
+const Chip8MovieHeader *chip8_movie_header(const Chip8MoviePlayer *player)
+{
+    return &player->header;
+}
+
+i32 chip8_movie_play_start(Chip8MoviePlayer *player, Chip8 *chip8)
+{
+    if(chip8->rom_hash != player->header.rom_hash)
+        return C8_MOVIE_ROM_MISMATCH;
+
+    chip8->random_state = player->header.random_state;
+    chip8->cycles_per_frame = player->header.cycles_per_frame;
+    chip8->frame_cycles = player->header.frame_cycles;
+    chip8_set_quirks(chip8, player->header.quirks);
+    return C8_MOVIE_OK;
+}
+
+ui64 chip8_movie_play_cycles(Chip8MoviePlayer *player, Chip8 *chip8, const ui64 max_cycles, ui32 *events_out)
+{
+    ui64 num_played = 0;
+    ui32 events = 0;
+    while(num_played < max_cycles && !player->finished && events == 0)
+    {
+        // Input lands before the instruction it was recorded at
+        while(player->has_record && player->record_cycle == player->cycle && player->record_code != C8_MOVIE_END)
+        {
+            const Chip8InputKey key = { player->record_code & 0x0F, (player->record_code & C8_MOVIE_KEY_STATE_BIT) != 0 };
+            chip8_feed_input(chip8, &key, 1);
+            chip8_movie_read_record(player);
+        }
+
+        if(!player->has_record || (player->record_cycle == player->cycle && player->record_code == C8_MOVIE_END))
+        {
+            player->finished = 1;
+            break;
+        }
+
+        // Stop at the next record and the end of the budget
+        ui64 budget = player->record_cycle - player->cycle;
+        if(budget > max_cycles - num_played)
+            budget = max_cycles - num_played;
+        if(budget > 0xFFFFFFFF)
+            budget = 0xFFFFFFFF;
+
+        const ui32 num_cycles = chip8_run_cycles(chip8, (ui32)budget, &events);
+        num_played += num_cycles;
+        player->cycle += num_cycles;
+    }
+
+    if(events_out)
+        *events_out = events;
+
+    return num_played;
+}
+
+ui8 chip8_movie_play_finished(const Chip8MoviePlayer *player)
+{
+    return player->finished;
+}
+
+void chip8_movie_play_close(Chip8MoviePlayer *player)
+{
+    if(player == NULL)
+        return;
+
+    fclose(player->file);
+    free(player);
+}
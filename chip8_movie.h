@@ -0,0 +1,61 @@
+#pragma once
+
+#include "chip8.h"
+
+/*
+    Input movies:
+    A movie stores the rom hash, the generator state and the virtual clock
+    of a session followed by every key edge tagged with the instruction
+    count it happened at, so playing it back reproduces the session exactly.
+
+    Recording starts right after the rom is loaded and seeded. Playback
+    drives the instance itself without any wall-clock pacing and reads the
+    file as it goes, so movies of any length play in constant memory.
+
+    File layout, all fields little-endian:
+    "C8MV", ui16 version, ui16 quirks profile, ui32 cycles_per_frame,
+    ui32 frame_cycles, ui64 rom hash, ui64 generator state, then records of a
+    LEB128 instruction count since the previous record followed by one
+    byte, the key index in the low nibble and its state in bit 4, or 0xFF
+    for the end of the movie.
+*/
+
+enum
+{
+    C8_MOVIE_OK = 0,
+    C8_MOVIE_OPEN_FAILED,
+    C8_MOVIE_WRITE_FAILED,
+    C8_MOVIE_BAD_HEADER,
+    C8_MOVIE_ROM_MISMATCH,
+    C8_MOVIE_OUT_OF_MEMORY,
+};
+
+typedef struct Chip8MovieHeader
+{
+    ui32 cycles_per_frame;
+    ui32 frame_cycles;
+    ui64 rom_hash;
+    ui64 random_state;
+    // Movies from before quirks profiles have 0 here, the default profile
+    ui8 quirks;
+} Chip8MovieHeader;
+
+typedef struct Chip8MovieRecorder Chip8MovieRecorder;
+typedef struct Chip8MoviePlayer Chip8MoviePlayer;
+
+// Returns a `C8_MOVIE_*` status, `*recorder` is only set on `C8_MOVIE_OK`
+i32 chip8_movie_record(const char *movie_file_path, const Chip8 *chip8, Chip8MovieRecorder **recorder);
+// Feeds the keys to the instance and records the ones whose state changed
+void chip8_movie_record_input(Chip8MovieRecorder *recorder, Chip8 *chip8, const Chip8InputKey *keys, const ui8 num_keys);
+// Writes the end of the movie at the current instruction count and closes the file
+i32 chip8_movie_record_finish(Chip8MovieRecorder *recorder, const Chip8 *chip8);
+
+// Returns a `C8_MOVIE_*` status, `*player` is only set on `C8_MOVIE_OK`
+i32 chip8_movie_play(const char *movie_file_path, Chip8MoviePlayer **player);
+const Chip8MovieHeader *chip8_movie_header(const Chip8MoviePlayer *player);
+// Checks the rom and restores the recorded generator state and clock, call once after loading the rom
+i32 chip8_movie_play_start(Chip8MoviePlayer *player, Chip8 *chip8);
+// Runs up to `max_cycles` instructions with the recorded input, returns the number run, 0 once the movie ended. Stops early on events like `chip8_run_cycles` and stores them in `events_out` when given
+ui64 chip8_movie_play_cycles(Chip8MoviePlayer *player, Chip8 *chip8, const ui64 max_cycles, ui32 *events_out);
+ui8 chip8_movie_play_finished(const Chip8MoviePlayer *player);
+void chip8_movie_play_close(Chip8MoviePlayer *player);
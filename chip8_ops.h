@@ -0,0 +1,108 @@
+#pragma once
+
+#include "chip8.h"
+
+/*
+    Instruction semantics:
+    The parts of the instructions that compute something, shared by the
+    core handlers and the batched engine so both run the same CHIP-8. They
+    work on values and register pointers rather than on a `Chip8`, the
+    callers own fetching, memory, the screen and `program_counter`.
+    `quirk_flags` is a constant in the specialized interpreters, which
+    keeps only the code of their own variants.
+*/
+
+// 8XYN: ALU ops, VF is written before VX for the ops that set a flag and after it for the VF reset quirk
+static inline void chip8_alu(const ui8 n, ui8 *vx, const ui8 value_y, ui8 *vf, const ui32 quirk_flags)
+{
+    const ui8 value_x = *vx;
+    const ui8 value_shifted = quirk_flags & C8_QUIRK_SHIFT_VY ? value_y : value_x;
+    switch(n)
+    {
+        case 0x0:
+            *vx = value_y;
+            break;
+        case 0x1:
+            *vx = value_x | value_y;
+            break;
+        case 0x2:
+            *vx = value_x & value_y;
+            break;
+        case 0x3:
+            *vx = value_x ^ value_y;
+            break;
+        case 0x4:
+            *vf = value_x + value_y > 0xFF ? 1 : 0;
+            *vx = (ui8)(value_x + value_y);
+            break;
+        case 0x5:
+            *vf = value_x > value_y ? 1 : 0;
+            *vx = value_x - value_y;
+            break;
+        case 0x6:
+            *vf = value_shifted & 0x1;
+            *vx = value_shifted >> 1;
+            break;
+        case 0x7:
+            *vf = value_y > value_x ? 1 : 0;
+            *vx = value_y - value_x;
+            break;
+        case 0xE:
+            *vf = value_shifted >> 7;
+            *vx = (ui8)(value_shifted << 1);
+            break;
+    }
+
+    if((quirk_flags & C8_QUIRK_VF_RESET) && n >= 0x1 && n <= 0x3)
+        *vf = 0;
+}
+
+// BNNN: Jump target, NNN + V0 or XNN + VX
+static inline ui16 chip8_jump_offset_target(const ui16 nnn, const ui8 value_0, const ui8 value_x, const ui32 quirk_flags)
+{
+    return nnn + (quirk_flags & C8_QUIRK_JUMP_VX ? value_x : value_0);
+}
+
+// DXYN: Pixels of one lo-res sprite row at column `x`, wrapped around the side edges or clipped at them
+static inline ui64 chip8_sprite_row(const ui8 sprite_byte, const ui8 x, const ui32 quirk_flags)
+{
+    const ui64 sprite_row = (ui64)sprite_byte << (C8_SCREEN_WIDTH - 8);
+    ui64 sprite_pixels = sprite_row >> x;
+    if(!(quirk_flags & C8_QUIRK_CLIP))
+        sprite_pixels |= sprite_row << ((C8_SCREEN_WIDTH - x) % C8_SCREEN_WIDTH);
+    return sprite_pixels;
+}
+
+// DXYN: Rows of an `n` row lo-res sprite drawn at row `y`, clipped ones lose the rows below the screen
+static inline ui8 chip8_sprite_height(const ui8 n, const ui8 y, const ui32 quirk_flags)
+{
+    return (quirk_flags & C8_QUIRK_CLIP) && n > C8_SCREEN_HEIGHT - y ? C8_SCREEN_HEIGHT - y : n;
+}
+
+// FX29: Address of the font sprite of VX, within the first 256 bytes like the original
+static inline ui16 chip8_font_address(const ui8 value_x)
+{
+    return (ui8)(value_x * C8_FONT_SIZE);
+}
+
+// FX33: Hundreds, tens and ones of VX
+static inline void chip8_bcd(const ui8 value_x, ui8 digits[3])
+{
+    digits[0] = (value_x / 100) % 10;
+    digits[1] = (value_x / 10) % 10;
+    digits[2] = value_x % 10;
+}
+
+// FX55/FX65: How far I moves past the registers stored or loaded
+static inline ui16 chip8_load_store_increment(const ui8 x, const ui32 quirk_flags)
+{
+    return quirk_flags & C8_QUIRK_LOAD_STORE_INCREMENT ? x + 1 : 0;
+}
+
+// Timer tick, returns 1 when the sound timer reached 0
+static inline ui8 chip8_tick_timers(ui8 *delay_timer, ui8 *sound_timer)
+{
+    if(*delay_timer > 0)
+        --*delay_timer;
+    return *sound_timer > 0 && --*sound_timer == 0;
+}
@@ -0,0 +1,468 @@
+#include "chip8_pool.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum
+{
+    C8_POOL_CACHE_LINE = 64,
+};
+
+typedef struct Chip8PoolTask
+{
+    Chip8 *chip8;
+    ui64 cycles_left;
+} Chip8PoolTask;
+
+/*
+    Chase-Lev deque of task indices:
+    The owning worker pushes and pops at the bottom, thieves take from the
+    top. Capacity always covers every task of a run so it never grows.
+*/
+typedef struct Chip8PoolDeque
+{
+    _Alignas(C8_POOL_CACHE_LINE) atomic_llong top;
+    _Alignas(C8_POOL_CACHE_LINE) atomic_llong bottom;
+    _Alignas(C8_POOL_CACHE_LINE) atomic_uint *tasks;
+    ui64 mask;
+} Chip8PoolDeque;
+
+// Bounded MPMC queue cell, see Vyukov's bounded queue
+typedef struct Chip8PoolCompletion
+{
+    atomic_ullong sequence;
+    ui32 instance_index;
+} Chip8PoolCompletion;
+
+typedef struct Chip8PoolWorker
+{
+    Chip8Pool *pool;
+    ui32 index;
+    ui32 random_state;
+    pthread_t thread;
+} Chip8PoolWorker;
+
+struct Chip8Pool
+{
+    Chip8PoolDesc desc;
+    Chip8PoolWorker *workers;
+    Chip8PoolDeque *deques;
+
+    Chip8PoolTask *tasks;
+    ui32 task_capacity;
+
+    Chip8PoolCompletion *completions;
+    ui64 completion_mask;
+    _Alignas(C8_POOL_CACHE_LINE) atomic_ullong completion_enqueue;
+    _Alignas(C8_POOL_CACHE_LINE) atomic_ullong completion_dequeue;
+
+    _Alignas(C8_POOL_CACHE_LINE) atomic_uint remaining;
+
+    // Bumped whenever work shows up or the run ends, parked workers sleep until it changes
+    _Alignas(C8_POOL_CACHE_LINE) atomic_ullong work_epoch;
+    atomic_uint num_parked;
+    pthread_cond_t work_condition;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t start_condition;
+    pthread_cond_t done_condition;
+    ui64 generation;
+    ui32 active_workers;
+    ui8 shutdown;
+};
+
+// Returns the number of tasks in the deque after the push
+static long long chip8_pool_deque_push(Chip8PoolDeque *deque, const ui32 task)
+{
+    const long long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    atomic_store_explicit(&deque->tasks[bottom & deque->mask], task, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+    return bottom + 1 - atomic_load_explicit(&deque->top, memory_order_relaxed);
+}
+
+static ui8 chip8_pool_deque_pop(Chip8PoolDeque *deque, ui32 *task)
+{
+    const long long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if(top > bottom)
+    {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return 0;
+    }
+
+    *task = atomic_load_explicit(&deque->tasks[bottom & deque->mask], memory_order_relaxed);
+    if(top != bottom)
+        return 1;
+
+    // Last task, race thieves for it
+    const ui8 won = atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    return won;
+}
+
+static ui8 chip8_pool_deque_steal(Chip8PoolDeque *deque, ui32 *task)
+{
+    long long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    const long long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if(top >= bottom)
+        return 0;
+
+    *task = atomic_load_explicit(&deque->tasks[top & deque->mask], memory_order_relaxed);
+    return atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1, memory_order_seq_cst, memory_order_relaxed);
+}
+
+static void chip8_pool_complete(Chip8Pool *pool, const ui32 instance_index)
+{
+    unsigned long long position = atomic_load_explicit(&pool->completion_enqueue, memory_order_relaxed);
+    Chip8PoolCompletion *completion = NULL;
+    for(;;)
+    {
+        completion = &pool->completions[position & pool->completion_mask];
+        const unsigned long long sequence = atomic_load_explicit(&completion->sequence, memory_order_acquire);
+        if(sequence == position)
+        {
+            if(atomic_compare_exchange_weak_explicit(&pool->completion_enqueue, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else
+        {
+            // The queue holds every instance of a run, so it is never full
+            position = atomic_load_explicit(&pool->completion_enqueue, memory_order_relaxed);
+        }
+    }
+
+    completion->instance_index = instance_index;
+    atomic_store_explicit(&completion->sequence, position + 1, memory_order_release);
+}
+
+// Runs one slice of a task, returns 1 while the task has cycles left
+static ui8 chip8_pool_run_slice(Chip8Pool *pool, Chip8PoolTask *task)
+{
+    ui32 slice_cycles = pool->desc.slice_cycles < task->cycles_left ? pool->desc.slice_cycles : (ui32)task->cycles_left;
+    while(slice_cycles > 0)
+    {
+        const ui32 num_cycles = chip8_run_cycles(task->chip8, slice_cycles, NULL);
+        slice_cycles -= num_cycles;
+        task->cycles_left -= num_cycles;
+    }
+
+    return task->cycles_left != 0;
+}
+
+static ui8 chip8_pool_steal(Chip8Pool *pool, Chip8PoolWorker *worker, ui32 *task)
+{
+    const ui32 num_threads = pool->desc.num_threads;
+
+    // xorshift32, only used to spread victims
+    worker->random_state ^= worker->random_state << 13;
+    worker->random_state ^= worker->random_state >> 17;
+    worker->random_state ^= worker->random_state << 5;
+
+    const ui32 first_victim = worker->random_state % num_threads;
+    for(ui32 i = 0; i < num_threads; ++i)
+    {
+        const ui32 victim = (first_victim + i) % num_threads;
+        if(victim != worker->index && chip8_pool_deque_steal(&pool->deques[victim], task))
+            return 1;
+    }
+    return 0;
+}
+
+/*
+    Parking:
+    Workers without anything to pop or steal sleep on `work_condition`.
+    They read `work_epoch` before their last look at the deques and only
+    wait while it is unchanged, so work published in between is never
+    missed. Publishers bump the epoch first and take the mutex only when
+    someone is parked.
+*/
+static void chip8_pool_wake(Chip8Pool *pool, const ui8 all)
+{
+    atomic_fetch_add(&pool->work_epoch, 1);
+    if(atomic_load(&pool->num_parked) == 0)
+        return;
+
+    pthread_mutex_lock(&pool->mutex);
+    if(all)
+        pthread_cond_broadcast(&pool->work_condition);
+    else
+        pthread_cond_signal(&pool->work_condition);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+static void chip8_pool_park(Chip8Pool *pool, const unsigned long long epoch)
+{
+    pthread_mutex_lock(&pool->mutex);
+    atomic_fetch_add(&pool->num_parked, 1);
+    while(atomic_load(&pool->work_epoch) == epoch && atomic_load_explicit(&pool->remaining, memory_order_acquire) != 0)
+        pthread_cond_wait(&pool->work_condition, &pool->mutex);
+    atomic_fetch_sub(&pool->num_parked, 1);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+static void chip8_pool_work(Chip8Pool *pool, Chip8PoolWorker *worker)
+{
+    Chip8PoolDeque *deque = &pool->deques[worker->index];
+    while(atomic_load_explicit(&pool->remaining, memory_order_acquire) != 0)
+    {
+        const unsigned long long epoch = atomic_load(&pool->work_epoch);
+        ui32 task = 0;
+        if(!chip8_pool_deque_pop(deque, &task) && !chip8_pool_steal(pool, worker, &task))
+        {
+            chip8_pool_park(pool, epoch);
+            continue;
+        }
+
+        if(chip8_pool_run_slice(pool, &pool->tasks[task]))
+        {
+            // The task the worker pops next is no work for anybody else
+            if(chip8_pool_deque_push(deque, task) > 1)
+                chip8_pool_wake(pool, 0);
+            continue;
+        }
+
+        chip8_pool_complete(pool, task);
+        if(atomic_fetch_sub_explicit(&pool->remaining, 1, memory_order_acq_rel) == 1)
+            chip8_pool_wake(pool, 1);
+    }
+}
+
+static void *chip8_pool_worker_main(void *argument)
+{
+    Chip8PoolWorker *worker = argument;
+    Chip8Pool *pool = worker->pool;
+
+    ui64 seen_generation = 0;
+    for(;;)
+    {
+        pthread_mutex_lock(&pool->mutex);
+        while(!pool->shutdown && pool->generation == seen_generation)
+            pthread_cond_wait(&pool->start_condition, &pool->mutex);
+        const ui8 shutdown = pool->shutdown;
+        seen_generation = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        if(shutdown)
+            break;
+
+        chip8_pool_work(pool, worker);
+
+        pthread_mutex_lock(&pool->mutex);
+        if(--pool->active_workers == 0)
+            pthread_cond_broadcast(&pool->done_condition);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    return NULL;
+}
+
+static ui32 chip8_pool_capacity(const ui32 num_instances)
+{
+    ui32 capacity = 1;
+    while(capacity < num_instances)
+        capacity <<= 1;
+    return capacity;
+}
+
+// Grows the per-run buffers, only called while no worker is active
+static i32 chip8_pool_reserve(Chip8Pool *pool, const ui32 num_instances)
+{
+    if(num_instances <= pool->task_capacity)
+        return 0;
+
+    const ui32 capacity = chip8_pool_capacity(num_instances);
+
+    Chip8PoolTask *tasks = realloc(pool->tasks, capacity * sizeof(Chip8PoolTask));
+    if(tasks == NULL)
+        return -1;
+    pool->tasks = tasks;
+
+    Chip8PoolCompletion *completions = realloc(pool->completions, capacity * sizeof(Chip8PoolCompletion));
+    if(completions == NULL)
+        return -1;
+    pool->completions = completions;
+
+    for(ui32 i = 0; i < pool->desc.num_threads; ++i)
+    {
+        atomic_uint *deque_tasks = realloc(pool->deques[i].tasks, capacity * sizeof(atomic_uint));
+        if(deque_tasks == NULL)
+            return -1;
+        pool->deques[i].tasks = deque_tasks;
+        pool->deques[i].mask = capacity - 1;
+    }
+
+    pool->task_capacity = capacity;
+    pool->completion_mask = capacity - 1;
+    return 0;
+}
+
+Chip8Pool *chip8_pool_create(const Chip8PoolDesc *desc)
+{
+    if(desc == NULL || desc->num_threads == 0 || desc->slice_cycles == 0)
+        return NULL;
+
+    Chip8Pool *pool = calloc(1, sizeof(Chip8Pool));
+    if(pool == NULL)
+        return NULL;
+
+    pool->desc = *desc;
+    pool->workers = calloc(desc->num_threads, sizeof(Chip8PoolWorker));
+    pool->deques = aligned_alloc(C8_POOL_CACHE_LINE, desc->num_threads * sizeof(Chip8PoolDeque));
+    if(pool->workers == NULL || pool->deques == NULL)
+    {
+        free(pool->workers);
+        free(pool->deques);
+        free(pool);
+        return NULL;
+    }
+    memset(pool->deques, 0, desc->num_threads * sizeof(Chip8PoolDeque));
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->start_condition, NULL);
+    pthread_cond_init(&pool->done_condition, NULL);
+    pthread_cond_init(&pool->work_condition, NULL);
+
+    ui32 num_started = 0;
+    for(; num_started < desc->num_threads; ++num_started)
+    {
+        Chip8PoolWorker *worker = &pool->workers[num_started];
+        worker->pool = pool;
+        worker->index = num_started;
+        worker->random_state = 0x9E3779B9u * (num_started + 1);
+        if(pthread_create(&worker->thread, NULL, chip8_pool_worker_main, worker) != 0)
+            break;
+    }
+
+    if(num_started != desc->num_threads)
+    {
+        pool->desc.num_threads = num_started;
+        chip8_pool_destroy(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+void chip8_pool_destroy(Chip8Pool *pool)
+{
+    if(pool == NULL)
+        return;
+
+    chip8_pool_wait(pool);
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->start_condition);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for(ui32 i = 0; i < pool->desc.num_threads; ++i)
+    {
+        pthread_join(pool->workers[i].thread, NULL);
+        free(pool->deques[i].tasks);
+    }
+
+    pthread_cond_destroy(&pool->work_condition);
+    pthread_cond_destroy(&pool->done_condition);
+    pthread_cond_destroy(&pool->start_condition);
+    pthread_mutex_destroy(&pool->mutex);
+
+    free(pool->tasks);
+    free(pool->completions);
+    free(pool->deques);
+    free(pool->workers);
+    free(pool);
+}
+
+i32 chip8_pool_run(Chip8Pool *pool, Chip8 **instances, const ui64 *cycle_budgets, const ui32 num_instances)
+{
+    if(instances == NULL || cycle_budgets == NULL || num_instances == 0)
+        return -1;
+
+    pthread_mutex_lock(&pool->mutex);
+    if(pool->active_workers != 0 || chip8_pool_reserve(pool, num_instances) != 0)
+    {
+        pthread_mutex_unlock(&pool->mutex);
+        return -1;
+    }
+
+    for(ui32 i = 0; i < pool->task_capacity; ++i)
+        atomic_store_explicit(&pool->completions[i].sequence, i, memory_order_relaxed);
+    atomic_store_explicit(&pool->completion_enqueue, 0, memory_order_relaxed);
+    atomic_store_explicit(&pool->completion_dequeue, 0, memory_order_relaxed);
+
+    for(ui32 i = 0; i < pool->desc.num_threads; ++i)
+    {
+        atomic_store_explicit(&pool->deques[i].top, 0, memory_order_relaxed);
+        atomic_store_explicit(&pool->deques[i].bottom, 0, memory_order_relaxed);
+    }
+
+    // Instances without any cycles to run complete right away
+    ui32 remaining = 0;
+    for(ui32 i = 0; i < num_instances; ++i)
+    {
+        Chip8PoolTask *task = &pool->tasks[i];
+        task->chip8 = instances[i];
+        task->cycles_left = cycle_budgets[i];
+
+        if(task->cycles_left == 0)
+        {
+            chip8_pool_complete(pool, i);
+            continue;
+        }
+
+        chip8_pool_deque_push(&pool->deques[remaining % pool->desc.num_threads], i);
+        ++remaining;
+    }
+
+    atomic_store_explicit(&pool->remaining, remaining, memory_order_release);
+    pool->active_workers = pool->desc.num_threads;
+    ++pool->generation;
+    pthread_cond_broadcast(&pool->start_condition);
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+}
+
+ui8 chip8_pool_next_completed(Chip8Pool *pool, ui32 *instance_index)
+{
+    unsigned long long position = atomic_load_explicit(&pool->completion_dequeue, memory_order_relaxed);
+    Chip8PoolCompletion *completion = NULL;
+    for(;;)
+    {
+        if(pool->completions == NULL)
+            return 0;
+
+        completion = &pool->completions[position & pool->completion_mask];
+        const unsigned long long sequence = atomic_load_explicit(&completion->sequence, memory_order_acquire);
+        if(sequence == position + 1)
+        {
+            if(atomic_compare_exchange_weak_explicit(&pool->completion_dequeue, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if(sequence < position + 1)
+        {
+            return 0;
+        }
+        else
+        {
+            position = atomic_load_explicit(&pool->completion_dequeue, memory_order_relaxed);
+        }
+    }
+
+    *instance_index = completion->instance_index;
+    atomic_store_explicit(&completion->sequence, position + pool->completion_mask + 1, memory_order_release);
+    return 1;
+}
+
+void chip8_pool_wait(Chip8Pool *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    while(pool->active_workers != 0)
+        pthread_cond_wait(&pool->done_condition, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "chip8.h"
+
+/*
+    Work-stealing instance scheduler:
+    Runs a set of `Chip8` instances, each with its own cycle budget, on a
+    fixed pool of worker threads. Every worker owns a deque of instances and
+    runs them a slice at a time, idle workers steal from the others and
+    sleep while there is nothing to steal.
+    Finished instances are reported through a lock-free completion queue.
+
+    Instances must be initialized and have their rom loaded before they are
+    submitted, and must not be touched by the host until they are reported
+    complete.
+*/
+
+typedef struct Chip8Pool Chip8Pool;
+
+typedef struct Chip8PoolDesc
+{
+    ui32 num_threads;
+    // Instructions run per instance before it goes back to its deque
+    ui32 slice_cycles;
+} Chip8PoolDesc;
+
+Chip8Pool *chip8_pool_create(const Chip8PoolDesc *desc);
+void chip8_pool_destroy(Chip8Pool *pool);
+
+// Starts running `num_instances` instances, fails while a previous run is still in progress
+i32 chip8_pool_run(Chip8Pool *pool, Chip8 **instances, const ui64 *cycle_budgets, const ui32 num_instances);
+// Non-blocking, returns 1 and the index of a finished instance if there is one
+ui8 chip8_pool_next_completed(Chip8Pool *pool, ui32 *instance_index);
+// Blocks until every instance of the current run has finished
+void chip8_pool_wait(Chip8Pool *pool);
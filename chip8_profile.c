@@ -0,0 +1,118 @@
+#include "chip8_profile.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+ui8 chip8_profile_attach(Chip8 *chip8, Chip8Profile *profile)
+{
+#ifdef C8_PROFILE
+    chip8->profile = profile;
+    return 1;
+#else
+    (void)chip8; (void)profile;
+    return 0;
+#endif
+}
+
+void chip8_profile_reset(Chip8Profile *profile)
+{
+    memset(profile, 0, sizeof(Chip8Profile));
+}
+
+void chip8_profile_merge(Chip8Profile *profile, const Chip8Profile *other)
+{
+    for(ui32 op = 0; op < C8_PROFILE_MAX_OPS; ++op)
+    {
+        profile->op_counts[op] += other->op_counts[op];
+        profile->op_ticks[op] += other->op_ticks[op];
+    }
+
+    for(ui32 address = 0; address < C8_MEMORY_SIZE; ++address)
+    {
+        if(other->pc_hits[address] == 0)
+            continue;
+        profile->pc_hits[address] += other->pc_hits[address];
+        profile->pc_ops[address] = other->pc_ops[address];
+    }
+
+    profile->num_draws += other->num_draws;
+    profile->num_collisions += other->num_collisions;
+}
+
+typedef struct Chip8ProfileEntry
+{
+    ui64 weight;
+    ui16 index;
+} Chip8ProfileEntry;
+
+// Heaviest first, lower index first on ties so reports are stable
+static int chip8_profile_compare(const void *a, const void *b)
+{
+    const Chip8ProfileEntry *entry_a = (const Chip8ProfileEntry*)a;
+    const Chip8ProfileEntry *entry_b = (const Chip8ProfileEntry*)b;
+    if(entry_a->weight != entry_b->weight)
+        return entry_a->weight < entry_b->weight ? 1 : -1;
+    return (entry_a->index > entry_b->index) - (entry_a->index < entry_b->index);
+}
+
+static const char *chip8_profile_op_name(const ui8 op)
+{
+    const char *name = chip8_op_name(op);
+    return name != NULL ? name : "?";
+}
+
+void chip8_profile_report(const Chip8Profile *profile, FILE *file, const ui32 num_hot_pcs)
+{
+    ui64 total_count = 0;
+    ui64 total_ticks = 0;
+    Chip8ProfileEntry ops[C8_PROFILE_MAX_OPS];
+    for(ui16 op = 0; op < C8_PROFILE_MAX_OPS; ++op)
+    {
+        total_count += profile->op_counts[op];
+        total_ticks += profile->op_ticks[op];
+        ops[op].weight = profile->op_ticks[op];
+        ops[op].index = op;
+    }
+    qsort(ops, C8_PROFILE_MAX_OPS, sizeof(Chip8ProfileEntry), chip8_profile_compare);
+
+    fprintf(file, "%-12s %14s %7s %16s %7s %10s\n", "class", "count", "count%", "ticks", "ticks%", "ticks/op");
+    for(ui32 i = 0; i < C8_PROFILE_MAX_OPS; ++i)
+    {
+        const ui8 op = (ui8)ops[i].index;
+        const ui64 count = profile->op_counts[op];
+        if(count == 0)
+            continue;
+
+        const ui64 ticks = profile->op_ticks[op];
+        fprintf(file, "%-12s %14llu %6.2f%% %16llu %6.2f%% %10.1f\n",
+            chip8_profile_op_name(op), count, 100.0 * (double)count / (double)total_count,
+            ticks, total_ticks != 0 ? 100.0 * (double)ticks / (double)total_ticks : 0.0, (double)ticks / (double)count);
+    }
+
+    static Chip8ProfileEntry addresses[C8_MEMORY_SIZE];
+    for(ui16 address = 0; address < C8_MEMORY_SIZE; ++address)
+    {
+        addresses[address].weight = profile->pc_hits[address];
+        addresses[address].index = address;
+    }
+    qsort(addresses, C8_MEMORY_SIZE, sizeof(Chip8ProfileEntry), chip8_profile_compare);
+
+    fprintf(file, "\n%-12s %14s %7s  %s\n", "address", "hits", "hits%", "class");
+    for(ui32 i = 0; i < num_hot_pcs && i < C8_MEMORY_SIZE && addresses[i].weight != 0; ++i)
+    {
+        const ui16 address = addresses[i].index;
+        fprintf(file, "0x%03X        %14llu %6.2f%%  %s\n",
+            address, addresses[i].weight, 100.0 * (double)addresses[i].weight / (double)total_count, chip8_profile_op_name(profile->pc_ops[address]));
+    }
+
+    fprintf(file, "\ninstructions=%llu draws=%llu collisions=%llu\n", total_count, profile->num_draws, profile->num_collisions);
+}
+
+void chip8_profile_write_folded(const Chip8Profile *profile, FILE *file, const char *root)
+{
+    for(ui16 address = 0; address < C8_MEMORY_SIZE; ++address)
+    {
+        if(profile->pc_hits[address] != 0)
+            fprintf(file, "%s;%s;0x%03X %llu\n", root, chip8_profile_op_name(profile->pc_ops[address]), address, profile->pc_hits[address]);
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "chip8.h"
+
+#include <stdio.h>
+
+/*
+    Profiler:
+    Compiled in only with `C8_PROFILE` defined, see the CHIP8_ENABLE_PROFILE
+    cmake option. Without it attaching fails and the interpreter carries no
+    instrumentation at all.
+
+    An attached profile counts every instruction the interpreter runs by
+    opcode class, adds up the host ticks spent in its handler and keeps a
+    hit histogram over the whole address space. Blocks run by the jit are
+    not seen, idle loops count once per skip. A profile is not thread-safe,
+    give every thread its own and merge them afterwards.
+*/
+
+enum
+{
+    C8_PROFILE_MAX_OPS = 64,
+};
+
+typedef struct Chip8Profile
+{
+    ui64 op_counts[C8_PROFILE_MAX_OPS];
+    // Timestamp counter ticks where the host has one, nanoseconds otherwise
+    ui64 op_ticks[C8_PROFILE_MAX_OPS];
+    ui64 pc_hits[C8_MEMORY_SIZE];
+    // Opcode class last run at every address
+    ui8 pc_ops[C8_MEMORY_SIZE];
+    ui64 num_draws;
+    // Draws that set VF
+    ui64 num_collisions;
+} Chip8Profile;
+
+// Returns 0 when profiling is not compiled in, a NULL `profile` detaches
+ui8 chip8_profile_attach(Chip8 *chip8, Chip8Profile *profile);
+void chip8_profile_reset(Chip8Profile *profile);
+void chip8_profile_merge(Chip8Profile *profile, const Chip8Profile *other);
+
+// Table of opcode classes by time spent, the `num_hot_pcs` most executed addresses and the draw counts
+void chip8_profile_report(const Chip8Profile *profile, FILE *file, const ui32 num_hot_pcs);
+// Folded stacks for flamegraph.pl, one `root;class;address count` line per executed address
+void chip8_profile_write_folded(const Chip8Profile *profile, FILE *file, const char *root);
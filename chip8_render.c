@@ -0,0 +1,293 @@
+#include "chip8_render.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    #ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+        #define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+    #endif
+    #define C8_RENDER_EXCHANGE(pointer, value) ((ui32)InterlockedExchange((volatile LONG*)(pointer), (LONG)(value)))
+    #define C8_RENDER_LOAD(pointer) ((ui32)InterlockedCompareExchange((volatile LONG*)(pointer), 0, 0))
+    #define C8_RENDER_STORE(pointer, value) ((void)InterlockedExchange((volatile LONG*)(pointer), (LONG)(value)))
+#else
+    #include <errno.h>
+    #include <pthread.h>
+    #include <time.h>
+    #define C8_RENDER_EXCHANGE(pointer, value) __atomic_exchange_n(pointer, value, __ATOMIC_ACQ_REL)
+    #define C8_RENDER_LOAD(pointer) __atomic_load_n(pointer, __ATOMIC_ACQUIRE)
+    #define C8_RENDER_STORE(pointer, value) __atomic_store_n(pointer, value, __ATOMIC_RELEASE)
+#endif
+
+enum
+{
+    C8_RENDER_NUM_FRAMES = 3,
+    C8_RENDER_INDEX_MASK = 0x3,
+    // Set in `middle` while it holds a frame the render thread has not taken yet
+    C8_RENDER_FRESH = 0x4,
+};
+
+/*
+    Triple buffer:
+    `back` is only touched by the publisher and `front` only by the render
+    thread, the third frame is parked in `middle`. Publishing fills `back`
+    and swaps it with `middle`, the render thread swaps `front` with
+    `middle` only when the fresh bit says it changed since its last swap.
+    Neither side ever waits and the render thread always sees the newest
+    complete frame.
+*/
+struct Chip8Renderer
+{
+    Chip8RenderBackend backend;
+    Chip8Frame frames[C8_RENDER_NUM_FRAMES];
+    ui32 middle;
+    ui32 back;
+    ui32 front;
+    ui32 stop;
+    ui32 refresh_rate;
+
+    // Copy of the last presented frame, `front` goes back into the rotation after the next swap
+    Chip8Frame presented;
+    ui8 has_presented;
+
+    Chip8RenderStats stats;
+
+#if defined(_WIN32)
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+};
+
+// Presents the newest frame when one was published since the last present
+static void chip8_renderer_present(Chip8Renderer *renderer)
+{
+    if(!(C8_RENDER_LOAD(&renderer->middle) & C8_RENDER_FRESH))
+        return;
+
+    renderer->front = C8_RENDER_EXCHANGE(&renderer->middle, renderer->front) & C8_RENDER_INDEX_MASK;
+    const Chip8Frame *frame = &renderer->frames[renderer->front];
+    renderer->backend.present(renderer->backend.context, frame, renderer->has_presented ? &renderer->presented : NULL);
+    renderer->presented = *frame;
+    renderer->has_presented = 1;
+    ++renderer->stats.num_presented;
+}
+
+static void chip8_renderer_finish(Chip8Renderer *renderer)
+{
+    chip8_renderer_present(renderer);
+    if(renderer->backend.close != NULL)
+        renderer->backend.close(renderer->backend.context);
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI chip8_renderer_main(LPVOID parameter)
+{
+    Chip8Renderer *renderer = (Chip8Renderer*)parameter;
+
+    HANDLE timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if(timer == NULL)
+        timer = CreateWaitableTimerW(NULL, FALSE, NULL);
+
+    // Waitable timers count in 100ns units and negative means relative
+    LARGE_INTEGER due_time = {0};
+    due_time.QuadPart = -(LONGLONG)(10000000u / renderer->refresh_rate);
+    const LONG period_ms = (LONG)(1000u / renderer->refresh_rate);
+    if(timer != NULL && !SetWaitableTimer(timer, &due_time, period_ms > 0 ? period_ms : 1, NULL, NULL, FALSE))
+    {
+        CloseHandle(timer);
+        timer = NULL;
+    }
+
+    while(!C8_RENDER_LOAD(&renderer->stop))
+    {
+        if(timer != NULL)
+            WaitForSingleObject(timer, INFINITE);
+        else
+            Sleep((DWORD)period_ms);
+        chip8_renderer_present(renderer);
+    }
+
+    if(timer != NULL)
+        CloseHandle(timer);
+    chip8_renderer_finish(renderer);
+    return 0;
+}
+#else
+static void *chip8_renderer_main(void *parameter)
+{
+    Chip8Renderer *renderer = (Chip8Renderer*)parameter;
+
+    const ui64 period_ns = 1000000000ull / renderer->refresh_rate;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    ui64 next_tick = (ui64)now.tv_sec * 1000000000ull + (ui64)now.tv_nsec;
+
+    while(!C8_RENDER_LOAD(&renderer->stop))
+    {
+        next_tick += period_ns;
+        const struct timespec deadline = { (time_t)(next_tick / 1000000000ull), (long)(next_tick % 1000000000ull) };
+        while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR)
+            ;
+
+        chip8_renderer_present(renderer);
+
+        // A present that overran its tick starts a new schedule instead of presenting back to back
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        const ui64 now_ns = (ui64)now.tv_sec * 1000000000ull + (ui64)now.tv_nsec;
+        if(now_ns > next_tick + period_ns)
+            next_tick = now_ns;
+    }
+
+    chip8_renderer_finish(renderer);
+    return NULL;
+}
+#endif
+
+Chip8Renderer *chip8_renderer_create(const Chip8RenderBackend *backend, const ui32 refresh_rate)
+{
+    if(backend == NULL || backend->present == NULL || refresh_rate == 0)
+        return NULL;
+
+    Chip8Renderer *renderer = calloc(1, sizeof(Chip8Renderer));
+    if(renderer == NULL)
+        return NULL;
+
+    renderer->backend = *backend;
+    renderer->refresh_rate = refresh_rate;
+    renderer->front = 0;
+    renderer->middle = 1;
+    renderer->back = 2;
+
+#if defined(_WIN32)
+    renderer->thread = CreateThread(NULL, 0, chip8_renderer_main, renderer, 0, NULL);
+    if(renderer->thread == NULL)
+#else
+    if(pthread_create(&renderer->thread, NULL, chip8_renderer_main, renderer) != 0)
+#endif
+    {
+        free(renderer);
+        return NULL;
+    }
+
+    return renderer;
+}
+
+void chip8_renderer_publish(Chip8Renderer *renderer, const Chip8 *chip8)
+{
+    Chip8Frame *frame = &renderer->frames[renderer->back];
+    memcpy(frame->rows, chip8->screen_memory, sizeof(frame->rows));
+    frame->hires = chip8->hires;
+    frame->cycle = chip8->cycle_count;
+    frame->sequence = renderer->stats.num_published++;
+
+    renderer->back = C8_RENDER_EXCHANGE(&renderer->middle, renderer->back | C8_RENDER_FRESH) & C8_RENDER_INDEX_MASK;
+}
+
+void chip8_renderer_destroy(Chip8Renderer *renderer, Chip8RenderStats *stats)
+{
+    if(renderer == NULL)
+        return;
+
+    C8_RENDER_STORE(&renderer->stop, 1);
+#if defined(_WIN32)
+    WaitForSingleObject(renderer->thread, INFINITE);
+    CloseHandle(renderer->thread);
+#else
+    pthread_join(renderer->thread, NULL);
+#endif
+
+    if(stats != NULL)
+        *stats = renderer->stats;
+    free(renderer);
+}
+
+ui32 chip8_frame_changed_rows(const Chip8Frame *frame, const Chip8Frame *previous)
+{
+    if(previous == NULL || frame->hires != previous->hires)
+        return 0xFFFFFFFFu;
+
+    // A band is one lo-res row or the four words of two hi-res rows
+    const ui32 num_words = frame->hires ? C8_SCREEN_WORDS : C8_SCREEN_HEIGHT;
+    const ui32 words_per_band = frame->hires ? 4 : 1;
+    ui32 changed_bands = 0;
+    for(ui32 word = 0; word < num_words; ++word)
+    {
+        if(frame->rows[word] != previous->rows[word])
+            changed_bands |= 1u << (word / words_per_band);
+    }
+    return changed_bands;
+}
+
+/*
+    ANSI backend:
+    Every text line shows two screen rows, the upper one in the top half
+    of the cell, so a text line is two bands in lo-res and one in hi-res.
+    The first present and every resolution change clear the terminal and
+    hide the cursor, other ones only move to and rewrite the lines that
+    changed.
+*/
+enum
+{
+    C8_RENDER_ANSI_LINES = C8_HIRES_SCREEN_HEIGHT / 2,
+    // Cursor move plus three UTF-8 bytes per cell
+    C8_RENDER_ANSI_LINE_SIZE = 16 + C8_HIRES_SCREEN_WIDTH * 3,
+};
+
+static void chip8_render_ansi_present(void *context, const Chip8Frame *frame, const Chip8Frame *previous)
+{
+    static const char *const cells[4] = { " ", "\xE2\x96\x80", "\xE2\x96\x84", "\xE2\x96\x88" };
+
+    FILE *file = (FILE*)context;
+    if(previous == NULL || frame->hires != previous->hires)
+        fputs("\x1b[2J\x1b[?25l", file);
+
+    const ui32 width = frame->hires ? C8_HIRES_SCREEN_WIDTH : C8_SCREEN_WIDTH;
+    const ui32 num_lines = (frame->hires ? C8_HIRES_SCREEN_HEIGHT : C8_SCREEN_HEIGHT) / 2;
+    const ui32 bands_per_line = frame->hires ? 1 : 2;
+    const ui32 changed_bands = chip8_frame_changed_rows(frame, previous);
+    char line[C8_RENDER_ANSI_LINE_SIZE];
+    for(ui32 text_line = 0; text_line < num_lines; ++text_line)
+    {
+        if(!(changed_bands & (((1u << bands_per_line) - 1) << (text_line * bands_per_line))))
+            continue;
+
+        int size = snprintf(line, sizeof(line), "\x1b[%u;1H", text_line + 1);
+        for(ui32 x = 0; x < width; ++x)
+        {
+            const ui8 top = chip8_frame_pixel(frame, x, text_line * 2);
+            const ui8 bottom = chip8_frame_pixel(frame, x, text_line * 2 + 1);
+            const char *cell = cells[top | bottom << 1];
+            while(*cell != '\0')
+                line[size++] = *cell++;
+        }
+        fwrite(line, 1, (size_t)size, file);
+    }
+    fflush(file);
+}
+
+static void chip8_render_ansi_close(void *context)
+{
+    FILE *file = (FILE*)context;
+    fprintf(file, "\x1b[%u;1H\x1b[?25h", C8_RENDER_ANSI_LINES + 1);
+    fflush(file);
+}
+
+Chip8RenderBackend chip8_render_backend_ansi(FILE *file)
+{
+    const Chip8RenderBackend backend = { chip8_render_ansi_present, chip8_render_ansi_close, file };
+    return backend;
+}
+
+static void chip8_render_null_present(void *context, const Chip8Frame *frame, const Chip8Frame *previous)
+{
+    (void)context; (void)frame; (void)previous;
+}
+
+Chip8RenderBackend chip8_render_backend_null(void)
+{
+    const Chip8RenderBackend backend = { chip8_render_null_present, NULL, NULL };
+    return backend;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "chip8.h"
+
+#include <stdio.h>
+
+/*
+    Render thread:
+    The emulator publishes finished frames into a triple buffer and never
+    waits for the display. A render thread wakes once per display tick,
+    takes the newest published frame and hands it to a backend. Frames
+    published between two ticks are coalesced into one present, so a slow
+    backend cannot stall emulation and a rom that draws many times per
+    tick still costs one present.
+
+    Publishing must happen on a single thread, usually the one running
+    the instance.
+*/
+
+typedef struct Chip8RenderBackend
+{
+    // Called on the render thread, `previous` is the last presented frame or NULL for the first present
+    void (*present)(void *context, const Chip8Frame *frame, const Chip8Frame *previous);
+    // Called once the render thread stopped, may be NULL
+    void (*close)(void *context);
+    void *context;
+} Chip8RenderBackend;
+
+typedef struct Chip8RenderStats
+{
+    ui64 num_published;
+    ui64 num_presented;
+} Chip8RenderStats;
+
+typedef struct Chip8Renderer Chip8Renderer;
+
+// Starts a render thread presenting up to `refresh_rate` times per second, NULL on failure
+Chip8Renderer *chip8_renderer_create(const Chip8RenderBackend *backend, const ui32 refresh_rate);
+// Copies the screen of `chip8` and makes it the newest frame, never blocks
+void chip8_renderer_publish(Chip8Renderer *renderer, const Chip8 *chip8);
+// Presents the newest frame if it was not yet, stops the render thread and closes the backend
+void chip8_renderer_destroy(Chip8Renderer *renderer, Chip8RenderStats *stats);
+
+// Screen bands that differ between two frames, all of them without a previous frame or after a resolution change
+ui32 chip8_frame_changed_rows(const Chip8Frame *frame, const Chip8Frame *previous);
+
+// Half-block characters on an ANSI terminal, two screen rows per text line, only changed lines are rewritten
+Chip8RenderBackend chip8_render_backend_ansi(FILE *file);
+// Presents nothing, for measuring the cost of the render path itself
+Chip8RenderBackend chip8_render_backend_null(void);
@@ -0,0 +1,322 @@
+#include "chip8_rom.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <pthread.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+    #define C8_ROM_MMAP 1
+#endif
+
+// Size, modification time and file id, compared to tell whether a path still names the same file
+typedef struct Chip8RomIdentity
+{
+    ui64 size;
+    ui64 modified_seconds;
+    ui64 modified_nanoseconds;
+    ui64 device;
+    ui64 inode;
+} Chip8RomIdentity;
+
+typedef struct Chip8RomPath
+{
+    char *path;
+    Chip8RomIdentity identity;
+    const Chip8Rom *rom;
+} Chip8RomPath;
+
+typedef struct Chip8RomCache
+{
+    Chip8Rom **roms;
+    ui32 num_roms;
+    ui32 roms_capacity;
+
+    Chip8RomPath *paths;
+    ui32 num_paths;
+    ui32 paths_capacity;
+} Chip8RomCache;
+
+static Chip8RomCache chip8_rom_cache;
+
+#if defined(_WIN32)
+static SRWLOCK chip8_rom_cache_mutex = SRWLOCK_INIT;
+
+static void chip8_rom_cache_lock(void)
+{
+    AcquireSRWLockExclusive(&chip8_rom_cache_mutex);
+}
+
+static void chip8_rom_cache_unlock(void)
+{
+    ReleaseSRWLockExclusive(&chip8_rom_cache_mutex);
+}
+#else
+static pthread_mutex_t chip8_rom_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void chip8_rom_cache_lock(void)
+{
+    pthread_mutex_lock(&chip8_rom_cache_mutex);
+}
+
+static void chip8_rom_cache_unlock(void)
+{
+    pthread_mutex_unlock(&chip8_rom_cache_mutex);
+}
+#endif
+
+static void chip8_rom_identity(const struct stat *file_status, Chip8RomIdentity *identity)
+{
+    memset(identity, 0, sizeof(Chip8RomIdentity));
+    identity->size = (ui64)file_status->st_size;
+    identity->modified_seconds = (ui64)file_status->st_mtime;
+#if defined(__linux__)
+    identity->modified_nanoseconds = (ui64)file_status->st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+    identity->modified_nanoseconds = (ui64)file_status->st_mtimespec.tv_nsec;
+#endif
+    identity->device = (ui64)file_status->st_dev;
+    identity->inode = (ui64)file_status->st_ino;
+}
+
+static const Chip8Rom *chip8_rom_find_path(const char *rom_file_path, const Chip8RomIdentity *identity)
+{
+    for(ui32 i = 0; i < chip8_rom_cache.num_paths; ++i)
+    {
+        const Chip8RomPath *path = &chip8_rom_cache.paths[i];
+        if(strcmp(path->path, rom_file_path) == 0)
+            return memcmp(&path->identity, identity, sizeof(Chip8RomIdentity)) == 0 ? path->rom : NULL;
+    }
+    return NULL;
+}
+
+static const Chip8Rom *chip8_rom_find_data(const ui64 hash, const ui8 *data, const ui32 size)
+{
+    for(ui32 i = 0; i < chip8_rom_cache.num_roms; ++i)
+    {
+        const Chip8Rom *rom = chip8_rom_cache.roms[i];
+        if(rom->hash == hash && rom->size == size && memcmp(rom->data, data, size) == 0)
+            return rom;
+    }
+    return NULL;
+}
+
+// Grows `*items` to hold at least one more element
+static ui8 chip8_rom_reserve(void **items, ui32 *capacity, const ui32 count, const size_t item_size)
+{
+    if(count < *capacity)
+        return 1;
+
+    const ui32 new_capacity = *capacity != 0 ? *capacity * 2 : 16;
+    void *new_items = realloc(*items, new_capacity * item_size);
+    if(new_items == NULL)
+        return 0;
+
+    *items = new_items;
+    *capacity = new_capacity;
+    return 1;
+}
+
+static const Chip8Rom *chip8_rom_insert(const char *rom_file_path, const Chip8RomIdentity *identity, const ui8 *data, const ui32 size)
+{
+    const ui64 hash = chip8_rom_hash(data, size);
+    const Chip8Rom *rom = chip8_rom_find_data(hash, data, size);
+    if(rom == NULL)
+    {
+        Chip8Rom *new_rom = malloc(sizeof(Chip8Rom));
+        if(new_rom == NULL || !chip8_rom_reserve((void**)&chip8_rom_cache.roms, &chip8_rom_cache.roms_capacity, chip8_rom_cache.num_roms, sizeof(Chip8Rom*)))
+        {
+            free(new_rom);
+            return NULL;
+        }
+
+        new_rom->hash = hash;
+        new_rom->size = size;
+        memcpy(new_rom->data, data, size);
+        chip8_rom_cache.roms[chip8_rom_cache.num_roms++] = new_rom;
+        rom = new_rom;
+    }
+
+    // Repoint a path whose file changed, otherwise remember the new one
+    for(ui32 i = 0; i < chip8_rom_cache.num_paths; ++i)
+    {
+        Chip8RomPath *path = &chip8_rom_cache.paths[i];
+        if(strcmp(path->path, rom_file_path) == 0)
+        {
+            path->identity = *identity;
+            path->rom = rom;
+            return rom;
+        }
+    }
+
+    const size_t path_size = strlen(rom_file_path) + 1;
+    char *path_copy = malloc(path_size);
+    if(path_copy == NULL || !chip8_rom_reserve((void**)&chip8_rom_cache.paths, &chip8_rom_cache.paths_capacity, chip8_rom_cache.num_paths, sizeof(Chip8RomPath)))
+    {
+        // The rom itself is cached, only the path shortcut is lost
+        free(path_copy);
+        return rom;
+    }
+
+    memcpy(path_copy, rom_file_path, path_size);
+    Chip8RomPath *path = &chip8_rom_cache.paths[chip8_rom_cache.num_paths++];
+    path->path = path_copy;
+    path->identity = *identity;
+    path->rom = rom;
+    return rom;
+}
+
+static i32 chip8_rom_check_size(const ui64 size)
+{
+    if(size == 0)
+        return C8_LOAD_EMPTY;
+    if(size > C8_MAX_ROM_SIZE)
+        return C8_LOAD_TOO_LARGE;
+    return C8_LOAD_OK;
+}
+
+#if C8_ROM_MMAP
+// Maps the file read-only and copies it into the cache, the copy keeps later writes to the file out of cached entries
+static i32 chip8_rom_read(const char *rom_file_path, const Chip8Rom **rom)
+{
+    const int file = open(rom_file_path, O_RDONLY);
+    if(file < 0)
+        return C8_LOAD_OPEN_FAILED;
+
+    struct stat file_status;
+    if(fstat(file, &file_status) != 0 || !S_ISREG(file_status.st_mode))
+    {
+        close(file);
+        return C8_LOAD_READ_FAILED;
+    }
+
+    const i32 status = chip8_rom_check_size((ui64)file_status.st_size);
+    if(status != C8_LOAD_OK)
+    {
+        close(file);
+        return status;
+    }
+
+    const ui32 size = (ui32)file_status.st_size;
+    void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if(mapping == MAP_FAILED)
+        return C8_LOAD_READ_FAILED;
+
+    Chip8RomIdentity identity;
+    chip8_rom_identity(&file_status, &identity);
+    *rom = chip8_rom_insert(rom_file_path, &identity, mapping, size);
+    munmap(mapping, size);
+    return *rom != NULL ? C8_LOAD_OK : C8_LOAD_OUT_OF_MEMORY;
+}
+#else
+static i32 chip8_rom_read(const char *rom_file_path, const Chip8Rom **rom)
+{
+    struct stat file_status;
+    if(stat(rom_file_path, &file_status) != 0)
+        return C8_LOAD_OPEN_FAILED;
+
+    const i32 status = chip8_rom_check_size((ui64)file_status.st_size);
+    if(status != C8_LOAD_OK)
+        return status;
+
+    FILE *file = fopen(rom_file_path, "rb");
+    if(file == NULL)
+        return C8_LOAD_OPEN_FAILED;
+
+    ui8 data[C8_MAX_ROM_SIZE];
+    const ui32 size = (ui32)file_status.st_size;
+    const size_t num_read = fread(data, 1, size, file);
+    fclose(file);
+    if(num_read != size)
+        return C8_LOAD_READ_FAILED;
+
+    Chip8RomIdentity identity;
+    chip8_rom_identity(&file_status, &identity);
+    *rom = chip8_rom_insert(rom_file_path, &identity, data, size);
+    return *rom != NULL ? C8_LOAD_OK : C8_LOAD_OUT_OF_MEMORY;
+}
+#endif
+
+i32 chip8_rom_open(const char *rom_file_path, const Chip8Rom **rom)
+{
+    struct stat file_status;
+    if(stat(rom_file_path, &file_status) != 0)
+        return C8_LOAD_OPEN_FAILED;
+
+    Chip8RomIdentity identity;
+    chip8_rom_identity(&file_status, &identity);
+
+    chip8_rom_cache_lock();
+    const Chip8Rom *cached_rom = chip8_rom_find_path(rom_file_path, &identity);
+    const i32 status = cached_rom != NULL ? C8_LOAD_OK : chip8_rom_read(rom_file_path, &cached_rom);
+    chip8_rom_cache_unlock();
+
+    if(status == C8_LOAD_OK)
+        *rom = cached_rom;
+    return status;
+}
+
+void chip8_rom_load(Chip8 *chip8, const Chip8Rom *rom)
+{
+    chip8_load_rom_data(chip8, rom->data, rom->size);
+}
+
+ui64 chip8_rom_hash(const ui8 *data, const ui32 size)
+{
+    // FNV-1a
+    ui64 hash = 0xCBF29CE484222325ULL;
+    for(ui32 i = 0; i < size; ++i)
+    {
+        hash ^= data[i];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+/*
+    Quirks defaults:
+    Roms known to need another profile than `C8_QUIRKS_DEFAULT`, keyed by
+    `chip8_rom_hash`. Every other rom runs with the default one.
+*/
+typedef struct Chip8RomQuirks
+{
+    ui64 hash;
+    ui8 quirks;
+} Chip8RomQuirks;
+
+static const Chip8RomQuirks chip8_rom_quirks_table[] =
+{
+    // BLITZ, the plane wraps into the buildings and ends the game on the first frame
+    { 0x29BCAB9B664D212BULL, C8_QUIRKS_COSMAC },
+};
+
+ui8 chip8_rom_quirks(const ui64 hash)
+{
+    for(ui32 i = 0; i < sizeof(chip8_rom_quirks_table) / sizeof(chip8_rom_quirks_table[0]); ++i)
+    {
+        if(chip8_rom_quirks_table[i].hash == hash)
+            return chip8_rom_quirks_table[i].quirks;
+    }
+    return C8_QUIRKS_DEFAULT;
+}
+
+void chip8_rom_cache_clear(void)
+{
+    chip8_rom_cache_lock();
+    for(ui32 i = 0; i < chip8_rom_cache.num_roms; ++i)
+        free(chip8_rom_cache.roms[i]);
+    for(ui32 i = 0; i < chip8_rom_cache.num_paths; ++i)
+        free(chip8_rom_cache.paths[i].path);
+    free(chip8_rom_cache.roms);
+    free(chip8_rom_cache.paths);
+    memset(&chip8_rom_cache, 0, sizeof(Chip8RomCache));
+    chip8_rom_cache_unlock();
+}
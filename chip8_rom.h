@@ -0,0 +1,34 @@
+#pragma once
+
+#include "chip8.h"
+
+/*
+    Process-wide rom cache:
+    Rom files are mapped, validated and copied once into a cache entry keyed
+    by a hash of their contents, so identical files opened through different
+    paths share one entry. Paths seen before are resolved without touching
+    the file again as long as its size and modification time are unchanged,
+    so loading a rom into another instance is a single copy from the cache.
+
+    Entries stay valid until `chip8_rom_cache_clear`. The cache is safe to use
+    from several threads.
+*/
+
+typedef struct Chip8Rom
+{
+    // FNV-1a of the rom contents
+    ui64 hash;
+    ui32 size;
+    ui8 data[C8_MAX_ROM_SIZE];
+} Chip8Rom;
+
+// Returns a `C8_LOAD_*` status, `*rom` is only set on `C8_LOAD_OK`
+i32 chip8_rom_open(const char *rom_file_path, const Chip8Rom **rom);
+void chip8_rom_load(Chip8 *chip8, const Chip8Rom *rom);
+
+ui64 chip8_rom_hash(const ui8 *data, const ui32 size);
+// `C8_QUIRKS_*` profile a rom with this hash runs best with
+ui8 chip8_rom_quirks(const ui64 hash);
+
+// Frees every entry, no rom returned by `chip8_rom_open` may be used afterwards
+void chip8_rom_cache_clear(void);
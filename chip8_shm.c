@@ -0,0 +1,287 @@
+#include "chip8_shm.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define C8_SHM_LOAD_ACQUIRE(pointer) __atomic_load_n(pointer, __ATOMIC_ACQUIRE)
+#define C8_SHM_LOAD_RELAXED(pointer) __atomic_load_n(pointer, __ATOMIC_RELAXED)
+#define C8_SHM_STORE_RELEASE(pointer, value) __atomic_store_n(pointer, value, __ATOMIC_RELEASE)
+#define C8_SHM_STORE_RELAXED(pointer, value) __atomic_store_n(pointer, value, __ATOMIC_RELAXED)
+
+enum
+{
+    // "C8SM" read as a little-endian word
+    C8_SHM_MAGIC = 0x4D533843,
+    C8_SHM_VERSION = 1,
+    C8_SHM_CACHE_LINE = 64,
+    C8_SHM_MAX_CHANNELS = 1 << 16,
+    C8_SHM_MAX_SLOTS = 1 << 10,
+    // Seqlock reads given up on when a publisher keeps rewriting the slot
+    C8_SHM_READ_ATTEMPTS = 64,
+};
+
+/*
+    Region layout:
+    The header, one counter per channel, then the slots of channel 0
+    followed by the slots of channel 1 and so on, every part on its own
+    cache lines so publishers of neighbouring channels never share one.
+    `magic` is written last by the creator, attaching before it is set
+    reports `C8_SHM_NOT_READY`.
+*/
+typedef struct Chip8ShmHeader
+{
+    _Alignas(C8_SHM_CACHE_LINE) ui32 magic;
+    ui32 version;
+    ui32 num_channels;
+    ui32 num_slots;
+    // Lets builds with another `Chip8ShmFrame` layout reject the region
+    ui32 slot_size;
+} Chip8ShmHeader;
+
+typedef struct Chip8ShmChannel
+{
+    // Frames published so far, stored after the slot of the newest one is complete
+    _Alignas(C8_SHM_CACHE_LINE) ui64 num_frames;
+} Chip8ShmChannel;
+
+typedef struct Chip8ShmSlot
+{
+    // Odd while the publisher writes the frame
+    _Alignas(C8_SHM_CACHE_LINE) ui32 sequence;
+    Chip8ShmFrame frame;
+} Chip8ShmSlot;
+
+struct Chip8Shm
+{
+    void *base;
+    size_t size;
+    ui8 writable;
+    ui32 num_channels;
+    ui32 num_slots;
+    Chip8ShmChannel *channels;
+    Chip8ShmSlot *slots;
+};
+
+static size_t chip8_shm_region_size(const ui32 num_channels, const ui32 num_slots)
+{
+    return sizeof(Chip8ShmHeader) + (size_t)num_channels * sizeof(Chip8ShmChannel) + (size_t)num_channels * num_slots * sizeof(Chip8ShmSlot);
+}
+
+static i32 chip8_shm_bind(void *base, const size_t size, const ui8 writable, Chip8Shm **shm)
+{
+    const Chip8ShmHeader *header = (const Chip8ShmHeader*)base;
+    Chip8Shm *new_shm = calloc(1, sizeof(Chip8Shm));
+    if(new_shm == NULL)
+    {
+        munmap(base, size);
+        return C8_SHM_OUT_OF_MEMORY;
+    }
+
+    new_shm->base = base;
+    new_shm->size = size;
+    new_shm->writable = writable;
+    new_shm->num_channels = header->num_channels;
+    new_shm->num_slots = header->num_slots;
+    new_shm->channels = (Chip8ShmChannel*)((ui8*)base + sizeof(Chip8ShmHeader));
+    new_shm->slots = (Chip8ShmSlot*)(new_shm->channels + header->num_channels);
+    *shm = new_shm;
+    return C8_SHM_OK;
+}
+
+static i32 chip8_shm_map(const char *name, const ui8 writable, Chip8Shm **shm)
+{
+    const int fd = shm_open(name, writable ? O_RDWR : O_RDONLY, 0);
+    if(fd < 0)
+        return C8_SHM_OPEN_FAILED;
+
+    struct stat status;
+    if(fstat(fd, &status) != 0)
+    {
+        close(fd);
+        return C8_SHM_OPEN_FAILED;
+    }
+    // The creator may not have sized it yet
+    if((size_t)status.st_size < sizeof(Chip8ShmHeader))
+    {
+        close(fd);
+        return C8_SHM_NOT_READY;
+    }
+
+    const size_t size = (size_t)status.st_size;
+    void *base = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED)
+        return C8_SHM_MAP_FAILED;
+
+    const Chip8ShmHeader *header = (const Chip8ShmHeader*)base;
+    const ui32 magic = C8_SHM_LOAD_ACQUIRE(&header->magic);
+    i32 result = C8_SHM_OK;
+    if(magic == 0)
+        result = C8_SHM_NOT_READY;
+    else if(magic != C8_SHM_MAGIC || header->version != C8_SHM_VERSION || header->slot_size != sizeof(Chip8ShmSlot)
+        || header->num_channels == 0 || header->num_channels > C8_SHM_MAX_CHANNELS
+        || header->num_slots == 0 || header->num_slots > C8_SHM_MAX_SLOTS
+        || chip8_shm_region_size(header->num_channels, header->num_slots) != size)
+        result = C8_SHM_BAD_HEADER;
+
+    if(result != C8_SHM_OK)
+    {
+        munmap(base, size);
+        return result;
+    }
+
+    return chip8_shm_bind(base, size, writable, shm);
+}
+
+i32 chip8_shm_open(const char *name, const ui32 num_channels, const ui32 num_slots, Chip8Shm **shm)
+{
+    if(num_channels == 0 || num_channels > C8_SHM_MAX_CHANNELS || num_slots == 0 || num_slots > C8_SHM_MAX_SLOTS)
+        return C8_SHM_BAD_SIZE;
+
+    // Exactly one process creates the region, everyone else attaches to it
+    const int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if(fd < 0)
+        return errno == EEXIST ? chip8_shm_map(name, 1, shm) : C8_SHM_OPEN_FAILED;
+
+    const size_t size = chip8_shm_region_size(num_channels, num_slots);
+    void *base = MAP_FAILED;
+    if(ftruncate(fd, (off_t)size) == 0)
+        base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED)
+    {
+        shm_unlink(name);
+        return C8_SHM_MAP_FAILED;
+    }
+
+    // A fresh region is zeroed: no frames and every sequence even
+    Chip8ShmHeader *header = (Chip8ShmHeader*)base;
+    header->version = C8_SHM_VERSION;
+    header->num_channels = num_channels;
+    header->num_slots = num_slots;
+    header->slot_size = sizeof(Chip8ShmSlot);
+    C8_SHM_STORE_RELEASE(&header->magic, (ui32)C8_SHM_MAGIC);
+
+    return chip8_shm_bind(base, size, 1, shm);
+}
+
+i32 chip8_shm_attach(const char *name, Chip8Shm **shm)
+{
+    return chip8_shm_map(name, 0, shm);
+}
+
+void chip8_shm_detach(Chip8Shm *shm)
+{
+    if(shm == NULL)
+        return;
+
+    munmap(shm->base, shm->size);
+    free(shm);
+}
+
+i32 chip8_shm_unlink(const char *name)
+{
+    return shm_unlink(name) == 0 ? C8_SHM_OK : C8_SHM_OPEN_FAILED;
+}
+
+ui32 chip8_shm_num_channels(const Chip8Shm *shm)
+{
+    return shm->num_channels;
+}
+
+ui32 chip8_shm_num_slots(const Chip8Shm *shm)
+{
+    return shm->num_slots;
+}
+
+/*
+    Seqlock:
+    The publisher makes the sequence odd, writes the frame in place and
+    makes it even again. A reader copies the frame between two reads of
+    the sequence and keeps the copy only when both saw the same even
+    value, i.e. no write overlapped it.
+*/
+
+ui8 chip8_shm_publish(Chip8Shm *shm, const ui32 channel, const Chip8 *chip8)
+{
+    if(!shm->writable || channel >= shm->num_channels)
+        return 0;
+
+    // Only this publisher writes the counter, it needs no read-modify-write
+    Chip8ShmChannel *shm_channel = &shm->channels[channel];
+    const ui64 frame_index = C8_SHM_LOAD_RELAXED(&shm_channel->num_frames);
+    Chip8ShmSlot *slot = &shm->slots[(size_t)channel * shm->num_slots + frame_index % shm->num_slots];
+
+    const ui32 sequence = C8_SHM_LOAD_RELAXED(&slot->sequence);
+    C8_SHM_STORE_RELAXED(&slot->sequence, sequence + 1);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    Chip8ShmFrame *frame = &slot->frame;
+    frame->frame = frame_index;
+    frame->cycle_count = chip8->cycle_count;
+    frame->rom_hash = chip8->rom_hash;
+    memcpy(frame->registers, chip8->registers, sizeof(frame->registers));
+    frame->index_register = chip8->index_register;
+    frame->program_counter = chip8->program_counter;
+    frame->delay_timer = chip8->delay_timer;
+    frame->sound_timer = chip8->sound_timer;
+    frame->quirks = chip8->quirks;
+    frame->hires = chip8->hires;
+    frame->width = (ui16)chip8_screen_width(chip8);
+    frame->height = (ui16)chip8_screen_height(chip8);
+    chip8_screen_packed(chip8, frame->screen);
+
+    C8_SHM_STORE_RELEASE(&slot->sequence, sequence + 2);
+    C8_SHM_STORE_RELEASE(&shm_channel->num_frames, frame_index + 1);
+    return 1;
+}
+
+ui64 chip8_shm_num_frames(const Chip8Shm *shm, const ui32 channel)
+{
+    return channel < shm->num_channels ? C8_SHM_LOAD_ACQUIRE(&shm->channels[channel].num_frames) : 0;
+}
+
+static ui8 chip8_shm_read_slot(const Chip8ShmSlot *slot, Chip8ShmFrame *frame)
+{
+    for(ui32 attempt = 0; attempt < C8_SHM_READ_ATTEMPTS; ++attempt)
+    {
+        const ui32 sequence = C8_SHM_LOAD_ACQUIRE(&slot->sequence);
+        if(sequence & 1)
+            continue;
+
+        memcpy(frame, &slot->frame, sizeof(Chip8ShmFrame));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(C8_SHM_LOAD_RELAXED(&slot->sequence) == sequence)
+            return 1;
+    }
+    return 0;
+}
+
+ui8 chip8_shm_read_frame(const Chip8Shm *shm, const ui32 channel, const ui64 index, Chip8ShmFrame *frame)
+{
+    const ui64 num_frames = chip8_shm_num_frames(shm, channel);
+    if(index >= num_frames || num_frames - index > shm->num_slots)
+        return 0;
+
+    // The slot may hold a newer frame by the time it is read
+    const Chip8ShmSlot *slot = &shm->slots[(size_t)channel * shm->num_slots + index % shm->num_slots];
+    return chip8_shm_read_slot(slot, frame) && frame->frame == index;
+}
+
+ui8 chip8_shm_read(const Chip8Shm *shm, const ui32 channel, Chip8ShmFrame *frame)
+{
+    for(ui32 attempt = 0; attempt < C8_SHM_READ_ATTEMPTS; ++attempt)
+    {
+        const ui64 num_frames = chip8_shm_num_frames(shm, channel);
+        if(num_frames == 0)
+            return 0;
+        if(chip8_shm_read_frame(shm, channel, num_frames - 1, frame))
+            return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "chip8.h"
+
+/*
+    Shared-memory frame export:
+    Publishes frames into a POSIX shared-memory region that any number of
+    local processes map. The region holds `num_channels` channels, one per
+    publishing instance, and every channel is a ring of the last
+    `num_slots` frames its instance published. A frame is the packed screen
+    in its current resolution, the registers and the frame counter of the
+    channel.
+
+    Every slot is guarded by its own seqlock. Publishers never wait for
+    readers and readers never block publishers, a reader that raced a
+    publisher simply retries. Neither side makes a syscall per frame, a
+    read is one copy of the slot out of the mapping.
+
+    A channel must have a single publisher at a time, channels of one
+    region can be published from as many threads and processes as there
+    are channels. The region outlives its processes until it is unlinked.
+    Not available on Windows.
+*/
+
+enum
+{
+    C8_SHM_OK = 0,
+    C8_SHM_OPEN_FAILED,
+    C8_SHM_MAP_FAILED,
+    C8_SHM_BAD_HEADER,
+    // The region exists but its creator has not finished setting it up yet, try again
+    C8_SHM_NOT_READY,
+    C8_SHM_OUT_OF_MEMORY,
+    C8_SHM_BAD_SIZE,
+};
+
+enum
+{
+    C8_SHM_DEFAULT_CHANNELS = 256,
+    C8_SHM_DEFAULT_SLOTS = 4,
+};
+
+typedef struct Chip8ShmFrame
+{
+    // Position of the frame on its channel, counting from 0
+    ui64 frame;
+    ui64 cycle_count;
+    ui64 rom_hash;
+    ui8 registers[C8_NUM_REGISTERS];
+    ui16 index_register;
+    ui16 program_counter;
+    ui8 delay_timer;
+    ui8 sound_timer;
+    ui8 quirks;
+    ui8 hires;
+    ui16 width;
+    ui16 height;
+    // One bit per pixel row by row, `width * height / 8` bytes are used
+    ui8 screen[C8_HIRES_SCREEN_SIZE];
+} Chip8ShmFrame;
+
+typedef struct Chip8Shm Chip8Shm;
+
+// Attaches to the region `name`, creating it with the given size when it does not exist yet
+i32 chip8_shm_open(const char *name, const ui32 num_channels, const ui32 num_slots, Chip8Shm **shm);
+// Attaches read-only to an existing region
+i32 chip8_shm_attach(const char *name, Chip8Shm **shm);
+// Unmaps the region, it stays around for other processes
+void chip8_shm_detach(Chip8Shm *shm);
+i32 chip8_shm_unlink(const char *name);
+
+ui32 chip8_shm_num_channels(const Chip8Shm *shm);
+ui32 chip8_shm_num_slots(const Chip8Shm *shm);
+
+// Writes the current state of `chip8` as the next frame of `channel`, returns 0 for a read-only region or a channel out of range
+ui8 chip8_shm_publish(Chip8Shm *shm, const ui32 channel, const Chip8 *chip8);
+// Frames published on `channel` so far, without touching any slot
+ui64 chip8_shm_num_frames(const Chip8Shm *shm, const ui32 channel);
+// Copies the newest frame of `channel`, returns 0 when it has none yet or the publisher kept overwriting it
+ui8 chip8_shm_read(const Chip8Shm *shm, const ui32 channel, Chip8ShmFrame *frame);
+// Copies frame `index` of `channel`, returns 0 when it was not published yet or already overwritten
+ui8 chip8_shm_read_frame(const Chip8Shm *shm, const ui32 channel, const ui64 index, Chip8ShmFrame *frame);
@@ -0,0 +1,392 @@
+#include "chip8_snapshot.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+enum
+{
+    // "C8D4" read as a little-endian word
+    C8_DELTA_MAGIC = 0x34443843,
+    C8_DELTA_HEADER_SIZE = sizeof(ui32) + sizeof(ui64) + C8_SCREEN_WORDS / 8 + sizeof(Chip8SnapshotCpu),
+};
+
+_Static_assert(C8_DELTA_HEADER_SIZE <= 256, "C8_SNAPSHOT_MAX_DELTA_SIZE leaves 256 bytes for the delta header");
+
+static void chip8_snapshot_store_cpu(const Chip8 *chip8, Chip8SnapshotCpu *cpu)
+{
+    // Padding is part of every delta, keep it deterministic
+    memset(cpu, 0, sizeof(Chip8SnapshotCpu));
+    memcpy(cpu->registers, chip8->registers, sizeof(cpu->registers));
+    cpu->opcode = chip8->opcode;
+    cpu->index_register = chip8->index_register;
+    cpu->program_counter = chip8->program_counter;
+    cpu->dirty_rows = chip8->dirty_rows;
+    cpu->hires = chip8->hires;
+    cpu->delay_timer = chip8->delay_timer;
+    cpu->sound_timer = chip8->sound_timer;
+    memcpy(cpu->stack_levels, chip8->stack_levels, sizeof(cpu->stack_levels));
+    cpu->stack_pointer = chip8->stack_pointer;
+    memcpy(cpu->keys, chip8->keys, sizeof(cpu->keys));
+    memcpy(cpu->flag_registers, chip8->flag_registers, sizeof(cpu->flag_registers));
+    cpu->random_state = chip8->random_state;
+    cpu->cycle_count = chip8->cycle_count;
+    cpu->cycles_per_frame = chip8->cycles_per_frame;
+    cpu->frame_cycles = chip8->frame_cycles;
+    cpu->idle_cycles_skipped = chip8->idle_cycles_skipped;
+    cpu->rom_hash = chip8->rom_hash;
+    cpu->quirks = chip8->quirks;
+    cpu->num_faults = chip8->num_faults;
+    cpu->fault_opcode = chip8->fault_opcode;
+}
+
+static void chip8_snapshot_load_cpu(Chip8 *chip8, const Chip8SnapshotCpu *cpu)
+{
+    memcpy(chip8->registers, cpu->registers, sizeof(chip8->registers));
+    chip8->opcode = cpu->opcode;
+    chip8->index_register = cpu->index_register;
+    chip8->program_counter = cpu->program_counter;
+    chip8->dirty_rows = cpu->dirty_rows;
+    chip8->hires = cpu->hires;
+    chip8->delay_timer = cpu->delay_timer;
+    chip8->sound_timer = cpu->sound_timer;
+    memcpy(chip8->stack_levels, cpu->stack_levels, sizeof(chip8->stack_levels));
+    chip8->stack_pointer = cpu->stack_pointer;
+    memcpy(chip8->keys, cpu->keys, sizeof(chip8->keys));
+    memcpy(chip8->flag_registers, cpu->flag_registers, sizeof(chip8->flag_registers));
+    chip8->random_state = cpu->random_state;
+    chip8->cycle_count = cpu->cycle_count;
+    chip8->cycles_per_frame = cpu->cycles_per_frame;
+    chip8->frame_cycles = cpu->frame_cycles;
+    chip8->idle_cycles_skipped = cpu->idle_cycles_skipped;
+    chip8->rom_hash = cpu->rom_hash;
+    chip8_set_quirks(chip8, cpu->quirks);
+    chip8->num_faults = cpu->num_faults;
+    chip8->fault_opcode = cpu->fault_opcode;
+}
+
+// Copies one memory page, dropping decoded instructions only when its contents change
+static void chip8_snapshot_load_page(Chip8 *chip8, const ui16 page, const ui8 *data)
+{
+    ui8 *memory = &chip8->memory[page * C8_SNAPSHOT_PAGE_SIZE];
+    if(memcmp(memory, data, C8_SNAPSHOT_PAGE_SIZE) == 0)
+        return;
+
+    memcpy(memory, data, C8_SNAPSHOT_PAGE_SIZE);
+    chip8_invalidate_instructions(chip8, (ui16)(page * C8_SNAPSHOT_PAGE_SIZE), C8_SNAPSHOT_PAGE_SIZE);
+}
+
+// Copies the screen before the cpu state, returns the bands that changed, all of them when the resolution does
+static ui32 chip8_snapshot_load_screen(Chip8 *chip8, const ui64 *screen_memory, const ui8 hires)
+{
+    ui32 changed_bands = 0;
+    if(chip8->hires != hires)
+        changed_bands = 0xFFFFFFFF;
+    else
+    {
+        // A band is one lo-res row or the four words of two hi-res rows
+        const ui32 num_words = hires ? C8_SCREEN_WORDS : C8_SCREEN_HEIGHT;
+        const ui32 words_per_band = hires ? 4 : 1;
+        for(ui32 word = 0; word < num_words; ++word)
+            changed_bands |= (ui32)(chip8->screen_memory[word] != screen_memory[word]) << (word / words_per_band);
+    }
+
+    memcpy(chip8->screen_memory, screen_memory, sizeof(chip8->screen_memory));
+    return changed_bands;
+}
+
+void chip8_snapshot(const Chip8 *chip8, Chip8Snapshot *snapshot)
+{
+    memcpy(snapshot->memory, chip8->memory, sizeof(snapshot->memory));
+    memcpy(snapshot->screen_memory, chip8->screen_memory, sizeof(snapshot->screen_memory));
+    chip8_snapshot_store_cpu(chip8, &snapshot->cpu);
+}
+
+void chip8_restore(Chip8 *chip8, const Chip8Snapshot *snapshot)
+{
+    for(ui16 page = 0; page < C8_SNAPSHOT_NUM_PAGES; ++page)
+        chip8_snapshot_load_page(chip8, page, &snapshot->memory[page * C8_SNAPSHOT_PAGE_SIZE]);
+
+    const ui32 changed_bands = chip8_snapshot_load_screen(chip8, snapshot->screen_memory, snapshot->cpu.hires);
+    chip8_snapshot_load_cpu(chip8, &snapshot->cpu);
+    chip8->dirty_rows |= changed_bands;
+}
+
+/*
+    Delta layout:
+    magic, page mask, two word masks, cpu state, then every page with its
+    bit set in the page mask followed by every screen word with its bit set
+    in the word masks, both in ascending order.
+*/
+
+ui32 chip8_delta_encode(const Chip8Snapshot *base, const Chip8 *chip8, ui8 *delta, const ui32 capacity)
+{
+    ui64 page_mask = 0;
+    ui32 size = C8_DELTA_HEADER_SIZE;
+    for(ui16 page = 0; page < C8_SNAPSHOT_NUM_PAGES; ++page)
+    {
+        const ui16 offset = page * C8_SNAPSHOT_PAGE_SIZE;
+        if(memcmp(&chip8->memory[offset], &base->memory[offset], C8_SNAPSHOT_PAGE_SIZE) != 0)
+        {
+            page_mask |= 1ULL << page;
+            size += C8_SNAPSHOT_PAGE_SIZE;
+        }
+    }
+
+    ui64 word_mask[C8_SCREEN_WORDS / 64] = { 0 };
+    for(ui32 word = 0; word < C8_SCREEN_WORDS; ++word)
+    {
+        if(chip8->screen_memory[word] != base->screen_memory[word])
+        {
+            word_mask[word / 64] |= 1ULL << (word % 64);
+            size += sizeof(ui64);
+        }
+    }
+
+    if(size > capacity)
+        return 0;
+
+    const ui32 magic = C8_DELTA_MAGIC;
+    Chip8SnapshotCpu cpu;
+    chip8_snapshot_store_cpu(chip8, &cpu);
+
+    ui8 *cursor = delta;
+    memcpy(cursor, &magic, sizeof(magic));
+    cursor += sizeof(magic);
+    memcpy(cursor, &page_mask, sizeof(page_mask));
+    cursor += sizeof(page_mask);
+    memcpy(cursor, word_mask, sizeof(word_mask));
+    cursor += sizeof(word_mask);
+    memcpy(cursor, &cpu, sizeof(cpu));
+    cursor += sizeof(cpu);
+
+    for(ui16 page = 0; page < C8_SNAPSHOT_NUM_PAGES; ++page)
+    {
+        if(page_mask & (1ULL << page))
+        {
+            memcpy(cursor, &chip8->memory[page * C8_SNAPSHOT_PAGE_SIZE], C8_SNAPSHOT_PAGE_SIZE);
+            cursor += C8_SNAPSHOT_PAGE_SIZE;
+        }
+    }
+
+    for(ui32 word = 0; word < C8_SCREEN_WORDS; ++word)
+    {
+        if(word_mask[word / 64] & (1ULL << (word % 64)))
+        {
+            memcpy(cursor, &chip8->screen_memory[word], sizeof(ui64));
+            cursor += sizeof(ui64);
+        }
+    }
+
+    return size;
+}
+
+static ui32 chip8_count_bits(ui64 mask)
+{
+    ui32 count = 0;
+    for(; mask != 0; mask &= mask - 1)
+        ++count;
+    return count;
+}
+
+ui8 chip8_delta_restore(Chip8 *chip8, const Chip8Snapshot *base, const ui8 *delta, const ui32 size)
+{
+    if(size < C8_DELTA_HEADER_SIZE)
+        return 0;
+
+    ui32 magic = 0;
+    ui64 page_mask = 0;
+    ui64 word_mask[C8_SCREEN_WORDS / 64];
+    Chip8SnapshotCpu cpu;
+
+    const ui8 *cursor = delta;
+    memcpy(&magic, cursor, sizeof(magic));
+    cursor += sizeof(magic);
+    memcpy(&page_mask, cursor, sizeof(page_mask));
+    cursor += sizeof(page_mask);
+    memcpy(word_mask, cursor, sizeof(word_mask));
+    cursor += sizeof(word_mask);
+    memcpy(&cpu, cursor, sizeof(cpu));
+    cursor += sizeof(cpu);
+
+    const ui32 expected_size = C8_DELTA_HEADER_SIZE + chip8_count_bits(page_mask) * C8_SNAPSHOT_PAGE_SIZE + (chip8_count_bits(word_mask[0]) + chip8_count_bits(word_mask[1])) * (ui32)sizeof(ui64);
+    if(magic != C8_DELTA_MAGIC || size != expected_size)
+        return 0;
+
+    for(ui16 page = 0; page < C8_SNAPSHOT_NUM_PAGES; ++page)
+    {
+        const ui8 *data = &base->memory[page * C8_SNAPSHOT_PAGE_SIZE];
+        if(page_mask & (1ULL << page))
+        {
+            data = cursor;
+            cursor += C8_SNAPSHOT_PAGE_SIZE;
+        }
+        chip8_snapshot_load_page(chip8, page, data);
+    }
+
+    ui64 screen_memory[C8_SCREEN_WORDS];
+    for(ui32 word = 0; word < C8_SCREEN_WORDS; ++word)
+    {
+        screen_memory[word] = base->screen_memory[word];
+        if(word_mask[word / 64] & (1ULL << (word % 64)))
+        {
+            memcpy(&screen_memory[word], cursor, sizeof(ui64));
+            cursor += sizeof(ui64);
+        }
+    }
+
+    const ui32 changed_bands = chip8_snapshot_load_screen(chip8, screen_memory, cpu.hires);
+    chip8_snapshot_load_cpu(chip8, &cpu);
+    chip8->dirty_rows |= changed_bands;
+    return 1;
+}
+
+typedef struct Chip8RewindEntry
+{
+    ui8 *delta;
+    ui32 delta_size;
+    ui32 delta_capacity;
+    ui8 is_keyframe;
+} Chip8RewindEntry;
+
+struct Chip8Rewind
+{
+    // Ring of states, the oldest one is always a keyframe
+    Chip8RewindEntry *entries;
+    ui32 num_states;
+    ui32 first_entry;
+    ui32 num_entries;
+
+    // Ring of keyframes, one per group of entries
+    Chip8Snapshot *keyframes;
+    ui32 num_keyframe_slots;
+    ui32 first_keyframe;
+    ui32 num_keyframes;
+
+    ui32 keyframe_interval;
+    // Entries in the newest group, its keyframe included
+    ui32 newest_group_size;
+
+    ui8 scratch[C8_SNAPSHOT_MAX_DELTA_SIZE];
+};
+
+Chip8Rewind *chip8_rewind_create(const ui32 num_states, const ui32 keyframe_interval)
+{
+    if(num_states == 0 || keyframe_interval == 0)
+        return NULL;
+
+    Chip8Rewind *rewind = calloc(1, sizeof(Chip8Rewind));
+    if(rewind == NULL)
+        return NULL;
+
+    rewind->num_states = num_states;
+    rewind->keyframe_interval = keyframe_interval;
+    rewind->num_keyframe_slots = num_states / keyframe_interval + 2;
+    rewind->entries = calloc(num_states, sizeof(Chip8RewindEntry));
+    rewind->keyframes = malloc(rewind->num_keyframe_slots * sizeof(Chip8Snapshot));
+    if(rewind->entries == NULL || rewind->keyframes == NULL)
+    {
+        chip8_rewind_destroy(rewind);
+        return NULL;
+    }
+
+    return rewind;
+}
+
+void chip8_rewind_destroy(Chip8Rewind *rewind)
+{
+    if(rewind == NULL)
+        return;
+
+    for(ui32 i = 0; rewind->entries != NULL && i < rewind->num_states; ++i)
+        free(rewind->entries[i].delta);
+    free(rewind->entries);
+    free(rewind->keyframes);
+    free(rewind);
+}
+
+static void chip8_rewind_drop_oldest_group(Chip8Rewind *rewind)
+{
+    do
+    {
+        rewind->first_entry = (rewind->first_entry + 1) % rewind->num_states;
+        --rewind->num_entries;
+    }
+    while(rewind->num_entries > 0 && !rewind->entries[rewind->first_entry].is_keyframe);
+
+    rewind->first_keyframe = (rewind->first_keyframe + 1) % rewind->num_keyframe_slots;
+    --rewind->num_keyframes;
+    if(rewind->num_entries == 0)
+        rewind->newest_group_size = 0;
+}
+
+static Chip8Snapshot *chip8_rewind_newest_keyframe(Chip8Rewind *rewind)
+{
+    return &rewind->keyframes[(rewind->first_keyframe + rewind->num_keyframes - 1) % rewind->num_keyframe_slots];
+}
+
+ui8 chip8_rewind_push(Chip8Rewind *rewind, const Chip8 *chip8)
+{
+    if(rewind->num_entries == rewind->num_states)
+        chip8_rewind_drop_oldest_group(rewind);
+
+    const ui8 is_keyframe = rewind->num_entries == 0 || rewind->newest_group_size >= rewind->keyframe_interval;
+    if(is_keyframe && rewind->num_keyframes == rewind->num_keyframe_slots)
+        chip8_rewind_drop_oldest_group(rewind);
+
+    Chip8RewindEntry *entry = &rewind->entries[(rewind->first_entry + rewind->num_entries) % rewind->num_states];
+    if(is_keyframe)
+    {
+        ++rewind->num_keyframes;
+        chip8_snapshot(chip8, chip8_rewind_newest_keyframe(rewind));
+        rewind->newest_group_size = 0;
+    }
+    else
+    {
+        const ui32 delta_size = chip8_delta_encode(chip8_rewind_newest_keyframe(rewind), chip8, rewind->scratch, sizeof(rewind->scratch));
+        if(delta_size > entry->delta_capacity)
+        {
+            ui8 *delta = realloc(entry->delta, delta_size);
+            if(delta == NULL)
+                return 0;
+            entry->delta = delta;
+            entry->delta_capacity = delta_size;
+        }
+        memcpy(entry->delta, rewind->scratch, delta_size);
+        entry->delta_size = delta_size;
+    }
+
+    entry->is_keyframe = is_keyframe;
+    ++rewind->num_entries;
+    ++rewind->newest_group_size;
+    return 1;
+}
+
+ui8 chip8_rewind_pop(Chip8Rewind *rewind, Chip8 *chip8)
+{
+    if(rewind->num_entries == 0)
+        return 0;
+
+    // The state is only dropped once it was restored
+    const Chip8RewindEntry *entry = &rewind->entries[(rewind->first_entry + rewind->num_entries - 1) % rewind->num_states];
+    Chip8Snapshot *keyframe = chip8_rewind_newest_keyframe(rewind);
+    if(!entry->is_keyframe)
+    {
+        if(!chip8_delta_restore(chip8, keyframe, entry->delta, entry->delta_size))
+            return 0;
+        --rewind->num_entries;
+        --rewind->newest_group_size;
+        return 1;
+    }
+
+    chip8_restore(chip8, keyframe);
+    --rewind->num_entries;
+    --rewind->num_keyframes;
+    // Only the newest group can be shorter than the interval
+    rewind->newest_group_size = rewind->num_entries > 0 ? rewind->keyframe_interval : 0;
+    return 1;
+}
+
+ui32 chip8_rewind_count(const Chip8Rewind *rewind)
+{
+    return rewind->num_entries;
+}
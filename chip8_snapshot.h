@@ -0,0 +1,86 @@
+#pragma once
+
+#include "chip8.h"
+
+/*
+    Snapshots and deltas:
+    A snapshot holds the machine state of an instance without its decode
+    cache. Restoring compares memory page by page and only invalidates
+    decoded instructions on pages that actually differ, so rewinding or
+    forking an instance keeps most of its decoded code.
+
+    A delta records the registers plus only the memory pages and screen
+    words that differ from a base snapshot, which makes forks that touch a
+    few bytes a few hundred bytes large. Deltas use the host byte order and
+    are meant to be read back by the same build.
+*/
+
+enum
+{
+    C8_SNAPSHOT_PAGE_SIZE = 64,
+    C8_SNAPSHOT_NUM_PAGES = C8_MEMORY_SIZE / C8_SNAPSHOT_PAGE_SIZE,
+    // Upper bound for `chip8_delta_encode`, reached when every page and screen word changed
+    C8_SNAPSHOT_MAX_DELTA_SIZE = 256 + C8_MEMORY_SIZE + C8_SCREEN_WORDS * sizeof(ui64),
+};
+
+// Everything but memory and screen, stored whole in every delta
+typedef struct Chip8SnapshotCpu
+{
+    ui8 registers[C8_NUM_REGISTERS];
+    ui16 opcode;
+    ui16 index_register;
+    ui16 program_counter;
+    ui32 dirty_rows;
+    ui8 hires;
+    ui8 delay_timer;
+    ui8 sound_timer;
+    ui16 stack_levels[C8_NUM_STACK_LEVELS];
+    ui16 stack_pointer;
+    ui8 keys[C8_NUM_KEYS];
+    ui8 flag_registers[C8_NUM_REGISTERS];
+    ui64 random_state;
+    ui64 cycle_count;
+    ui32 cycles_per_frame;
+    ui32 frame_cycles;
+    ui64 idle_cycles_skipped;
+    ui64 rom_hash;
+    // Applied through `chip8_set_quirks`, which keeps the decode cache when the profile stays the same
+    ui8 quirks;
+    ui32 num_faults;
+    ui16 fault_opcode;
+} Chip8SnapshotCpu;
+
+typedef struct Chip8Snapshot
+{
+    ui8 memory[C8_MEMORY_SIZE];
+    ui64 screen_memory[C8_SCREEN_WORDS];
+    Chip8SnapshotCpu cpu;
+} Chip8Snapshot;
+
+void chip8_snapshot(const Chip8 *chip8, Chip8Snapshot *snapshot);
+// Screen bands that differ from the current screen are marked dirty on top of the saved dirty bands
+void chip8_restore(Chip8 *chip8, const Chip8Snapshot *snapshot);
+
+// Returns the size written to `delta`, or 0 when `capacity` is too small
+ui32 chip8_delta_encode(const Chip8Snapshot *base, const Chip8 *chip8, ui8 *delta, const ui32 capacity);
+// Restores `base` with `delta` applied, returns 0 and leaves the instance untouched when `delta` is malformed
+ui8 chip8_delta_restore(Chip8 *chip8, const Chip8Snapshot *base, const ui8 *delta, const ui32 size);
+
+/*
+    Rewind ring:
+    Keeps the last `num_states` pushed states. Every `keyframe_interval`
+    states one is stored as a full snapshot and the ones after it as deltas
+    against it. Once full, the oldest keyframe is dropped together with its
+    deltas.
+*/
+
+typedef struct Chip8Rewind Chip8Rewind;
+
+Chip8Rewind *chip8_rewind_create(const ui32 num_states, const ui32 keyframe_interval);
+void chip8_rewind_destroy(Chip8Rewind *rewind);
+
+// Returns 0 when out of memory
+ui8 chip8_rewind_push(Chip8Rewind *rewind, const Chip8 *chip8);
+// Restores the newest state and drops it, returns 0 and keeps the state when the ring is empty or it cannot be restored
+ui8 chip8_rewind_pop(Chip8Rewind *rewind, Chip8 *chip8);
+ui32 chip8_rewind_count(const Chip8Rewind *rewind);
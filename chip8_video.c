@@ -0,0 +1,732 @@
+#include "chip8_video.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+enum
+{
+    C8_VIDEO_VERSION = 2,
+    C8_VIDEO_HEADER_SIZE = 24,
+    C8_VIDEO_KEYFRAME = 0x01,
+    C8_VIDEO_DELTA = 0x02,
+    C8_VIDEO_END = 0xFF,
+    C8_VIDEO_ROW_MASK_SIZE = 8,
+    // Resolution and row mask, then every hi-res row with both byte masks and all sixteen bytes
+    C8_VIDEO_MAX_PAYLOAD_SIZE = 1 + C8_VIDEO_ROW_MASK_SIZE + C8_HIRES_SCREEN_HEIGHT * (2 + C8_HIRES_SCREEN_WIDTH_SIZE),
+    // Type, two LEB128 fields and the payload
+    C8_VIDEO_MAX_RECORD_SIZE = 1 + 10 + 10 + C8_VIDEO_MAX_PAYLOAD_SIZE,
+    // Records are a few bytes each, batching them keeps stdio out of the draw path
+    C8_VIDEO_WRITE_BUFFER_SIZE = 64 * 1024,
+};
+
+static const ui8 chip8_video_magic[4] = { 'C', '8', 'V', 'D' };
+
+struct Chip8VideoRecorder
+{
+    FILE *file;
+    ui64 start_cycle;
+    // Relative instruction count of the last record
+    ui64 last_cycle;
+    // Last frame, in the layout of `Chip8.screen_memory`
+    ui64 words[C8_SCREEN_WORDS];
+    ui8 hires;
+    // Frames until the next keyframe, zero means the next one is
+    ui32 frames_to_keyframe;
+    ui64 size;
+    ui32 keyframe_interval;
+    ui8 failed;
+
+    ui32 buffer_size;
+    ui8 buffer[C8_VIDEO_WRITE_BUFFER_SIZE];
+};
+
+struct Chip8VideoPlayer
+{
+    FILE *file;
+    Chip8VideoHeader header;
+
+    // Last decoded frame, in the layout of `Chip8.screen_memory`
+    ui64 words[C8_SCREEN_WORDS];
+    ui8 hires;
+    // Instructions since the start of the recording at the last record read
+    ui64 cycle;
+    // Index of the next frame
+    ui64 frame_index;
+    ui8 finished;
+};
+
+static void chip8_video_store(ui8 *bytes, ui64 value, const ui8 size)
+{
+    for(ui8 i = 0; i < size; ++i, value >>= 8)
+        bytes[i] = (ui8)value;
+}
+
+static ui64 chip8_video_load(const ui8 *bytes, const ui8 size)
+{
+    ui64 value = 0;
+    for(ui8 i = size; i > 0; --i)
+        value = value << 8 | bytes[i - 1];
+    return value;
+}
+
+static ui32 chip8_video_store_leb128(ui8 *bytes, ui64 value)
+{
+    ui32 size = 0;
+    do
+    {
+        bytes[size] = value & 0x7F;
+        value >>= 7;
+        bytes[size++] |= value != 0 ? 0x80 : 0;
+    }
+    while(value != 0);
+    return size;
+}
+
+// Rows of a frame and words per row, lo-res rows are one word and hi-res rows two
+static ui32 chip8_video_num_rows(const ui8 hires)
+{
+    return hires ? C8_HIRES_SCREEN_HEIGHT : C8_SCREEN_HEIGHT;
+}
+
+static ui32 chip8_video_row_words(const ui8 hires)
+{
+    return hires ? 2 : 1;
+}
+
+/*
+    Zero suppression:
+    The resolution, a mask of the nonzero rows, then for each of them and
+    each of its words a mask of the word's nonzero bytes followed by those
+    bytes. Every byte is stored and the size only advances past the
+    nonzero ones, which keeps the encoder free of data dependent branches
+    apart from skipping empty rows.
+*/
+static ui32 chip8_video_encode(const ui64 *words, const ui8 hires, ui8 *payload)
+{
+    const ui32 row_words = chip8_video_row_words(hires);
+    ui64 row_mask = 0;
+    ui32 size = 1 + C8_VIDEO_ROW_MASK_SIZE;
+    for(ui32 row = 0; row < chip8_video_num_rows(hires); ++row)
+    {
+        const ui64 *row_start = &words[row * row_words];
+        if((row_start[0] | row_start[row_words - 1]) == 0)
+            continue;
+
+        row_mask |= 1ULL << row;
+        for(ui32 word = 0; word < row_words; ++word)
+        {
+            const ui64 value = row_start[word];
+            ui8 *byte_mask = &payload[size++];
+            *byte_mask = 0;
+            for(ui32 byte = 0; byte < 8; ++byte)
+            {
+                const ui8 bits = (ui8)(value >> ((7 - byte) * 8));
+                payload[size] = bits;
+                size += bits != 0;
+                *byte_mask |= (ui8)((bits != 0) << byte);
+            }
+        }
+    }
+    payload[0] = hires;
+    chip8_video_store(&payload[1], row_mask, C8_VIDEO_ROW_MASK_SIZE);
+    return size;
+}
+
+// XORs the payload onto `words`, which start over blank when the resolution changes, returns 0 unless it is well formed
+static ui8 chip8_video_decode(const ui8 *payload, const ui32 size, ui64 *words, ui8 *hires)
+{
+    if(size < 1 + C8_VIDEO_ROW_MASK_SIZE || payload[0] > 1)
+        return 0;
+
+    if(payload[0] != *hires)
+    {
+        memset(words, 0, C8_SCREEN_WORDS * sizeof(ui64));
+        *hires = payload[0];
+    }
+
+    const ui32 row_words = chip8_video_row_words(*hires);
+    const ui64 row_mask = chip8_video_load(&payload[1], C8_VIDEO_ROW_MASK_SIZE);
+    if(chip8_video_num_rows(*hires) < 64 && (row_mask >> chip8_video_num_rows(*hires)) != 0)
+        return 0;
+
+    ui32 position = 1 + C8_VIDEO_ROW_MASK_SIZE;
+    for(ui32 row = 0; row < chip8_video_num_rows(*hires); ++row)
+    {
+        if(!(row_mask & (1ULL << row)))
+            continue;
+
+        for(ui32 word = 0; word < row_words; ++word)
+        {
+            if(position == size)
+                return 0;
+
+            const ui8 byte_mask = payload[position++];
+            ui64 value = 0;
+            for(ui32 byte = 0; byte < 8; ++byte)
+            {
+                if(!(byte_mask & (1u << byte)))
+                    continue;
+                if(position == size)
+                    return 0;
+                value |= (ui64)payload[position++] << ((7 - byte) * 8);
+            }
+            words[row * row_words + word] ^= value;
+        }
+    }
+    return position == size;
+}
+
+static void chip8_video_flush(Chip8VideoRecorder *recorder)
+{
+    if(recorder->buffer_size != 0 && fwrite(recorder->buffer, 1, recorder->buffer_size, recorder->file) != recorder->buffer_size)
+        recorder->failed = 1;
+    recorder->buffer_size = 0;
+}
+
+static void chip8_video_write_record(Chip8VideoRecorder *recorder, const ui8 type, const ui64 cycle, const ui8 *payload, const ui32 payload_size)
+{
+    if(recorder->buffer_size + C8_VIDEO_MAX_RECORD_SIZE > C8_VIDEO_WRITE_BUFFER_SIZE)
+        chip8_video_flush(recorder);
+
+    ui8 *record = &recorder->buffer[recorder->buffer_size];
+    ui32 size = 0;
+    record[size++] = type;
+    size += chip8_video_store_leb128(&record[size], cycle - recorder->last_cycle);
+    if(type != C8_VIDEO_END)
+    {
+        size += chip8_video_store_leb128(&record[size], payload_size);
+        memcpy(&record[size], payload, payload_size);
+        size += payload_size;
+    }
+
+    recorder->last_cycle = cycle;
+    recorder->size += size;
+    recorder->buffer_size += size;
+}
+
+i32 chip8_video_record(const char *video_file_path, const Chip8 *chip8, const ui32 keyframe_interval, Chip8VideoRecorder **recorder)
+{
+    Chip8VideoRecorder *new_recorder = calloc(1, sizeof(Chip8VideoRecorder));
+    if(new_recorder == NULL)
+        return C8_VIDEO_OUT_OF_MEMORY;
+
+    new_recorder->file = fopen(video_file_path, "wb");
+    if(new_recorder->file == NULL)
+    {
+        free(new_recorder);
+        return C8_VIDEO_OPEN_FAILED;
+    }
+
+    new_recorder->keyframe_interval = keyframe_interval != 0 ? keyframe_interval : C8_VIDEO_DEFAULT_KEYFRAME_INTERVAL;
+    if(new_recorder->keyframe_interval > 0xFFFF)
+        new_recorder->keyframe_interval = 0xFFFF;
+
+    ui8 header[C8_VIDEO_HEADER_SIZE] = {0};
+    memcpy(header, chip8_video_magic, sizeof(chip8_video_magic));
+    chip8_video_store(&header[4], C8_VIDEO_VERSION, 2);
+    chip8_video_store(&header[6], new_recorder->keyframe_interval, 2);
+    chip8_video_store(&header[8], chip8->cycles_per_frame, 4);
+    chip8_video_store(&header[12], chip8->frame_cycles, 4);
+    chip8_video_store(&header[16], chip8->rom_hash, 8);
+    if(fwrite(header, 1, sizeof(header), new_recorder->file) != sizeof(header))
+    {
+        fclose(new_recorder->file);
+        free(new_recorder);
+        return C8_VIDEO_WRITE_FAILED;
+    }
+
+    new_recorder->start_cycle = chip8->cycle_count;
+    new_recorder->size = sizeof(header);
+    *recorder = new_recorder;
+    return C8_VIDEO_OK;
+}
+
+void chip8_video_record_frame(Chip8VideoRecorder *recorder, const Chip8 *chip8)
+{
+    const ui8 keyframe = recorder->frames_to_keyframe == 0;
+    recorder->frames_to_keyframe = keyframe ? recorder->keyframe_interval - 1 : recorder->frames_to_keyframe - 1;
+
+    // Switching resolution clears the screen, so such frames are stored against a blank one like keyframes
+    const ui8 hires = chip8->hires != 0;
+    const ui8 blank = keyframe || hires != recorder->hires;
+    const ui32 num_words = chip8_video_num_rows(hires) * chip8_video_row_words(hires);
+    ui64 words[C8_SCREEN_WORDS];
+    for(ui32 word = 0; word < num_words; ++word)
+    {
+        const ui64 screen_word = chip8->screen_memory[word];
+        words[word] = blank ? screen_word : screen_word ^ recorder->words[word];
+        recorder->words[word] = screen_word;
+    }
+    recorder->hires = hires;
+
+    ui8 payload[C8_VIDEO_MAX_PAYLOAD_SIZE];
+    const ui32 payload_size = chip8_video_encode(words, hires, payload);
+    chip8_video_write_record(recorder, keyframe ? C8_VIDEO_KEYFRAME : C8_VIDEO_DELTA, chip8->cycle_count - recorder->start_cycle, payload, payload_size);
+}
+
+ui64 chip8_video_record_size(const Chip8VideoRecorder *recorder)
+{
+    return recorder->size;
+}
+
+i32 chip8_video_record_finish(Chip8VideoRecorder *recorder, const Chip8 *chip8)
+{
+    chip8_video_write_record(recorder, C8_VIDEO_END, chip8->cycle_count - recorder->start_cycle, NULL, 0);
+    chip8_video_flush(recorder);
+    const ui8 failed = fclose(recorder->file) != 0 || recorder->failed;
+    free(recorder);
+    return failed ? C8_VIDEO_WRITE_FAILED : C8_VIDEO_OK;
+}
+
+static ui8 chip8_video_read_leb128(FILE *file, ui64 *value)
+{
+    *value = 0;
+    for(ui8 shift = 0; ; shift += 7)
+    {
+        const int byte = fgetc(file);
+        if(shift > 63 || byte == EOF)
+            return 0;
+        *value |= (ui64)(byte & 0x7F) << shift;
+        if((byte & 0x80) == 0)
+            return 1;
+    }
+}
+
+// Reads the type, instruction count and payload size of the next record, 0 when the file ends before them
+static ui8 chip8_video_read_record_header(Chip8VideoPlayer *player, ui8 *type, ui64 *cycle_delta, ui64 *payload_size)
+{
+    const int byte = fgetc(player->file);
+    if(byte == EOF)
+        return 0;
+
+    *type = (ui8)byte;
+    *payload_size = 0;
+    if(!chip8_video_read_leb128(player->file, cycle_delta))
+        return 0;
+    if(*type == C8_VIDEO_END)
+        return 1;
+    return chip8_video_read_leb128(player->file, payload_size)
+        && (*type == C8_VIDEO_KEYFRAME || *type == C8_VIDEO_DELTA)
+        && *payload_size <= C8_VIDEO_MAX_PAYLOAD_SIZE;
+}
+
+i32 chip8_video_play(const char *video_file_path, Chip8VideoPlayer **player)
+{
+    Chip8VideoPlayer *new_player = calloc(1, sizeof(Chip8VideoPlayer));
+    if(new_player == NULL)
+        return C8_VIDEO_OUT_OF_MEMORY;
+
+    new_player->file = fopen(video_file_path, "rb");
+    if(new_player->file == NULL)
+    {
+        free(new_player);
+        return C8_VIDEO_OPEN_FAILED;
+    }
+
+    ui8 header[C8_VIDEO_HEADER_SIZE];
+    const ui8 valid = fread(header, 1, sizeof(header), new_player->file) == sizeof(header)
+        && memcmp(header, chip8_video_magic, sizeof(chip8_video_magic)) == 0
+        && chip8_video_load(&header[4], 2) == C8_VIDEO_VERSION
+        && chip8_video_load(&header[6], 2) != 0
+        && chip8_video_load(&header[8], 4) != 0
+        && chip8_video_load(&header[12], 4) < chip8_video_load(&header[8], 4);
+    if(!valid)
+    {
+        chip8_video_play_close(new_player);
+        return C8_VIDEO_BAD_HEADER;
+    }
+
+    new_player->header.keyframe_interval = (ui32)chip8_video_load(&header[6], 2);
+    new_player->header.cycles_per_frame = (ui32)chip8_video_load(&header[8], 4);
+    new_player->header.frame_cycles = (ui32)chip8_video_load(&header[12], 4);
+    new_player->header.rom_hash = chip8_video_load(&header[16], 8);
+
+    *player = new_player;
+    return C8_VIDEO_OK;
+}
+
+const Chip8VideoHeader *chip8_video_header(const Chip8VideoPlayer *player)
+{
+    return &player->header;
+}
+
+// A truncated or damaged recording simply ends at its last complete frame
+ui8 chip8_video_read_frame(Chip8VideoPlayer *player, Chip8Frame *frame)
+{
+    if(player->finished)
+        return 0;
+
+    ui8 type = 0;
+    ui64 cycle_delta = 0, payload_size = 0;
+    ui8 payload[C8_VIDEO_MAX_PAYLOAD_SIZE];
+    if(!chip8_video_read_record_header(player, &type, &cycle_delta, &payload_size)
+        || type == C8_VIDEO_END
+        || fread(payload, 1, (size_t)payload_size, player->file) != payload_size)
+    {
+        if(type == C8_VIDEO_END)
+            player->cycle += cycle_delta;
+        player->finished = 1;
+        return 0;
+    }
+
+    ui64 words[C8_SCREEN_WORDS];
+    ui8 hires = player->hires;
+    if(type == C8_VIDEO_KEYFRAME)
+        memset(words, 0, sizeof(words));
+    else
+        memcpy(words, player->words, sizeof(words));
+    if(!chip8_video_decode(payload, (ui32)payload_size, words, &hires))
+    {
+        player->finished = 1;
+        return 0;
+    }
+
+    memcpy(player->words, words, sizeof(words));
+    player->hires = hires;
+    player->cycle += cycle_delta;
+    if(frame != NULL)
+    {
+        memcpy(frame->rows, words, sizeof(words));
+        frame->hires = hires;
+        frame->cycle = player->cycle;
+        frame->sequence = player->frame_index;
+    }
+    ++player->frame_index;
+    return 1;
+}
+
+i32 chip8_video_seek(Chip8VideoPlayer *player, const ui64 frame_index)
+{
+    if(frame_index < player->frame_index)
+    {
+        if(fseek(player->file, C8_VIDEO_HEADER_SIZE, SEEK_SET) != 0)
+            return C8_VIDEO_SEEK_FAILED;
+        memset(player->words, 0, sizeof(player->words));
+        player->hires = 0;
+        player->cycle = 0;
+        player->frame_index = 0;
+        player->finished = 0;
+    }
+
+    // Skip records by their size up to the target, decoding resumes at the last keyframe passed or where the player stood
+    long resume_position = ftell(player->file);
+    ui64 resume_index = player->frame_index;
+    ui64 resume_cycle = player->cycle;
+    ui64 index = player->frame_index;
+    ui64 cycle = player->cycle;
+    while(index < frame_index && !player->finished)
+    {
+        const long position = ftell(player->file);
+        ui8 type = 0;
+        ui64 cycle_delta = 0, payload_size = 0;
+        if(!chip8_video_read_record_header(player, &type, &cycle_delta, &payload_size) || type == C8_VIDEO_END
+            || fseek(player->file, (long)payload_size, SEEK_CUR) != 0)
+        {
+            player->finished = 1;
+            return C8_VIDEO_SEEK_FAILED;
+        }
+
+        if(type == C8_VIDEO_KEYFRAME)
+        {
+            resume_position = position;
+            resume_index = index;
+            resume_cycle = cycle;
+        }
+        cycle += cycle_delta;
+        ++index;
+    }
+
+    if(player->finished || fseek(player->file, resume_position, SEEK_SET) != 0)
+        return C8_VIDEO_SEEK_FAILED;
+    player->frame_index = resume_index;
+    player->cycle = resume_cycle;
+    while(player->frame_index < frame_index)
+    {
+        if(!chip8_video_read_frame(player, NULL))
+            return C8_VIDEO_SEEK_FAILED;
+    }
+    return C8_VIDEO_OK;
+}
+
+void chip8_video_play_close(Chip8VideoPlayer *player)
+{
+    if(player == NULL)
+        return;
+
+    fclose(player->file);
+    free(player);
+}
+
+// Shows `frame` for `num_ticks` timer ticks
+typedef void (*Chip8VideoEmit)(void *context, const Chip8Frame *frame, const ui64 num_ticks);
+
+// Whether a record from the player's position on switches to hi-res, the player is left where it stood
+static ui8 chip8_video_has_hires(Chip8VideoPlayer *player)
+{
+    if(player->hires)
+        return 1;
+
+    const long position = ftell(player->file);
+    if(position < 0)
+        return 0;
+
+    ui8 hires = 0;
+    ui8 type = 0;
+    ui64 cycle_delta = 0, payload_size = 0;
+    while(!hires && chip8_video_read_record_header(player, &type, &cycle_delta, &payload_size) && type != C8_VIDEO_END && payload_size != 0)
+    {
+        const int resolution = fgetc(player->file);
+        hires = resolution == 1;
+        if(resolution == EOF || fseek(player->file, (long)payload_size - 1, SEEK_CUR) != 0)
+            break;
+    }
+    fseek(player->file, position, SEEK_SET);
+    return hires;
+}
+
+static void chip8_video_export(Chip8VideoPlayer *player, Chip8VideoEmit emit, void *context)
+{
+    const ui32 cycles_per_frame = player->header.cycles_per_frame;
+    const ui64 start_cycles = player->header.frame_cycles;
+
+    Chip8Frame frame, shown;
+    ui64 shown_tick = 0;
+    ui8 has_shown = 0;
+    while(chip8_video_read_frame(player, &frame))
+    {
+        const ui64 tick = (start_cycles + frame.cycle) / cycles_per_frame;
+        if(has_shown && tick > shown_tick)
+            emit(context, &shown, tick - shown_tick);
+        shown = frame;
+        shown_tick = tick;
+        has_shown = 1;
+    }
+
+    // The last frame stays up until the recording ended
+    if(has_shown)
+    {
+        const ui64 end_tick = (start_cycles + player->cycle) / cycles_per_frame;
+        emit(context, &shown, end_tick > shown_tick ? end_tick - shown_tick : 1);
+    }
+}
+
+// Recordings that go hi-res at any point are exported at 128x64, with their lo-res frames shown at twice the size
+static ui8 chip8_video_pixel(const Chip8Frame *frame, const ui32 x, const ui32 y, const ui32 scale, const ui8 hires)
+{
+    const ui32 size = hires && !frame->hires ? scale * 2 : scale;
+    return chip8_frame_pixel(frame, x / size, y / size);
+}
+
+typedef struct Chip8Y4mExport
+{
+    FILE *file;
+    ui32 scale;
+    ui8 hires;
+    ui32 width;
+    ui32 height;
+    // Luma plane followed by both chroma planes, which stay neutral
+    ui8 *planes;
+} Chip8Y4mExport;
+
+static void chip8_video_emit_y4m(void *context, const Chip8Frame *frame, const ui64 num_ticks)
+{
+    Chip8Y4mExport *y4m = (Chip8Y4mExport*)context;
+    for(ui32 y = 0; y < y4m->height; ++y)
+    {
+        for(ui32 x = 0; x < y4m->width; ++x)
+            y4m->planes[y * y4m->width + x] = chip8_video_pixel(frame, x, y, y4m->scale, y4m->hires) ? 235 : 16;
+    }
+
+    const size_t planes_size = (size_t)y4m->width * y4m->height * 3 / 2;
+    for(ui64 tick = 0; tick < num_ticks; ++tick)
+    {
+        fputs("FRAME\n", y4m->file);
+        fwrite(y4m->planes, 1, planes_size, y4m->file);
+    }
+}
+
+i32 chip8_video_export_y4m(Chip8VideoPlayer *player, FILE *file, const ui32 scale)
+{
+    if(scale == 0 || scale > C8_VIDEO_MAX_SCALE)
+        return C8_VIDEO_BAD_SCALE;
+
+    const ui8 hires = chip8_video_has_hires(player);
+    Chip8Y4mExport y4m = { file, scale, hires, (hires ? C8_HIRES_SCREEN_WIDTH : C8_SCREEN_WIDTH) * scale, (hires ? C8_HIRES_SCREEN_HEIGHT : C8_SCREEN_HEIGHT) * scale, NULL };
+    const size_t luma_size = (size_t)y4m.width * y4m.height;
+    y4m.planes = malloc(luma_size * 3 / 2);
+    if(y4m.planes == NULL)
+        return C8_VIDEO_OUT_OF_MEMORY;
+    memset(&y4m.planes[luma_size], 128, luma_size / 2);
+
+    fprintf(file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", y4m.width, y4m.height, (ui32)C8_FRAMES_PER_SECOND);
+    chip8_video_export(player, chip8_video_emit_y4m, &y4m);
+
+    free(y4m.planes);
+    return ferror(file) ? C8_VIDEO_WRITE_FAILED : C8_VIDEO_OK;
+}
+
+/*
+    GIF encoder:
+    Two used colors padded to the smallest table GIF allows, so codes
+    start at three bits. The LZW dictionary is a trie with one child per
+    color and is reset with a clear code once all 4096 codes are taken.
+*/
+enum
+{
+    C8_GIF_MIN_CODE_SIZE = 2,
+    C8_GIF_CLEAR_CODE = 1 << C8_GIF_MIN_CODE_SIZE,
+    C8_GIF_END_CODE = C8_GIF_CLEAR_CODE + 1,
+    C8_GIF_MAX_CODES = 4096,
+    C8_GIF_MAX_BLOCK_SIZE = 255,
+};
+
+typedef struct Chip8GifExport
+{
+    FILE *file;
+    ui32 scale;
+    ui8 hires;
+    ui32 width;
+    ui32 height;
+    ui64 tick;
+
+    ui16 children[C8_GIF_MAX_CODES][C8_GIF_CLEAR_CODE];
+    ui32 next_code;
+    ui32 code_size;
+    ui32 bits;
+    ui32 num_bits;
+    ui8 block[C8_GIF_MAX_BLOCK_SIZE];
+    ui32 block_size;
+} Chip8GifExport;
+
+static void chip8_gif_write_u16(FILE *file, const ui32 value)
+{
+    fputc((int)(value & 0xFF), file);
+    fputc((int)((value >> 8) & 0xFF), file);
+}
+
+static void chip8_gif_flush_block(Chip8GifExport *gif)
+{
+    if(gif->block_size == 0)
+        return;
+    fputc((int)gif->block_size, gif->file);
+    fwrite(gif->block, 1, gif->block_size, gif->file);
+    gif->block_size = 0;
+}
+
+static void chip8_gif_write_code(Chip8GifExport *gif, const ui32 code)
+{
+    gif->bits |= code << gif->num_bits;
+    gif->num_bits += gif->code_size;
+    while(gif->num_bits >= 8)
+    {
+        gif->block[gif->block_size++] = (ui8)gif->bits;
+        if(gif->block_size == C8_GIF_MAX_BLOCK_SIZE)
+            chip8_gif_flush_block(gif);
+        gif->bits >>= 8;
+        gif->num_bits -= 8;
+    }
+}
+
+static void chip8_gif_reset_codes(Chip8GifExport *gif)
+{
+    memset(gif->children, 0, sizeof(gif->children));
+    gif->next_code = C8_GIF_END_CODE + 1;
+    gif->code_size = C8_GIF_MIN_CODE_SIZE + 1;
+}
+
+static void chip8_video_emit_gif(void *context, const Chip8Frame *frame, const ui64 num_ticks)
+{
+    Chip8GifExport *gif = (Chip8GifExport*)context;
+    FILE *file = gif->file;
+
+    // Delays are in hundredths of a second, rounded per tick so they never drift
+    const ui64 start_centiseconds = gif->tick * 100 / C8_FRAMES_PER_SECOND;
+    gif->tick += num_ticks;
+    ui64 delay = gif->tick * 100 / C8_FRAMES_PER_SECOND - start_centiseconds;
+    if(delay > 0xFFFF)
+        delay = 0xFFFF;
+
+    const ui8 graphic_control[4] = { 0x21, 0xF9, 0x04, 0x00 };
+    fwrite(graphic_control, 1, sizeof(graphic_control), file);
+    chip8_gif_write_u16(file, (ui32)delay);
+    fputc(0, file);
+    fputc(0, file);
+
+    fputc(0x2C, file);
+    chip8_gif_write_u16(file, 0);
+    chip8_gif_write_u16(file, 0);
+    chip8_gif_write_u16(file, gif->width);
+    chip8_gif_write_u16(file, gif->height);
+    fputc(0, file);
+    fputc(C8_GIF_MIN_CODE_SIZE, file);
+
+    chip8_gif_reset_codes(gif);
+    gif->bits = 0;
+    gif->num_bits = 0;
+    gif->block_size = 0;
+    chip8_gif_write_code(gif, C8_GIF_CLEAR_CODE);
+
+    ui32 prefix = chip8_video_pixel(frame, 0, 0, gif->scale, gif->hires);
+    for(ui32 pixel = 1; pixel < gif->width * gif->height; ++pixel)
+    {
+        const ui8 color = chip8_video_pixel(frame, pixel % gif->width, pixel / gif->width, gif->scale, gif->hires);
+        if(gif->children[prefix][color] != 0)
+        {
+            prefix = gif->children[prefix][color];
+            continue;
+        }
+
+        chip8_gif_write_code(gif, prefix);
+        gif->children[prefix][color] = (ui16)gif->next_code;
+        if(gif->next_code >= (1u << gif->code_size))
+            ++gif->code_size;
+        if(++gif->next_code == C8_GIF_MAX_CODES)
+        {
+            chip8_gif_write_code(gif, C8_GIF_CLEAR_CODE);
+            chip8_gif_reset_codes(gif);
+        }
+        prefix = color;
+    }
+
+    // Decoders add an entry for the last code as well and may widen codes before the end code
+    chip8_gif_write_code(gif, prefix);
+    if(gif->next_code >= (1u << gif->code_size) && gif->code_size < 12)
+        ++gif->code_size;
+    chip8_gif_write_code(gif, C8_GIF_END_CODE);
+    if(gif->num_bits > 0)
+        gif->block[gif->block_size++] = (ui8)gif->bits;
+    chip8_gif_flush_block(gif);
+    fputc(0, file);
+}
+
+i32 chip8_video_export_gif(Chip8VideoPlayer *player, FILE *file, const ui32 scale)
+{
+    if(scale == 0 || scale > C8_VIDEO_MAX_SCALE)
+        return C8_VIDEO_BAD_SCALE;
+
+    Chip8GifExport *gif = calloc(1, sizeof(Chip8GifExport));
+    if(gif == NULL)
+        return C8_VIDEO_OUT_OF_MEMORY;
+    gif->file = file;
+    gif->scale = scale;
+    gif->hires = chip8_video_has_hires(player);
+    gif->width = (gif->hires ? C8_HIRES_SCREEN_WIDTH : C8_SCREEN_WIDTH) * scale;
+    gif->height = (gif->hires ? C8_HIRES_SCREEN_HEIGHT : C8_SCREEN_HEIGHT) * scale;
+
+    // Global table of four colors, black and white then padding
+    fwrite("GIF89a", 1, 6, file);
+    chip8_gif_write_u16(file, gif->width);
+    chip8_gif_write_u16(file, gif->height);
+    const ui8 screen[3] = { 0xF1, 0x00, 0x00 };
+    fwrite(screen, 1, sizeof(screen), file);
+    const ui8 palette[12] = { 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+    fwrite(palette, 1, sizeof(palette), file);
+    const ui8 loop[19] = { 0x21, 0xFF, 0x0B, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 0x03, 0x01, 0x00, 0x00, 0x00 };
+    fwrite(loop, 1, sizeof(loop), file);
+
+    chip8_video_export(player, chip8_video_emit_gif, gif);
+    fputc(0x3B, file);
+
+    free(gif);
+    return ferror(file) ? C8_VIDEO_WRITE_FAILED : C8_VIDEO_OK;
+}
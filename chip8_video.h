@@ -0,0 +1,95 @@
+#pragma once
+
+#include "chip8.h"
+
+#include <stdio.h>
+
+/*
+    Video recordings:
+    The recorder takes a frame straight from `screen_memory` whenever the
+    host sees a draw event and stores it as the XOR against the previous
+    frame with its zero rows and bytes suppressed. Most draws touch a
+    handful of bytes, so a frame usually costs a dozen bytes or so and
+    recording keeps up with an unpaced interpreter. Every
+    `keyframe_interval` frames one is stored against a blank screen
+    instead, which is where seeking restarts decoding. Frames keep the
+    resolution they were drawn at, SCHIP hi-res ones are stored at 128x64
+    and a frame that switches resolution is stored against a blank screen
+    as well.
+
+    File layout, all fields little-endian:
+    "C8VD", ui16 version, ui16 keyframe_interval, ui32 cycles_per_frame,
+    ui32 frame_cycles, ui64 rom hash, then records of one type byte, a
+    LEB128 instruction count since the previous record, a LEB128 payload
+    size and the payload. Keyframes and deltas carry a resolution byte, 0
+    for 64x32 and 1 for 128x64, and a ui64 with one bit per nonzero screen
+    row, then for each of those rows from the top and each of its 64 pixel
+    words from the left, one word per lo-res row and two per hi-res row, a
+    byte with one bit per nonzero byte of the word, from the left, and
+    those bytes. The end record has no payload.
+
+    Frames read back carry the instruction count since recording started
+    in `cycle` and their position in the recording in `sequence`.
+*/
+
+enum
+{
+    C8_VIDEO_OK = 0,
+    C8_VIDEO_OPEN_FAILED,
+    C8_VIDEO_WRITE_FAILED,
+    C8_VIDEO_BAD_HEADER,
+    C8_VIDEO_OUT_OF_MEMORY,
+    C8_VIDEO_SEEK_FAILED,
+    C8_VIDEO_BAD_SCALE,
+};
+
+enum
+{
+    C8_VIDEO_DEFAULT_KEYFRAME_INTERVAL = 256,
+    C8_VIDEO_MAX_SCALE = 16,
+};
+
+typedef struct Chip8VideoHeader
+{
+    ui32 keyframe_interval;
+    ui32 cycles_per_frame;
+    // Virtual clock when recording started, places frames on timer ticks
+    ui32 frame_cycles;
+    ui64 rom_hash;
+} Chip8VideoHeader;
+
+typedef struct Chip8VideoRecorder Chip8VideoRecorder;
+typedef struct Chip8VideoPlayer Chip8VideoPlayer;
+
+// Returns a `C8_VIDEO_*` status, `*recorder` is only set on `C8_VIDEO_OK`
+i32 chip8_video_record(const char *video_file_path, const Chip8 *chip8, const ui32 keyframe_interval, Chip8VideoRecorder **recorder);
+// Call after every run that returned `C8_EVENT_DRAW`
+void chip8_video_record_frame(Chip8VideoRecorder *recorder, const Chip8 *chip8);
+// Bytes written so far, header included
+ui64 chip8_video_record_size(const Chip8VideoRecorder *recorder);
+// Writes the end of the recording at the current instruction count and closes the file
+i32 chip8_video_record_finish(Chip8VideoRecorder *recorder, const Chip8 *chip8);
+
+// Returns a `C8_VIDEO_*` status, `*player` is only set on `C8_VIDEO_OK`
+i32 chip8_video_play(const char *video_file_path, Chip8VideoPlayer **player);
+const Chip8VideoHeader *chip8_video_header(const Chip8VideoPlayer *player);
+// Decodes the next frame, returns 0 once the recording ended
+ui8 chip8_video_read_frame(Chip8VideoPlayer *player, Chip8Frame *frame);
+// Makes `frame_index` the next frame read, decoding from the closest keyframe before it, fails past the last frame
+i32 chip8_video_seek(Chip8VideoPlayer *player, const ui64 frame_index);
+void chip8_video_play_close(Chip8VideoPlayer *player);
+
+/*
+    Exporters:
+    Both read the rest of the recording and place every frame on the timer
+    tick it was drawn in. Only the last frame drawn within a tick is shown,
+    ticks without a draw repeat the frame before. `scale` enlarges every
+    pixel to a square of that size, up to `C8_VIDEO_MAX_SCALE`. Output is
+    128x64 times `scale` when the rest of the recording has a hi-res
+    frame, lo-res frames are then doubled, and 64x32 times `scale` when
+    it has none.
+*/
+// 60 fps YUV4MPEG2, e.g. for ffmpeg
+i32 chip8_video_export_y4m(Chip8VideoPlayer *player, FILE *file, const ui32 scale);
+// Looping two-color GIF, a drawn frame stays up until the tick of the next one
+i32 chip8_video_export_gif(Chip8VideoPlayer *player, FILE *file, const ui32 scale);
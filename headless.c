@@ -0,0 +1,750 @@
+#include "chip8.h"
+#include "chip8_aot.h"
+#include "chip8_batch.h"
+#include "chip8_harness.h"
+#include "chip8_jit.h"
+#include "chip8_movie.h"
+#include "chip8_profile.h"
+#include "chip8_snapshot.h"
+#include "chip8_video.h"
+#ifdef CHIP8_WITH_POOL
+#include "chip8_pool.h"
+#endif
+#ifdef CHIP8_WITH_SHM
+#include "chip8_shm.h"
+#endif
+#ifdef CHIP8_WITH_AUDIO
+#include "chip8_audio.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+    Headless batch runner:
+    Runs every rom given on the command line for a fixed instruction budget
+    without any wall-clock pacing and reports throughput and a hash of the
+    final machine state.
+
+    Usage: chip8_headless [--cycles N | --frames N] [--cycles-per-frame N] [--seed N] [--quirks NAME] [--profile FILE] [--video FILE] [--wav FILE] [--shm NAME [--shm-channel N]] [--jit | --verify-jit | --aot | --verify-aot | --verify-snapshot | --lanes N | --threads N [--instances N] | --record FILE | --replay FILE] rom...
+
+    --seed N       Seeds the CXNN generator of every instance, 0 by default.
+    --quirks NAME  Runs every rom with the default, cosmac or schip quirks
+                   profile instead of the one picked by its hash.
+    --jit          Runs through the x86-64 jit tier.
+    --aot          Runs through the roms translated into this build by
+                   chip8_translate, needs a build with CHIP8_ENABLE_AOT.
+                   Roms without a translation for their quirks profile
+                   run on the interpreter.
+    --lanes N      Runs N instances of every rom in lockstep through the
+                   batched engine, cycles and hash are reported per lane
+                   and for lane 0.
+    --verify-jit   Runs every rom on both the interpreter and the jit with
+                   the random keys of --record and fails if the final
+                   machine states differ. With --record only the
+                   interpreter run is recorded.
+    --verify-aot   Same against the translated roms.
+    --verify-snapshot
+                   Snapshots every rom halfway through its budget and
+                   keeps rewind states of the second half, then checks
+                   that a delta against the snapshot, popping every
+                   rewind state and rerunning the second half from the
+                   snapshot all reproduce the states they were taken from.
+    --threads N    Runs independent instances of every rom on a pool of N
+                   worker threads, one instance per thread unless
+                   --instances is given. Cycles are reported over all
+                   instances and the hash for instance 0.
+    --record FILE  Presses and releases random keys, seeded by --seed, and
+                   records them to a movie.
+    --replay FILE  Plays a movie recorded for the rom to its end, ignoring
+                   the cycle budget and using the movie's timer rate.
+    --profile FILE Prints an opcode and address profile of every rom and
+                   writes folded stacks of all of them to FILE, needs a
+                   build with CHIP8_ENABLE_PROFILE.
+    --video FILE   Records every frame drawn to a video, see chip8_video
+                   for exporting it. Not available with --lanes, --threads
+                   or --replay.
+    --wav FILE     Renders the sound timer to a 16-bit mono WAV file at
+                   44100 Hz, the run waits for the file to keep up so no
+                   sample is dropped. Same restrictions as --video.
+    --shm NAME     Publishes every frame drawn to the shared-memory region
+                   NAME, one channel per rom starting at --shm-channel,
+                   0 by default. The region is created when it does not
+                   exist yet, see chip8_shm for reading it. Same
+                   restrictions as --video, not available on Windows.
+*/
+
+enum
+{
+    DEFAULT_CYCLES = 1000000,
+    DEFAULT_CYCLES_PER_FRAME = 10,
+    POOL_SLICE_CYCLES = 10000,
+    PROFILE_HOT_PCS = 16,
+    // Rewind states --verify-snapshot keeps, one per frame
+    SNAPSHOT_REWIND_STATES = 256,
+    SNAPSHOT_KEYFRAME_INTERVAL = 16,
+};
+
+// Tiers `run_rom` runs instructions on
+enum
+{
+    ENGINE_INTERPRETER = 0,
+    ENGINE_JIT,
+    ENGINE_AOT,
+};
+
+typedef struct RunOptions
+{
+    ui64 num_cycles;
+    ui32 cycles_per_frame;
+    ui8 engine;
+    // Engine compared against the interpreter, `ENGINE_INTERPRETER` when not verifying
+    ui8 verify_engine;
+    ui8 verify_snapshot;
+    ui32 num_lanes;
+    ui32 num_threads;
+    ui32 num_instances;
+    ui64 seed;
+    const char *record_path;
+    const char *replay_path;
+    FILE *profile_file;
+    const char *video_path;
+    const char *wav_path;
+    // Region frames are published to and the channel of the rom being run, NULL when not publishing
+    struct Chip8Shm *shm;
+    ui32 shm_channel;
+    // `C8_QUIRKS_*` profile, negative to use the one picked for each rom
+    i32 quirks;
+} RunOptions;
+
+typedef struct RunResult
+{
+    ui64 num_cycles;
+    ui64 num_draws;
+    // Cycles skipped in idle loops, part of `num_cycles`
+    ui64 num_idle_cycles;
+    double seconds;
+    ui64 state_hash;
+} RunResult;
+
+void print_usage(const char *program);
+int run_rom(const char *rom_file_path, const RunOptions *options, const ui8 engine, RunResult *result);
+int run_rom_batch(const char *rom_file_path, const RunOptions *options, RunResult *result);
+int run_rom_pool(const char *rom_file_path, const RunOptions *options, RunResult *result);
+int run_rom_replay(const char *rom_file_path, const RunOptions *options, RunResult *result);
+int verify_rom_snapshot(const char *rom_file_path, const RunOptions *options);
+ui64 run_rom_frames(Chip8 *chip8, const ui64 num_cycles, Chip8Rewind *rewind, ui64 *rewind_hashes);
+ui8 load_rom(Chip8 *chip8, const char *rom_file_path, const RunOptions *options);
+
+int main(int n_args, char **args)
+{
+    RunOptions options = { DEFAULT_CYCLES, DEFAULT_CYCLES_PER_FRAME, ENGINE_INTERPRETER, ENGINE_INTERPRETER, 0, 0, 0, 0, 0, NULL, NULL, NULL, NULL, NULL, NULL, 0, -1 };
+    ui64 num_frames = 0;
+    const char *profile_path = NULL;
+    const char *shm_name = NULL;
+    ui32 first_shm_channel = 0;
+
+    int arg = 1;
+    for(; arg < n_args; ++arg)
+    {
+        if(strcmp(args[arg], "--cycles") == 0 && arg + 1 < n_args)
+            options.num_cycles = strtoull(args[++arg], NULL, 0);
+        else if(strcmp(args[arg], "--frames") == 0 && arg + 1 < n_args)
+            num_frames = strtoull(args[++arg], NULL, 0);
+        else if(strcmp(args[arg], "--cycles-per-frame") == 0 && arg + 1 < n_args)
+            options.cycles_per_frame = (ui32)strtoul(args[++arg], NULL, 0);
+        else if(strcmp(args[arg], "--seed") == 0 && arg + 1 < n_args)
+            options.seed = strtoull(args[++arg], NULL, 0);
+        else if(strcmp(args[arg], "--record") == 0 && arg + 1 < n_args)
+            options.record_path = args[++arg];
+        else if(strcmp(args[arg], "--replay") == 0 && arg + 1 < n_args)
+            options.replay_path = args[++arg];
+        else if(strcmp(args[arg], "--profile") == 0 && arg + 1 < n_args)
+            profile_path = args[++arg];
+        else if(strcmp(args[arg], "--video") == 0 && arg + 1 < n_args)
+            options.video_path = args[++arg];
+        else if(strcmp(args[arg], "--wav") == 0 && arg + 1 < n_args)
+            options.wav_path = args[++arg];
+        else if(strcmp(args[arg], "--shm") == 0 && arg + 1 < n_args)
+            shm_name = args[++arg];
+        else if(strcmp(args[arg], "--shm-channel") == 0 && arg + 1 < n_args)
+            first_shm_channel = (ui32)strtoul(args[++arg], NULL, 0);
+        else if(strcmp(args[arg], "--quirks") == 0 && arg + 1 < n_args)
+        {
+            ++arg;
+            options.quirks = C8_NUM_QUIRKS;
+            for(ui8 quirks = 0; quirks < C8_NUM_QUIRKS; ++quirks)
+            {
+                if(strcmp(args[arg], chip8_quirks_name(quirks)) == 0)
+                    options.quirks = quirks;
+            }
+            if(options.quirks == C8_NUM_QUIRKS)
+            {
+                print_usage(args[0]);
+                return 1;
+            }
+        }
+        else if(strcmp(args[arg], "--jit") == 0)
+            options.engine = ENGINE_JIT;
+        else if(strcmp(args[arg], "--verify-jit") == 0)
+            options.verify_engine = ENGINE_JIT;
+        else if(strcmp(args[arg], "--aot") == 0)
+            options.engine = ENGINE_AOT;
+        else if(strcmp(args[arg], "--verify-aot") == 0)
+            options.verify_engine = ENGINE_AOT;
+        else if(strcmp(args[arg], "--verify-snapshot") == 0)
+            options.verify_snapshot = 1;
+        else if(strcmp(args[arg], "--lanes") == 0 && arg + 1 < n_args)
+            options.num_lanes = (ui32)strtoul(args[++arg], NULL, 0);
+        else if(strcmp(args[arg], "--threads") == 0 && arg + 1 < n_args)
+            options.num_threads = (ui32)strtoul(args[++arg], NULL, 0);
+        else if(strcmp(args[arg], "--instances") == 0 && arg + 1 < n_args)
+            options.num_instances = (ui32)strtoul(args[++arg], NULL, 0);
+        else if(strcmp(args[arg], "--help") == 0)
+        {
+            print_usage(args[0]);
+            return 0;
+        }
+        else if(args[arg][0] == '-' && args[arg][1] == '-')
+        {
+            print_usage(args[0]);
+            return 1;
+        }
+        else
+            break;
+    }
+
+    if(arg == n_args || options.cycles_per_frame == 0)
+    {
+        print_usage(args[0]);
+        return 1;
+    }
+
+    if(options.num_threads != 0 && options.num_instances == 0)
+        options.num_instances = options.num_threads;
+
+    if(num_frames != 0)
+        options.num_cycles = num_frames * options.cycles_per_frame;
+
+    if(profile_path != NULL)
+    {
+        options.profile_file = fopen(profile_path, "w");
+        if(options.profile_file == NULL)
+        {
+            printf("cannot write `%s`\n", profile_path);
+            return 1;
+        }
+    }
+
+#ifndef CHIP8_WITH_AUDIO
+    if(options.wav_path != NULL)
+    {
+        printf("--wav needs a build with threads\n");
+        return 1;
+    }
+#endif
+
+    if(shm_name != NULL)
+    {
+#ifdef CHIP8_WITH_SHM
+        const ui32 num_channels = first_shm_channel + (ui32)(n_args - arg);
+        const i32 status = chip8_shm_open(shm_name, num_channels > C8_SHM_DEFAULT_CHANNELS ? num_channels : C8_SHM_DEFAULT_CHANNELS, C8_SHM_DEFAULT_SLOTS, &options.shm);
+        if(status != C8_SHM_OK || chip8_shm_num_channels(options.shm) < num_channels)
+        {
+            printf("cannot publish to shared memory `%s`\n", shm_name);
+            return 1;
+        }
+#else
+        printf("--shm needs POSIX shared memory\n");
+        return 1;
+#endif
+    }
+
+    int exit_code = 0;
+    ui64 total_cycles = 0;
+    double total_seconds = 0.0;
+    for(const int first_rom = arg; arg < n_args; ++arg)
+    {
+        options.shm_channel = first_shm_channel + (ui32)(arg - first_rom);
+        RunResult result = {0};
+        int run_error = 0;
+        if(options.verify_snapshot)
+        {
+            if(verify_rom_snapshot(args[arg], &options) != 0)
+                exit_code = 1;
+            continue;
+        }
+        else if(options.replay_path != NULL)
+            run_error = run_rom_replay(args[arg], &options, &result);
+        else if(options.num_threads != 0)
+            run_error = run_rom_pool(args[arg], &options, &result);
+        else if(options.num_lanes != 0)
+            run_error = run_rom_batch(args[arg], &options, &result);
+        else
+            run_error = run_rom(args[arg], &options, options.engine, &result);
+        if(run_error != 0)
+        {
+            exit_code = 1;
+            continue;
+        }
+
+        if(options.verify_engine != ENGINE_INTERPRETER)
+        {
+            RunResult verify_result = {0};
+            if(run_rom(args[arg], &options, options.verify_engine, &verify_result) != 0)
+            {
+                exit_code = 1;
+                continue;
+            }
+            const ui8 match = verify_result.state_hash == result.state_hash && verify_result.num_draws == result.num_draws;
+            printf("%-24s interpreter=%016llx %s=%016llx speedup=%.2fx %s\n",
+                args[arg], result.state_hash, options.verify_engine == ENGINE_JIT ? "jit" : "aot", verify_result.state_hash,
+                verify_result.seconds > 0.0 ? result.seconds / verify_result.seconds : 0.0, match ? "OK" : "MISMATCH");
+            if(!match)
+                exit_code = 1;
+            continue;
+        }
+
+        const double ips = result.seconds > 0.0 ? (double)result.num_cycles / result.seconds : 0.0;
+        printf("%-24s cycles=%llu draws=%llu idle=%llu time=%.6fs ips=%.0f hash=%016llx\n",
+            args[arg], result.num_cycles, result.num_draws, result.num_idle_cycles, result.seconds, ips, result.state_hash);
+
+        total_cycles += result.num_cycles;
+        total_seconds += result.seconds;
+    }
+
+    // Verify modes print one verdict per rom and run nothing worth totalling
+    if(options.verify_engine == ENGINE_INTERPRETER && !options.verify_snapshot)
+    {
+        const double total_ips = total_seconds > 0.0 ? (double)total_cycles / total_seconds : 0.0;
+        printf("total cycles=%llu time=%.6fs ips=%.0f\n", total_cycles, total_seconds, total_ips);
+    }
+
+    if(options.profile_file != NULL && fclose(options.profile_file) != 0)
+        exit_code = 1;
+
+#ifdef CHIP8_WITH_SHM
+    chip8_shm_detach(options.shm);
+#endif
+
+    return exit_code;
+}
+
+void print_usage(const char *program)
+{
+    printf("Usage: %s [--cycles N | --frames N] [--cycles-per-frame N] [--seed N] [--quirks NAME] [--profile FILE] [--video FILE] [--wav FILE] [--shm NAME [--shm-channel N]] [--jit | --verify-jit | --aot | --verify-aot | --verify-snapshot | --lanes N | --threads N [--instances N] | --record FILE | --replay FILE] rom...\n", program);
+}
+
+int run_rom(const char *rom_file_path, const RunOptions *options, const ui8 engine, RunResult *result)
+{
+    static Chip8 chip8;
+    chip8_init(&chip8);
+    // Fixed seed so `CXNN` results, and therefore state hashes, are reproducible
+    chip8_seed(&chip8, options->seed);
+    chip8_set_cycles_per_frame(&chip8, options->cycles_per_frame);
+    if(!load_rom(&chip8, rom_file_path, options))
+        return 1;
+
+    // Only the reference run of --verify-jit or --verify-aot is recorded, both runs get the same random keys
+    Chip8MovieRecorder *recorder = NULL;
+    if(options->record_path != NULL && engine == options->engine
+        && chip8_movie_record(options->record_path, &chip8, &recorder) != C8_MOVIE_OK)
+    {
+        printf("%s: cannot record movie `%s`\n", rom_file_path, options->record_path);
+        return 1;
+    }
+    const ui8 random_input = options->record_path != NULL || options->verify_engine != ENGINE_INTERPRETER;
+    Chip8KeyScript script;
+    chip8_key_script_start(&script, &chip8, options->seed);
+
+    // Only the run whose result is printed is recorded, like the profile below
+    Chip8VideoRecorder *video = NULL;
+    if(options->video_path != NULL && engine == options->engine
+        && chip8_video_record(options->video_path, &chip8, C8_VIDEO_DEFAULT_KEYFRAME_INTERVAL, &video) != C8_VIDEO_OK)
+    {
+        printf("%s: cannot record video `%s`\n", rom_file_path, options->video_path);
+        return 1;
+    }
+
+#ifdef CHIP8_WITH_AUDIO
+    // Rendered for the printed run only, like the video
+    Chip8Audio *audio = NULL;
+    if(options->wav_path != NULL && engine == options->engine)
+    {
+        const Chip8AudioDesc audio_desc = { C8_AUDIO_DEFAULT_SAMPLE_RATE, C8_AUDIO_DEFAULT_RING_SIZE };
+        Chip8AudioSink sink;
+        if(chip8_audio_sink_wav(options->wav_path, audio_desc.sample_rate, &sink) != C8_AUDIO_OK)
+        {
+            printf("%s: cannot write audio `%s`\n", rom_file_path, options->wav_path);
+            return 1;
+        }
+        audio = chip8_audio_create(&audio_desc, &sink, &chip8);
+        if(audio == NULL)
+        {
+            sink.close(sink.context);
+            printf("%s: cannot start audio\n", rom_file_path);
+            return 1;
+        }
+    }
+#endif
+
+    // Only the run whose result is printed is profiled, not the one --verify-jit or --verify-aot compares against
+    static Chip8Profile profile;
+    const ui8 use_profile = options->profile_file != NULL && engine == options->engine;
+    chip8_profile_reset(&profile);
+    if(!chip8_profile_attach(&chip8, use_profile ? &profile : NULL) && use_profile)
+    {
+        printf("--profile needs a build configured with -DCHIP8_ENABLE_PROFILE=ON\n");
+        return 1;
+    }
+
+    Chip8Jit *jit = engine == ENGINE_JIT ? chip8_jit_create(&chip8) : NULL;
+
+    Chip8Aot *aot = NULL;
+    if(engine == ENGINE_AOT)
+    {
+#ifdef CHIP8_WITH_AOT
+        aot = chip8_aot_create(chip8_aot_find(chip8.rom_hash), &chip8);
+        if(aot == NULL)
+            printf("%s: not translated for the %s quirks profile, running on the interpreter\n", rom_file_path, chip8_quirks_name(chip8.quirks));
+#else
+        printf("--aot needs a build configured with -DCHIP8_ENABLE_AOT=ON\n");
+        return 1;
+#endif
+    }
+
+    ui64 num_draws = 0;
+
+    const double start = chip8_now_seconds();
+    for(ui64 cycle = 0; cycle < options->num_cycles;)
+    {
+        // Runs stop for random key edges, otherwise the tiers tick the timers themselves and only return on events
+        ui64 budget = random_input ? chip8_key_script_cycles(&script, &chip8) : options->num_cycles - cycle;
+        if(budget > options->num_cycles - cycle)
+            budget = options->num_cycles - cycle;
+        if(budget > 0xFFFFFFFF)
+            budget = 0xFFFFFFFF;
+
+        ui32 events = 0;
+        ui32 num_cycles = 0;
+        if(jit != NULL)
+            num_cycles = chip8_jit_run_cycles(jit, &chip8, (ui32)budget, &events);
+        else if(aot != NULL)
+            num_cycles = chip8_aot_run_cycles(aot, &chip8, (ui32)budget, &events);
+        else
+            num_cycles = chip8_run_cycles(&chip8, (ui32)budget, &events);
+        if(events & C8_EVENT_DRAW)
+        {
+            ++num_draws;
+            if(video != NULL)
+                chip8_video_record_frame(video, &chip8);
+#ifdef CHIP8_WITH_SHM
+            if(options->shm != NULL && engine == options->engine)
+                chip8_shm_publish(options->shm, options->shm_channel, &chip8);
+#endif
+        }
+
+#ifdef CHIP8_WITH_AUDIO
+        if(audio != NULL)
+        {
+            Chip8Event event;
+            while(chip8_poll_event(&chip8, &event))
+                chip8_audio_event(audio, &chip8, &event);
+            chip8_audio_update(audio, &chip8);
+        }
+#endif
+
+        cycle += num_cycles;
+        Chip8InputKey key;
+        if(random_input && chip8_key_script_next(&script, &chip8, &key))
+        {
+            if(recorder != NULL)
+                chip8_movie_record_input(recorder, &chip8, &key, 1);
+            else
+                chip8_feed_input(&chip8, &key, 1);
+        }
+    }
+    const double end = chip8_now_seconds();
+
+    chip8_jit_destroy(jit);
+    chip8_aot_destroy(aot);
+    if(use_profile)
+    {
+        chip8_profile_attach(&chip8, NULL);
+        printf("%s profile:\n", rom_file_path);
+        chip8_profile_report(&profile, stdout, PROFILE_HOT_PCS);
+        printf("\n");
+        chip8_profile_write_folded(&profile, options->profile_file, rom_file_path);
+    }
+
+    if(video != NULL)
+    {
+        const ui64 video_size = chip8_video_record_size(video);
+        if(chip8_video_record_finish(video, &chip8) != C8_VIDEO_OK)
+        {
+            printf("%s: failed to write video `%s`\n", rom_file_path, options->video_path);
+            return 1;
+        }
+        printf("%s video: frames=%llu bytes=%llu bytes/frame=%.2f\n",
+            rom_file_path, num_draws, video_size, num_draws != 0 ? (double)video_size / (double)num_draws : 0.0);
+    }
+
+#ifdef CHIP8_WITH_AUDIO
+    if(audio != NULL)
+    {
+        Chip8AudioStats audio_stats;
+        chip8_audio_destroy(audio, &audio_stats);
+        printf("%s audio: samples=%llu dropped=%llu seconds=%.2f\n",
+            rom_file_path, audio_stats.num_samples, audio_stats.num_dropped, (double)audio_stats.num_samples / C8_AUDIO_DEFAULT_SAMPLE_RATE);
+    }
+#endif
+
+    if(recorder != NULL && chip8_movie_record_finish(recorder, &chip8) != C8_MOVIE_OK)
+    {
+        printf("%s: failed to write movie `%s`\n", rom_file_path, options->record_path);
+        return 1;
+    }
+
+    result->num_cycles = options->num_cycles;
+    result->num_draws = num_draws;
+    result->num_idle_cycles = chip8.idle_cycles_skipped;
+    result->seconds = end - start;
+    result->state_hash = chip8_state_hash(&chip8);
+    return 0;
+}
+
+int run_rom_batch(const char *rom_file_path, const RunOptions *options, RunResult *result)
+{
+    static Chip8 chip8;
+    chip8_init(&chip8);
+    chip8_seed(&chip8, options->seed);
+    chip8_set_cycles_per_frame(&chip8, options->cycles_per_frame);
+    if(!load_rom(&chip8, rom_file_path, options))
+        return 1;
+
+    Chip8Batch *batch = chip8_batch_create(options->num_lanes, &chip8);
+    ui8 *events = calloc(options->num_lanes, sizeof(ui8));
+    if(batch == NULL || events == NULL)
+    {
+        chip8_batch_destroy(batch);
+        free(events);
+        return 1;
+    }
+
+    ui64 num_draws = 0;
+
+    const double start = chip8_now_seconds();
+    for(ui64 cycle = 0; cycle < options->num_cycles; ++cycle)
+    {
+        chip8_batch_step(batch, events);
+        num_draws += events[0] == C8_EVENT_DRAW;
+    }
+    const double end = chip8_now_seconds();
+
+    chip8_batch_extract(batch, 0, &chip8);
+    chip8_batch_destroy(batch);
+    free(events);
+
+    result->num_cycles = options->num_cycles * options->num_lanes;
+    result->num_draws = num_draws;
+    result->seconds = end - start;
+    result->state_hash = chip8_state_hash(&chip8);
+    return 0;
+}
+
+int run_rom_pool(const char *rom_file_path, const RunOptions *options, RunResult *result)
+{
+#ifdef CHIP8_WITH_POOL
+    static Chip8 chip8;
+    chip8_init(&chip8);
+    chip8_seed(&chip8, options->seed);
+    chip8_set_cycles_per_frame(&chip8, options->cycles_per_frame);
+    if(!load_rom(&chip8, rom_file_path, options))
+        return 1;
+
+    const Chip8PoolDesc desc = { options->num_threads, POOL_SLICE_CYCLES };
+    Chip8Pool *pool = chip8_pool_create(&desc);
+    Chip8 **instances = calloc(options->num_instances, sizeof(Chip8*));
+    ui64 *cycle_budgets = calloc(options->num_instances, sizeof(ui64));
+    int run_error = pool == NULL || instances == NULL || cycle_budgets == NULL;
+    for(ui32 i = 0; i < options->num_instances && !run_error; ++i)
+    {
+        instances[i] = malloc(sizeof(Chip8));
+        if(instances[i] == NULL)
+        {
+            run_error = 1;
+            break;
+        }
+        *instances[i] = chip8;
+        cycle_budgets[i] = options->num_cycles;
+    }
+
+    double start = 0.0;
+    double end = 0.0;
+    if(!run_error)
+    {
+        start = chip8_now_seconds();
+        run_error = chip8_pool_run(pool, instances, cycle_budgets, options->num_instances) != 0;
+        chip8_pool_wait(pool);
+        end = chip8_now_seconds();
+    }
+
+    if(!run_error)
+    {
+        result->num_cycles = options->num_cycles * options->num_instances;
+        for(ui32 i = 0; i < options->num_instances; ++i)
+            result->num_idle_cycles += instances[i]->idle_cycles_skipped;
+        result->seconds = end - start;
+        result->state_hash = chip8_state_hash(instances[0]);
+    }
+
+    chip8_pool_destroy(pool);
+    for(ui32 i = 0; instances != NULL && i < options->num_instances; ++i)
+        free(instances[i]);
+    free(instances);
+    free(cycle_budgets);
+    return run_error;
+#else
+    (void)options;
+    (void)result;
+    printf("%s: built without thread pool support\n", rom_file_path);
+    return 1;
+#endif
+}
+
+int run_rom_replay(const char *rom_file_path, const RunOptions *options, RunResult *result)
+{
+    static Chip8 chip8;
+    chip8_init(&chip8);
+    if(!load_rom(&chip8, rom_file_path, options))
+        return 1;
+
+    Chip8MoviePlayer *player = NULL;
+    i32 status = chip8_movie_play(options->replay_path, &player);
+    if(status == C8_MOVIE_OK)
+        status = chip8_movie_play_start(player, &chip8);
+    if(status != C8_MOVIE_OK)
+    {
+        printf("%s: cannot replay movie `%s`%s\n", rom_file_path, options->replay_path, status == C8_MOVIE_ROM_MISMATCH ? ", it was recorded for another rom" : "");
+        chip8_movie_play_close(player);
+        return 1;
+    }
+
+    ui64 num_cycles = 0;
+    ui64 num_draws = 0;
+    const double start = chip8_now_seconds();
+    while(!chip8_movie_play_finished(player))
+    {
+        ui32 events = 0;
+        num_cycles += chip8_movie_play_cycles(player, &chip8, ~0ULL, &events);
+        num_draws += (events & C8_EVENT_DRAW) != 0;
+    }
+    const double end = chip8_now_seconds();
+
+    chip8_movie_play_close(player);
+
+    result->num_cycles = num_cycles;
+    result->num_draws = num_draws;
+    result->num_idle_cycles = chip8.idle_cycles_skipped;
+    result->seconds = end - start;
+    result->state_hash = chip8_state_hash(&chip8);
+    return 0;
+}
+
+// Hash of everything a snapshot keeps, except the dirty rows that restoring adds to
+static ui64 snapshot_hash(const Chip8 *chip8)
+{
+    Chip8Snapshot snapshot;
+    chip8_snapshot(chip8, &snapshot);
+    snapshot.cpu.dirty_rows = 0;
+    return chip8_hash_bytes(0xCBF29CE484222325ULL, &snapshot, sizeof(snapshot));
+}
+
+int verify_rom_snapshot(const char *rom_file_path, const RunOptions *options)
+{
+    static Chip8 chip8;
+    static Chip8Snapshot base;
+    static ui8 delta[C8_SNAPSHOT_MAX_DELTA_SIZE];
+    static ui64 rewind_hashes[SNAPSHOT_REWIND_STATES];
+
+    chip8_init(&chip8);
+    chip8_seed(&chip8, options->seed);
+    chip8_set_cycles_per_frame(&chip8, options->cycles_per_frame);
+    if(!load_rom(&chip8, rom_file_path, options))
+        return 1;
+
+    Chip8Rewind *rewind = chip8_rewind_create(SNAPSHOT_REWIND_STATES, SNAPSHOT_KEYFRAME_INTERVAL);
+    if(rewind == NULL)
+        return 1;
+
+    const ui64 half_cycles = options->num_cycles / 2;
+    run_rom_frames(&chip8, half_cycles, NULL, NULL);
+    chip8_snapshot(&chip8, &base);
+    const ui64 num_pushed = run_rom_frames(&chip8, options->num_cycles - half_cycles, rewind, rewind_hashes);
+    const ui64 end_hash = snapshot_hash(&chip8);
+
+    // The end state from the snapshot plus a delta
+    const ui32 delta_size = chip8_delta_encode(&base, &chip8, delta, sizeof(delta));
+    chip8_restore(&chip8, &base);
+    const ui8 delta_match = delta_size != 0 && chip8_delta_restore(&chip8, &base, delta, delta_size) && snapshot_hash(&chip8) == end_hash;
+
+    // Every rewind state, newest first, the ring drops whole keyframe groups so it may keep fewer than it can hold
+    const ui32 num_kept = chip8_rewind_count(rewind);
+    ui32 num_popped = 0;
+    ui8 rewind_match = num_kept != 0 || num_pushed == 0;
+    for(ui64 state = num_pushed; rewind_match && chip8_rewind_pop(rewind, &chip8); ++num_popped)
+        rewind_match = snapshot_hash(&chip8) == rewind_hashes[--state % SNAPSHOT_REWIND_STATES];
+    rewind_match &= num_popped == num_kept;
+    chip8_rewind_destroy(rewind);
+
+    // The second half again, from the snapshot restored into a fresh instance
+    chip8_init(&chip8);
+    chip8_restore(&chip8, &base);
+    run_rom_frames(&chip8, options->num_cycles - half_cycles, NULL, NULL);
+    const ui8 rerun_match = snapshot_hash(&chip8) == end_hash;
+
+    const ui8 match = delta_match && rewind_match && rerun_match;
+    printf("%-24s delta=%s bytes=%u rewind=%s states=%u rerun=%s %s\n",
+        rom_file_path, delta_match ? "ok" : "bad", delta_size, rewind_match ? "ok" : "bad", num_popped, rerun_match ? "ok" : "bad", match ? "OK" : "MISMATCH");
+    return !match;
+}
+
+// Runs `num_cycles` on the interpreter, pushing every frame and its hash to `rewind` when given, returns the number of states pushed
+ui64 run_rom_frames(Chip8 *chip8, const ui64 num_cycles, Chip8Rewind *rewind, ui64 *rewind_hashes)
+{
+    ui64 num_pushed = 0;
+    for(ui64 cycle = 0; cycle < num_cycles;)
+    {
+        ui32 budget = chip8_cycles_to_frame(chip8);
+        if(budget > num_cycles - cycle)
+            budget = (ui32)(num_cycles - cycle);
+        cycle += chip8_run_cycles(chip8, budget, NULL);
+
+        if(rewind != NULL && chip8->frame_cycles == 0 && chip8_rewind_push(rewind, chip8))
+            rewind_hashes[num_pushed++ % SNAPSHOT_REWIND_STATES] = snapshot_hash(chip8);
+    }
+    return num_pushed;
+}
+
+ui8 load_rom(Chip8 *chip8, const char *rom_file_path, const RunOptions *options)
+{
+    const i32 status = chip8_load_rom(chip8, rom_file_path);
+    if(status == C8_LOAD_OK)
+    {
+        if(options->quirks >= 0)
+            chip8_set_quirks(chip8, (ui8)options->quirks);
+        return 1;
+    }
+
+    const char *reason = "out of memory";
+    switch(status)
+    {
+        case C8_LOAD_OPEN_FAILED: reason = "cannot open file"; break;
+        case C8_LOAD_READ_FAILED: reason = "cannot read file"; break;
+        case C8_LOAD_EMPTY: reason = "file is empty"; break;
+        case C8_LOAD_TOO_LARGE: reason = "file does not fit in memory"; break;
+    }
+    printf("%s: failed to load rom, %s\n", rom_file_path, reason);
+    return 0;
+}
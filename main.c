@@ -1,7 +1,20 @@
 #define WIN32_LEAN_AND_MEAN 1
 #include <Windows.h>
+#include <stdio.h>
 
 #include "chip8.h"
+#include "chip8_render.h"
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+    #define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+enum
+{
+    CYCLES_PER_FRAME = 10,
+    // Frames run at once after the process was stalled, older ones are dropped
+    MAX_CATCH_UP_FRAMES = 6,
+};
 
 typedef struct InputKey
 {
@@ -23,6 +36,14 @@ const InputMap INPUT_MAP[C8_NUM_KEYS] =
     { 0x5A, C8_KEY_A }, { 0x58, C8_KEY_0 }, { 0x43, C8_KEY_B }, { 0x56, C8_KEY_F }  // Z:A, X:0, C:B, V:F
 };
 
+// Render backend context, the screen buffer is only touched on the render thread
+typedef struct ConsoleScreen
+{
+    HANDLE handle;
+    COORD size;
+    CHAR_INFO buffer[C8_HIRES_SCREEN_PIXELS];
+} ConsoleScreen;
+
 typedef struct KeyboardProcIO
 {
     InputKey *keys;
@@ -35,7 +56,7 @@ LRESULT CALLBACK _keyboard_proc_func(int nCode, WPARAM wParam, LPARAM lParam);
 
 void read_input(InputKey *keys, const ui8 num_keys, ui8 *num_available_keys);
 void map_input(const InputKey *keys, const ui8 num_keys, Chip8InputKey *chip8_keys, const ui8 num_chip8_keys, ui8 *num_available_chip8_keys);
-void draw(const ui8 *pixels, const ui16 num_pixels, const HANDLE handle, CHAR_INFO *screen_buffer, const COORD screen_buffer_size);
+void present(void *context, const Chip8Frame *frame, const Chip8Frame *previous);
 
 int main(int n_args, char **args)
 {
@@ -46,57 +67,84 @@ int main(int n_args, char **args)
     const HANDLE handle = GetStdHandle(STD_OUTPUT_HANDLE);
     const SMALL_RECT window_size = { 0, 0, C8_SCREEN_WIDTH, C8_SCREEN_HEIGHT - 1 };
     SetConsoleWindowInfo(handle, TRUE, &window_size);
-    const COORD screen_buffer_size = { C8_SCREEN_WIDTH, C8_SCREEN_HEIGHT };
-    SetConsoleScreenBufferSize(handle, screen_buffer_size);
+    static ConsoleScreen screen = {0};
+    screen.handle = handle;
+    screen.size.X = C8_SCREEN_WIDTH;
+    screen.size.Y = C8_SCREEN_HEIGHT;
+    SetConsoleScreenBufferSize(handle, screen.size);
 
     Chip8 chip8 = {0};
     chip8_init(&chip8);
-    chip8_load_rom(&chip8, "./roms/pong");
+    if(chip8_load_rom(&chip8, "./roms/pong") != C8_LOAD_OK)
+    {
+        printf("Failed to load rom `./roms/pong`\n");
+        return 1;
+    }
+
+    chip8_set_cycles_per_frame(&chip8, CYCLES_PER_FRAME);
 
-    LARGE_INTEGER current_time = {0}, last_time = {0};
     InputKey input_keys[C8_NUM_KEYS] = {0};
     Chip8InputKey chip8_input_keys[C8_NUM_KEYS] = {0};
-    ui8 pixels[C8_SCREEN_PIXELS] = {0};
-    CHAR_INFO screen_buffer[C8_SCREEN_PIXELS] = {0};
-
-    QueryPerformanceCounter(&current_time);
 
-    const float UPDATE_HZ = 60.f;
-    const ui8 RUNS_PER_UPDATE = 10;
-    float update_timer = 0.f;
-    while(1) 
+    // The console is written on its own thread, a slow console never stalls emulation
+    const Chip8RenderBackend backend = { present, NULL, &screen };
+    Chip8Renderer *renderer = chip8_renderer_create(&backend, C8_FRAMES_PER_SECOND);
+    if(renderer == NULL)
     {
-        last_time = current_time;
-        QueryPerformanceCounter(&current_time);
-        const float dt = (float)((double)(current_time.QuadPart - last_time.QuadPart) / 10000000.f);
+        printf("Failed to start the render thread\n");
+        return 1;
+    }
 
-        update_timer += dt;
-        if(update_timer >= (1.f / UPDATE_HZ)) {
-            update_timer = 0.f;
+    // The core keeps time in frames, the host only decides how many are due
+    HANDLE frame_timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if(frame_timer == NULL)
+        frame_timer = CreateWaitableTimerW(NULL, TRUE, NULL);
 
-            ui8 num_available_input_keys = 0;
-            read_input(input_keys, C8_NUM_KEYS, &num_available_input_keys);
-            ui8 num_available_chip8_input_keys = 0;
-            map_input(input_keys, num_available_input_keys, chip8_input_keys, C8_NUM_KEYS, &num_available_chip8_input_keys);
-            chip8_feed_input(&chip8, chip8_input_keys, num_available_chip8_input_keys);
+    LARGE_INTEGER frequency = {0}, start_time = {0}, current_time = {0};
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start_time);
 
-            for(ui8 i = 0; i < RUNS_PER_UPDATE; ++i)
-            {
-                ui8 event = 0;
-                chip8_run_program(&chip8, &event);
+    ui64 num_frames_run = 0;
+    while(1)
+    {
+        ui8 num_available_input_keys = 0;
+        read_input(input_keys, C8_NUM_KEYS, &num_available_input_keys);
+        ui8 num_available_chip8_input_keys = 0;
+        map_input(input_keys, num_available_input_keys, chip8_input_keys, C8_NUM_KEYS, &num_available_chip8_input_keys);
+        chip8_feed_input(&chip8, chip8_input_keys, num_available_chip8_input_keys);
 
-                if(event == C8_EVENT_DRAW) {
-                    chip8_pixel_data(&chip8, pixels, C8_SCREEN_PIXELS);
-                    draw(pixels, C8_SCREEN_PIXELS, handle, screen_buffer, screen_buffer_size);
-                }
-            }
+        QueryPerformanceCounter(&current_time);
+        const ui64 elapsed_ticks = (ui64)(current_time.QuadPart - start_time.QuadPart);
+        const ui64 num_frames_due = elapsed_ticks / (ui64)frequency.QuadPart * C8_FRAMES_PER_SECOND
+            + elapsed_ticks % (ui64)frequency.QuadPart * C8_FRAMES_PER_SECOND / (ui64)frequency.QuadPart;
 
-            chip8_update_timers(&chip8);
+        if(num_frames_due > num_frames_run)
+        {
+            ui64 num_frames = num_frames_due - num_frames_run;
+            if(num_frames > MAX_CATCH_UP_FRAMES)
+                num_frames = MAX_CATCH_UP_FRAMES;
+            num_frames_run = num_frames_due;
+
+            ui32 events = 0;
+            chip8_run_frames(&chip8, (ui32)num_frames, &events);
+            if(events & C8_EVENT_DRAW)
+                chip8_renderer_publish(renderer, &chip8);
         }
 
-        Sleep(1);
+        // Sleep until the next frame is due, waitable timers count in 100ns units and negative means relative
+        const ui64 next_frame_ticks = (num_frames_run + 1) * (ui64)frequency.QuadPart / C8_FRAMES_PER_SECOND;
+        QueryPerformanceCounter(&current_time);
+        const LONGLONG wait_ticks = (LONGLONG)next_frame_ticks - (current_time.QuadPart - start_time.QuadPart);
+        if(wait_ticks > 0 && frame_timer != NULL)
+        {
+            LARGE_INTEGER due_time = {0};
+            due_time.QuadPart = -(LONGLONG)((ui64)wait_ticks * 10000000ULL / (ui64)frequency.QuadPart);
+            if(due_time.QuadPart != 0 && SetWaitableTimer(frame_timer, &due_time, 0, NULL, NULL, FALSE))
+                WaitForSingleObject(frame_timer, INFINITE);
+        }
     }
 
+    chip8_renderer_destroy(renderer, NULL);
     return 0;
 }
 
@@ -171,16 +219,43 @@ void map_input(const InputKey *keys, const ui8 num_keys, Chip8InputKey *chip8_ke
     }
 }
 
-void draw(const ui8 *pixels, const ui16 num_pixels, const HANDLE handle, CHAR_INFO *screen_buffer, const COORD screen_buffer_size)
+void present(void *context, const Chip8Frame *frame, const Chip8Frame *previous)
 {
-    const ui16 num_screen_buffer_pixels = screen_buffer_size.X * screen_buffer_size.Y;
-    if(pixels == NULL || num_pixels == 0 || screen_buffer == NULL || num_screen_buffer_pixels == 0)
+    ConsoleScreen *screen = (ConsoleScreen*)context;
+    const ui32 changed_bands = chip8_frame_changed_rows(frame, previous);
+    if(changed_bands == 0)
         return;
 
-    for(ui16 i = 0; i < num_pixels && i < num_screen_buffer_pixels; ++i)
-        screen_buffer[i].Attributes = pixels[i] != 0 ? BACKGROUND_RED|BACKGROUND_GREEN|BACKGROUND_BLUE|BACKGROUND_INTENSITY : 0;
+    // The console follows the resolution of the rom, switching it resizes the buffer
+    const SHORT width = frame->hires ? C8_HIRES_SCREEN_WIDTH : C8_SCREEN_WIDTH;
+    const SHORT height = frame->hires ? C8_HIRES_SCREEN_HEIGHT : C8_SCREEN_HEIGHT;
+    if(screen->size.X != width)
+    {
+        const SMALL_RECT window_size = { 0, 0, width, height - 1 };
+        screen->size.X = width;
+        screen->size.Y = height;
+        SetConsoleScreenBufferSize(screen->handle, screen->size);
+        SetConsoleWindowInfo(screen->handle, TRUE, &window_size);
+    }
+
+    // Only the span between the first and last changed band is written to the console
+    const SHORT rows_per_band = frame->hires ? 2 : 1;
+    SHORT first_band = 0, last_band = 31;
+    while(!(changed_bands & (1u << first_band)))
+        ++first_band;
+    while(!(changed_bands & (1u << last_band)))
+        --last_band;
+    const SHORT first_row = first_band * rows_per_band;
+    const SHORT last_row = (last_band + 1) * rows_per_band - 1;
+
+    for(SHORT y = first_row; y <= last_row; ++y)
+    {
+        CHAR_INFO *cells = &screen->buffer[y * width];
+        for(SHORT x = 0; x < width; ++x)
+            cells[x].Attributes = chip8_frame_pixel(frame, x, y) ? BACKGROUND_RED|BACKGROUND_GREEN|BACKGROUND_BLUE|BACKGROUND_INTENSITY : 0;
+    }
 
-    const COORD buffer_start = {0};
-    SMALL_RECT buffer_rect = { 0, 0, screen_buffer_size.X, screen_buffer_size.Y };
-    WriteConsoleOutput(handle, screen_buffer, screen_buffer_size, buffer_start, &buffer_rect);
-}
\ No newline at end of file
+    const COORD buffer_start = { 0, first_row };
+    SMALL_RECT buffer_rect = { 0, first_row, screen->size.X, last_row };
+    WriteConsoleOutput(screen->handle, screen->buffer, screen->size, buffer_start, &buffer_rect);
+}
@@ -0,0 +1,120 @@
+#include "chip8.h"
+#include "chip8_shm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+    Shared-memory reader:
+    Attaches to a region published by `chip8_headless --shm` or any other
+    publisher and prints what its channels hold.
+
+    Usage: chip8_shm [--channel N] [--unlink] name
+
+    --channel N    Prints the newest frame of channel N with its screen
+                   instead of one line per channel that published.
+    --unlink       Removes the region afterwards. Processes still attached
+                   keep their mapping, the next --shm run creates a new one.
+*/
+
+void print_usage(const char *program);
+void print_frame(const Chip8ShmFrame *frame);
+
+int main(int n_args, char **args)
+{
+    i32 channel = -1;
+    ui8 unlink = 0;
+
+    int arg = 1;
+    for(; arg < n_args; ++arg)
+    {
+        if(strcmp(args[arg], "--channel") == 0 && arg + 1 < n_args)
+            channel = (i32)strtol(args[++arg], NULL, 0);
+        else if(strcmp(args[arg], "--unlink") == 0)
+            unlink = 1;
+        else if(strcmp(args[arg], "--help") == 0)
+        {
+            print_usage(args[0]);
+            return 0;
+        }
+        else if(args[arg][0] == '-' && args[arg][1] == '-')
+        {
+            print_usage(args[0]);
+            return 1;
+        }
+        else
+            break;
+    }
+
+    if(arg + 1 != n_args)
+    {
+        print_usage(args[0]);
+        return 1;
+    }
+
+    const char *name = args[arg];
+    Chip8Shm *shm = NULL;
+    if(chip8_shm_attach(name, &shm) != C8_SHM_OK)
+    {
+        printf("cannot attach to shared memory `%s`\n", name);
+        return 1;
+    }
+
+    int exit_code = 0;
+    static Chip8ShmFrame frame;
+    if(channel >= 0)
+    {
+        if(chip8_shm_read(shm, (ui32)channel, &frame))
+            print_frame(&frame);
+        else
+        {
+            printf("%s: channel %d has no frame\n", name, channel);
+            exit_code = 1;
+        }
+    }
+    else
+    {
+        printf("%s: channels=%u slots=%u\n", name, chip8_shm_num_channels(shm), chip8_shm_num_slots(shm));
+        for(ui32 i = 0; i < chip8_shm_num_channels(shm); ++i)
+        {
+            if(chip8_shm_num_frames(shm, i) == 0)
+                continue;
+            if(chip8_shm_read(shm, i, &frame))
+                printf("channel %-4u frames=%llu cycle=%llu rom=%016llx %ux%u pc=%03x\n",
+                    i, frame.frame + 1, frame.cycle_count, frame.rom_hash, frame.width, frame.height, frame.program_counter);
+            else
+                printf("channel %-4u busy\n", i);
+        }
+    }
+
+    chip8_shm_detach(shm);
+    if(unlink && chip8_shm_unlink(name) != C8_SHM_OK)
+    {
+        printf("cannot unlink `%s`\n", name);
+        exit_code = 1;
+    }
+    return exit_code;
+}
+
+void print_usage(const char *program)
+{
+    printf("Usage: %s [--channel N] [--unlink] name\n", program);
+}
+
+void print_frame(const Chip8ShmFrame *frame)
+{
+    printf("frame=%llu cycle=%llu rom=%016llx quirks=%s pc=%03x i=%03x dt=%u st=%u\n",
+        frame->frame, frame->cycle_count, frame->rom_hash, chip8_quirks_name(frame->quirks),
+        frame->program_counter, frame->index_register, frame->delay_timer, frame->sound_timer);
+    for(ui32 i = 0; i < C8_NUM_REGISTERS; ++i)
+        printf("v%X=%02x%s", i, frame->registers[i], i + 1 < C8_NUM_REGISTERS ? " " : "\n");
+
+    const ui32 row_size = frame->width / 8u;
+    for(ui32 y = 0; y < frame->height; ++y)
+    {
+        for(ui32 x = 0; x < frame->width; ++x)
+            putchar((frame->screen[y * row_size + x / 8] >> (7 - x % 8)) & 1 ? '#' : '.');
+        putchar('\n');
+    }
+}
@@ -0,0 +1,275 @@
+#include "chip8.h"
+#include "chip8_render.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+    Terminal frontend:
+    Runs a rom paced at 60 frames per second and shows it through a render
+    thread, the emulation loop only publishes frames and never waits for
+    the terminal.
+
+    Usage: chip8_term [--render ansi|null] [--frames N] [--cycles-per-frame N] [--unpaced] rom
+
+    --render       Backend the frames are presented on, ansi by default.
+    --frames N     Stops after N frames, runs until escape or ctrl-c otherwise.
+    --unpaced      Runs frames back to back instead of at 60 per second,
+                   together with `--render null` it measures the render
+                   path without any terminal cost.
+
+    Keys use the same layout as the Windows frontend, 1234 QWER ASDF ZXCV.
+    Terminals only report presses, so every press holds its key down for a
+    few frames.
+*/
+
+enum
+{
+    DEFAULT_CYCLES_PER_FRAME = 10,
+    // Frames run at once after the process was stalled, older ones are dropped
+    MAX_CATCH_UP_FRAMES = 6,
+    // Long enough to bridge the gap between the first press and key repeat
+    KEY_HOLD_FRAMES = 8,
+    KEY_ESCAPE = 0x1B,
+};
+
+typedef struct InputMap
+{
+    char character;
+    ui8 chip8_key_index;
+} InputMap;
+
+static const InputMap INPUT_MAP[C8_NUM_KEYS] =
+{
+    { '1', C8_KEY_1 }, { '2', C8_KEY_2 }, { '3', C8_KEY_3 }, { '4', C8_KEY_C },
+    { 'q', C8_KEY_4 }, { 'w', C8_KEY_5 }, { 'e', C8_KEY_6 }, { 'r', C8_KEY_D },
+    { 'a', C8_KEY_7 }, { 's', C8_KEY_8 }, { 'd', C8_KEY_9 }, { 'f', C8_KEY_E },
+    { 'z', C8_KEY_A }, { 'x', C8_KEY_0 }, { 'c', C8_KEY_B }, { 'v', C8_KEY_F }
+};
+
+static volatile sig_atomic_t quit_requested = 0;
+
+static void handle_interrupt(int signal_number)
+{
+    (void)signal_number;
+    quit_requested = 1;
+}
+
+void print_usage(const char *program);
+ui8 enter_raw_mode(struct termios *saved);
+ui8 read_input(ui8 *key_hold_frames, Chip8InputKey *keys, ui8 *num_keys);
+ui64 now_nanoseconds(void);
+
+int main(int n_args, char **args)
+{
+    ui32 cycles_per_frame = DEFAULT_CYCLES_PER_FRAME;
+    ui64 max_frames = 0;
+    ui8 unpaced = 0;
+    Chip8RenderBackend backend = chip8_render_backend_ansi(stdout);
+
+    int arg = 1;
+    for(; arg < n_args; ++arg)
+    {
+        if(strcmp(args[arg], "--render") == 0 && arg + 1 < n_args)
+        {
+            ++arg;
+            if(strcmp(args[arg], "ansi") == 0)
+                backend = chip8_render_backend_ansi(stdout);
+            else if(strcmp(args[arg], "null") == 0)
+                backend = chip8_render_backend_null();
+            else
+            {
+                print_usage(args[0]);
+                return 1;
+            }
+        }
+        else if(strcmp(args[arg], "--frames") == 0 && arg + 1 < n_args)
+            max_frames = strtoull(args[++arg], NULL, 0);
+        else if(strcmp(args[arg], "--cycles-per-frame") == 0 && arg + 1 < n_args)
+            cycles_per_frame = (ui32)strtoul(args[++arg], NULL, 0);
+        else if(strcmp(args[arg], "--unpaced") == 0)
+            unpaced = 1;
+        else if(strcmp(args[arg], "--help") == 0)
+        {
+            print_usage(args[0]);
+            return 0;
+        }
+        else if(args[arg][0] == '-' && args[arg][1] == '-')
+        {
+            print_usage(args[0]);
+            return 1;
+        }
+        else
+            break;
+    }
+
+    if(arg + 1 != n_args || cycles_per_frame == 0)
+    {
+        print_usage(args[0]);
+        return 1;
+    }
+
+    Chip8 *chip8 = calloc(1, sizeof(Chip8));
+    if(chip8 == NULL)
+        return 1;
+    chip8_init(chip8);
+    if(chip8_load_rom(chip8, args[arg]) != C8_LOAD_OK)
+    {
+        printf("Failed to load rom `%s`\n", args[arg]);
+        free(chip8);
+        return 1;
+    }
+    chip8_set_cycles_per_frame(chip8, cycles_per_frame);
+
+    Chip8Renderer *renderer = chip8_renderer_create(&backend, C8_FRAMES_PER_SECOND);
+    if(renderer == NULL)
+    {
+        printf("Failed to start the render thread\n");
+        free(chip8);
+        return 1;
+    }
+
+    struct termios saved_terminal;
+    const ui8 raw_mode = enter_raw_mode(&saved_terminal);
+    signal(SIGINT, handle_interrupt);
+    signal(SIGTERM, handle_interrupt);
+
+    ui8 key_hold_frames[C8_NUM_KEYS] = {0};
+    Chip8InputKey input_keys[C8_NUM_KEYS * 2] = {0};
+
+    // The core keeps time in frames, the host only decides how many are due
+    const ui64 frame_nanoseconds = 1000000000ull / C8_FRAMES_PER_SECOND;
+    const ui64 start_time = now_nanoseconds();
+    ui64 num_frames_run = 0;
+    ui64 num_frames_emulated = 0;
+    while(!quit_requested && (max_frames == 0 || num_frames_emulated < max_frames))
+    {
+        ui8 num_input_keys = 0;
+        if(raw_mode && !read_input(key_hold_frames, input_keys, &num_input_keys))
+            break;
+
+        ui64 num_frames = 1;
+        if(!unpaced)
+        {
+            const ui64 num_frames_due = (now_nanoseconds() - start_time) / frame_nanoseconds;
+            num_frames = num_frames_due > num_frames_run ? num_frames_due - num_frames_run : 0;
+            if(num_frames > MAX_CATCH_UP_FRAMES)
+                num_frames = MAX_CATCH_UP_FRAMES;
+            num_frames_run = num_frames_due > num_frames_run ? num_frames_due : num_frames_run;
+        }
+        if(max_frames != 0 && num_frames > max_frames - num_frames_emulated)
+            num_frames = max_frames - num_frames_emulated;
+
+        if(num_frames != 0)
+        {
+            // Held keys age once per loop that runs frames, releases are fed with the next presses
+            for(ui8 key = 0; key < C8_NUM_KEYS; ++key)
+            {
+                if(key_hold_frames[key] == 0)
+                    continue;
+                if(key_hold_frames[key] <= num_frames)
+                {
+                    key_hold_frames[key] = 0;
+                    input_keys[num_input_keys].key_index = key;
+                    input_keys[num_input_keys].key_state = 0;
+                    ++num_input_keys;
+                }
+                else
+                    key_hold_frames[key] -= (ui8)num_frames;
+            }
+        }
+        chip8_feed_input(chip8, input_keys, num_input_keys);
+
+        if(num_frames != 0)
+        {
+            ui32 events = 0;
+            chip8_run_frames(chip8, (ui32)num_frames, &events);
+            num_frames_emulated += num_frames;
+            if(events & C8_EVENT_DRAW)
+                chip8_renderer_publish(renderer, chip8);
+        }
+
+        if(!unpaced)
+        {
+            const ui64 next_frame = start_time + (num_frames_run + 1) * frame_nanoseconds;
+            const struct timespec deadline = { (time_t)(next_frame / 1000000000ull), (long)(next_frame % 1000000000ull) };
+            while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR && !quit_requested)
+                ;
+        }
+    }
+
+    Chip8RenderStats stats = {0};
+    chip8_renderer_destroy(renderer, &stats);
+    if(raw_mode)
+        tcsetattr(STDIN_FILENO, TCSANOW, &saved_terminal);
+
+    const double seconds = (double)(now_nanoseconds() - start_time) / 1e9;
+    printf("\nframes=%llu published=%llu presented=%llu seconds=%.3f\n", num_frames_emulated, stats.num_published, stats.num_presented, seconds);
+
+    free(chip8);
+    return 0;
+}
+
+void print_usage(const char *program)
+{
+    printf("Usage: %s [--render ansi|null] [--frames N] [--cycles-per-frame N] [--unpaced] rom\n", program);
+}
+
+// Unbuffered, unechoed and non-blocking input, ctrl-c still raises SIGINT
+ui8 enter_raw_mode(struct termios *saved)
+{
+    if(!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, saved) != 0)
+        return 0;
+
+    struct termios raw = *saved;
+    raw.c_lflag &= ~(tcflag_t)(ICANON | ECHO);
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    return tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+}
+
+// Presses every mapped key that arrived and restarts its hold, returns 0 once escape was read
+ui8 read_input(ui8 *key_hold_frames, Chip8InputKey *keys, ui8 *num_keys)
+{
+    char buffer[64];
+    ssize_t size = 0;
+    while((size = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0)
+    {
+        for(ssize_t i = 0; i < size; ++i)
+        {
+            if(buffer[i] == KEY_ESCAPE)
+                return 0;
+
+            const char character = (char)tolower((unsigned char)buffer[i]);
+            for(ui8 map = 0; map < C8_NUM_KEYS; ++map)
+            {
+                if(character != INPUT_MAP[map].character)
+                    continue;
+
+                const ui8 key = INPUT_MAP[map].chip8_key_index;
+                if(key_hold_frames[key] == 0 && *num_keys < C8_NUM_KEYS)
+                {
+                    keys[*num_keys].key_index = key;
+                    keys[*num_keys].key_state = 1;
+                    ++*num_keys;
+                }
+                key_hold_frames[key] = KEY_HOLD_FRAMES;
+            }
+        }
+    }
+    return 1;
+}
+
+ui64 now_nanoseconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (ui64)now.tv_sec * 1000000000ull + (ui64)now.tv_nsec;
+}
@@ -0,0 +1,583 @@
+#include "chip8.h"
+#include "chip8_rom.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+    Ahead-of-time translator:
+    Translates roms to C for `chip8_aot`. The control-flow graph of every rom
+    is recovered from 0x200 by following jumps, calls, returns and skips,
+    every rom becomes one C function over the `Chip8` struct with a label
+    per basic block, and the output ends with the `chip8_aot_find` lookup
+    over all roms given.
+
+    Usage: chip8_translate [--quirks NAME] output.c rom...
+
+    --quirks NAME  Translates every rom for the default, cosmac or schip
+                   quirks profile instead of the one picked by its hash.
+
+    Code only reached through BNNN is not found and runs on the interpreter.
+*/
+
+enum
+{
+    MAX_BLOCK_INSTRUCTIONS = 64,
+};
+
+// How an instruction hands over to the next one
+enum
+{
+    FLOW_NEXT = 0,
+    // Sets `program_counter` itself and ends the block
+    FLOW_BRANCH,
+    // Runs on the interpreter and ends the block
+    FLOW_INTERPRET,
+};
+
+typedef struct Translation
+{
+    const Chip8Rom *rom;
+    ui8 quirks;
+    ui32 quirk_flags;
+    // Per address, instructions found by the control-flow analysis and where blocks start
+    ui8 reachable[C8_MEMORY_SIZE];
+    ui8 block_start[C8_MEMORY_SIZE];
+    ui8 block_length[C8_MEMORY_SIZE];
+    ui32 num_instructions;
+    ui32 num_interpreted;
+    ui32 num_blocks;
+} Translation;
+
+void print_usage(const char *program);
+ui8 find_quirks(const char *name);
+ui8 in_rom(const Translation *translation, const ui32 address);
+ui16 rom_opcode(const Translation *translation, const ui32 address);
+ui8 instruction_flow(const ui16 opcode);
+void find_blocks(Translation *translation);
+void write_jump(FILE *output, const Translation *translation, const ui32 target, const char *indent);
+void write_skip(FILE *output, const Translation *translation, const ui16 address, const char *condition);
+ui8 write_instruction(FILE *output, const Translation *translation, const ui16 address);
+void write_rom(FILE *output, Translation *translation, const ui32 rom_index, const char *rom_file_path);
+
+int main(int n_args, char **args)
+{
+    i32 quirks = -1;
+
+    int arg = 1;
+    for(; arg < n_args; ++arg)
+    {
+        if(strcmp(args[arg], "--quirks") == 0 && arg + 1 < n_args)
+        {
+            quirks = find_quirks(args[++arg]);
+            if(quirks == C8_NUM_QUIRKS)
+            {
+                printf("unknown quirks profile `%s`\n", args[arg]);
+                return 1;
+            }
+        }
+        else if(strcmp(args[arg], "--help") == 0)
+        {
+            print_usage(args[0]);
+            return 0;
+        }
+        else if(args[arg][0] == '-' && args[arg][1] == '-')
+        {
+            print_usage(args[0]);
+            return 1;
+        }
+        else
+            break;
+    }
+
+    if(n_args - arg < 2)
+    {
+        print_usage(args[0]);
+        return 1;
+    }
+
+    Translation *translation = malloc(sizeof(Translation));
+    const Chip8Rom **roms = calloc(n_args - arg, sizeof(Chip8Rom *));
+    if(translation == NULL || roms == NULL)
+    {
+        printf("out of memory\n");
+        return 1;
+    }
+
+    const char *output_path = args[arg++];
+    FILE *output = fopen(output_path, "w");
+    if(output == NULL)
+    {
+        printf("cannot write `%s`\n", output_path);
+        return 1;
+    }
+
+    fprintf(output, "// Written by chip8_translate, do not edit\n\n#include \"chip8_aot.h\"\n\n#include <string.h>\n\n");
+
+    ui32 num_roms = 0;
+    int exit_code = 0;
+    for(; arg < n_args; ++arg)
+    {
+        const Chip8Rom *rom = NULL;
+        if(chip8_rom_open(args[arg], &rom) != C8_LOAD_OK)
+        {
+            printf("%s: failed to load\n", args[arg]);
+            exit_code = 1;
+            continue;
+        }
+
+        // Copies of a rom under another name share one translation
+        ui8 duplicate = 0;
+        for(ui32 i = 0; i < num_roms; ++i)
+            duplicate |= roms[i]->hash == rom->hash;
+        if(duplicate)
+            continue;
+
+        memset(translation, 0, sizeof(Translation));
+        translation->rom = rom;
+        translation->quirks = quirks >= 0 ? (ui8)quirks : chip8_rom_quirks(rom->hash);
+        translation->quirk_flags = chip8_quirks_flags(translation->quirks);
+        find_blocks(translation);
+        write_rom(output, translation, num_roms, args[arg]);
+        roms[num_roms++] = rom;
+
+        printf("%s quirks=%s blocks=%u instructions=%u interpreted=%u\n", args[arg], chip8_quirks_name(translation->quirks),
+            translation->num_blocks, translation->num_instructions, translation->num_interpreted);
+    }
+
+    fprintf(output, "const Chip8AotProgram *chip8_aot_find(const ui64 rom_hash)\n{\n");
+    if(num_roms != 0)
+    {
+        fprintf(output, "    static const Chip8AotProgram *const programs[] =\n    {\n");
+        for(ui32 i = 0; i < num_roms; ++i)
+            fprintf(output, "        &rom%u_program,\n", i);
+        fprintf(output, "    };\n\n");
+        fprintf(output, "    for(ui32 i = 0; i < sizeof(programs) / sizeof(programs[0]); ++i)\n    {\n");
+        fprintf(output, "        if(programs[i]->rom_hash == rom_hash)\n            return programs[i];\n    }\n");
+    }
+    else
+        fprintf(output, "    (void)rom_hash;\n");
+    fprintf(output, "    return NULL;\n}\n");
+
+    if(fclose(output) != 0)
+    {
+        printf("failed to write `%s`\n", output_path);
+        exit_code = 1;
+    }
+
+    free(roms);
+    free(translation);
+    return exit_code;
+}
+
+void print_usage(const char *program)
+{
+    printf("Usage: %s [--quirks NAME] output.c rom...\n", program);
+}
+
+ui8 find_quirks(const char *name)
+{
+    ui8 quirks = 0;
+    while(quirks < C8_NUM_QUIRKS && strcmp(chip8_quirks_name(quirks), name) != 0)
+        ++quirks;
+    return quirks;
+}
+
+// Whether both bytes of the instruction at `address` come from the rom
+ui8 in_rom(const Translation *translation, const ui32 address)
+{
+    return address >= C8_ROM_PLACEMENT && address + 1 < C8_ROM_PLACEMENT + translation->rom->size;
+}
+
+ui16 rom_opcode(const Translation *translation, const ui32 address)
+{
+    const ui8 *data = &translation->rom->data[address - C8_ROM_PLACEMENT];
+    return (ui16)(data[0] << 8 | data[1]);
+}
+
+/*
+    Draws, key waits and the sound timer raise events, stores may overwrite
+    code and BNNN jumps to an address only known at run time, so all of them
+    are left to the interpreter. So are the opcodes it does not support.
+*/
+ui8 instruction_flow(const ui16 opcode)
+{
+    switch(opcode & 0xF000)
+    {
+        case 0x0000:
+            if(opcode == 0x00E0)
+                return FLOW_NEXT;
+            return opcode == 0x00EE ? FLOW_BRANCH : FLOW_INTERPRET;
+        case 0x1000:
+        case 0x2000:
+        case 0x3000:
+        case 0x4000:
+        case 0x5000:
+        case 0x9000:
+            return FLOW_BRANCH;
+        case 0x8000:
+            switch(opcode & 0x000F)
+            {
+                case 0x0: case 0x1: case 0x2: case 0x3: case 0x4:
+                case 0x5: case 0x6: case 0x7: case 0xE:
+                    return FLOW_NEXT;
+                default:
+                    return FLOW_INTERPRET;
+            }
+        case 0xB000:
+        case 0xD000:
+            return FLOW_INTERPRET;
+        case 0xE000:
+            return (opcode & 0x00FF) == 0x9E || (opcode & 0x00FF) == 0xA1 ? FLOW_BRANCH : FLOW_INTERPRET;
+        case 0xF000:
+            switch(opcode & 0x00FF)
+            {
+                case 0x07: case 0x15: case 0x1E: case 0x29: case 0x65:
+                    return FLOW_NEXT;
+                default:
+                    return FLOW_INTERPRET;
+            }
+    }
+    return FLOW_NEXT;
+}
+
+/*
+    Control-flow analysis:
+    Walks every path from 0x200 and marks where blocks start, which is at
+    the targets of jumps, calls and skips, after calls and after every
+    instruction handed to the interpreter. Blocks end at the next start,
+    at a branch or interpreted instruction, or after
+    `MAX_BLOCK_INSTRUCTIONS`.
+*/
+void find_blocks(Translation *translation)
+{
+    ui16 worklist[C8_MEMORY_SIZE];
+    ui32 num_pending = 0;
+
+    #define VISIT(target, starts_block) \
+        do \
+        { \
+            const ui32 next = (target); \
+            if(in_rom(translation, next)) \
+            { \
+                translation->block_start[next] |= (starts_block); \
+                if(!translation->reachable[next]) \
+                { \
+                    translation->reachable[next] = 1; \
+                    worklist[num_pending++] = (ui16)next; \
+                } \
+            } \
+        } while(0)
+
+    VISIT(C8_ROM_PLACEMENT, 1);
+    while(num_pending != 0)
+    {
+        const ui16 address = worklist[--num_pending];
+        const ui16 opcode = rom_opcode(translation, address);
+        const ui8 flow = instruction_flow(opcode);
+        if((opcode & 0xF000) == 0x1000)
+            VISIT(opcode & 0x0FFF, 1);
+        else if((opcode & 0xF000) == 0x2000)
+        {
+            VISIT(opcode & 0x0FFF, 1);
+            VISIT(address + 2, 1);
+        }
+        else if(flow == FLOW_BRANCH && opcode != 0x00EE)
+        {
+            VISIT(address + 2, 1);
+            VISIT(address + 4, 1);
+        }
+        else if(flow == FLOW_NEXT || ((opcode & 0xF000) != 0xB000 && opcode != 0x00EE))
+            VISIT(address + 2, flow == FLOW_INTERPRET);
+    }
+
+    #undef VISIT
+
+    // In address order, so blocks cut at the length limit continue in one of their own further on
+    for(ui32 address = C8_ROM_PLACEMENT; address < C8_MEMORY_SIZE; ++address)
+    {
+        if(!translation->block_start[address] || !translation->reachable[address])
+            continue;
+
+        ui32 length = 1;
+        for(ui32 next = address + 2; instruction_flow(rom_opcode(translation, next - 2)) == FLOW_NEXT; next += 2, ++length)
+        {
+            if(!in_rom(translation, next) || translation->block_start[next])
+                break;
+            if(length == MAX_BLOCK_INSTRUCTIONS)
+            {
+                translation->block_start[next] = 1;
+                break;
+            }
+        }
+        translation->block_length[address] = (ui8)length;
+        ++translation->num_blocks;
+        translation->num_instructions += length;
+    }
+}
+
+// Goes on at `target`, straight to its block when it has one
+void write_jump(FILE *output, const Translation *translation, const ui32 target, const char *indent)
+{
+    if(target < C8_MEMORY_SIZE && translation->block_length[target] != 0)
+        fprintf(output, "%sgoto block_%03X;\n", indent, target);
+    else
+        fprintf(output, "%schip8->program_counter = 0x%03X;\n%sgoto done;\n", indent, target, indent);
+}
+
+// Skips the instruction after the one at `address` when `condition` holds
+void write_skip(FILE *output, const Translation *translation, const ui16 address, const char *condition)
+{
+    fprintf(output, "    if(%s)\n    {\n", condition);
+    write_jump(output, translation, address + 4, "        ");
+    fprintf(output, "    }\n");
+    write_jump(output, translation, address + 2, "    ");
+}
+
+/*
+    Writes the code of one instruction. Instructions that go on to the next
+    one count themselves off the frame after they ran, branches count
+    themselves before they jump, as they never touch the timers.
+*/
+ui8 write_instruction(FILE *output, const Translation *translation, const ui16 address)
+{
+    const ui16 opcode = rom_opcode(translation, address);
+    const ui16 nnn = opcode & 0x0FFF;
+    const ui8 nn = opcode & 0x00FF;
+    const ui8 x = (opcode & 0x0F00) >> 8;
+    const ui8 y = (opcode & 0x00F0) >> 4;
+    const ui32 flags = translation->quirk_flags;
+
+    fprintf(output, "    // %03X: %04X\n", address, opcode);
+    if(instruction_flow(opcode) == FLOW_INTERPRET)
+    {
+        fprintf(output, "    C8_AOT_INTERPRET(0x%03X);\n", address);
+        return FLOW_INTERPRET;
+    }
+
+    // Calls past a full stack and returns from an empty one fault in the interpreter
+    if(opcode == 0x00EE || (opcode & 0xF000) == 0x2000)
+    {
+        fprintf(output, "    if(chip8->stack_pointer%s >= C8_NUM_STACK_LEVELS)\n", opcode == 0x00EE ? " - 1u" : "");
+        fprintf(output, "    {\n        C8_AOT_INTERPRET(0x%03X);\n    }\n", address);
+    }
+
+    char condition[64];
+    if(instruction_flow(opcode) == FLOW_BRANCH)
+        fprintf(output, "    C8_AOT_COUNT();\n");
+
+    switch(opcode & 0xF000)
+    {
+        case 0x0000:
+            if(opcode == 0x00EE)
+            {
+                fprintf(output, "    chip8->program_counter = chip8->stack_levels[--chip8->stack_pointer] + 2;\n");
+                fprintf(output, "    goto dispatch;\n");
+                return FLOW_BRANCH;
+            }
+            fprintf(output, "    memset(chip8->screen_memory, 0, sizeof(chip8->screen_memory));\n");
+            fprintf(output, "    chip8->dirty_rows = 0xFFFFFFFF;\n");
+            return FLOW_NEXT;
+        case 0x2000:
+            fprintf(output, "    chip8->stack_levels[chip8->stack_pointer++] = 0x%03X;\n", address);
+            // Fall through
+        case 0x1000:
+            write_jump(output, translation, nnn, "    ");
+            return FLOW_BRANCH;
+        case 0x3000:
+        case 0x4000:
+            snprintf(condition, sizeof(condition), "chip8->registers[0x%X] %s 0x%02X", x, (opcode & 0xF000) == 0x3000 ? "==" : "!=", nn);
+            write_skip(output, translation, address, condition);
+            return FLOW_BRANCH;
+        case 0x5000:
+        case 0x9000:
+            snprintf(condition, sizeof(condition), "chip8->registers[0x%X] %s chip8->registers[0x%X]", x, (opcode & 0xF000) == 0x5000 ? "==" : "!=", y);
+            write_skip(output, translation, address, condition);
+            return FLOW_BRANCH;
+        case 0x6000:
+            fprintf(output, "    chip8->registers[0x%X] = 0x%02X;\n", x, nn);
+            return FLOW_NEXT;
+        case 0x7000:
+            fprintf(output, "    chip8->registers[0x%X] += 0x%02X;\n", x, nn);
+            return FLOW_NEXT;
+        case 0x8000:
+            switch(opcode & 0x000F)
+            {
+                case 0x0:
+                    fprintf(output, "    chip8->registers[0x%X] = chip8->registers[0x%X];\n", x, y);
+                    break;
+                case 0x1:
+                case 0x2:
+                case 0x3:
+                    fprintf(output, "    chip8->registers[0x%X] %s= chip8->registers[0x%X];\n", x, (opcode & 0x000F) == 0x1 ? "|" : (opcode & 0x000F) == 0x2 ? "&" : "^", y);
+                    if(flags & C8_QUIRK_VF_RESET)
+                        fprintf(output, "    chip8->registers[0xF] = 0;\n");
+                    break;
+                case 0x4:
+                    fprintf(output, "    {\n");
+                    fprintf(output, "        const ui16 value = chip8->registers[0x%X] + chip8->registers[0x%X];\n", x, y);
+                    fprintf(output, "        chip8->registers[0xF] = value > 0xFF;\n");
+                    fprintf(output, "        chip8->registers[0x%X] = (ui8)value;\n", x);
+                    fprintf(output, "    }\n");
+                    break;
+                case 0x5:
+                case 0x7:
+                    // VF = not borrow of the register order the opcode picks
+                    fprintf(output, "    {\n");
+                    fprintf(output, "        const ui8 minuend = chip8->registers[0x%X];\n", (opcode & 0x000F) == 0x5 ? x : y);
+                    fprintf(output, "        const ui8 subtrahend = chip8->registers[0x%X];\n", (opcode & 0x000F) == 0x5 ? y : x);
+                    fprintf(output, "        chip8->registers[0xF] = minuend > subtrahend;\n");
+                    fprintf(output, "        chip8->registers[0x%X] = (ui8)(minuend - subtrahend);\n", x);
+                    fprintf(output, "    }\n");
+                    break;
+                case 0x6:
+                case 0xE:
+                    fprintf(output, "    {\n");
+                    fprintf(output, "        const ui8 value = chip8->registers[0x%X];\n", flags & C8_QUIRK_SHIFT_VY ? y : x);
+                    fprintf(output, "        chip8->registers[0xF] = value %s;\n", (opcode & 0x000F) == 0x6 ? "& 0x1" : ">> 7");
+                    fprintf(output, "        chip8->registers[0x%X] = (ui8)(value %s 1);\n", x, (opcode & 0x000F) == 0x6 ? ">>" : "<<");
+                    fprintf(output, "    }\n");
+                    break;
+            }
+            return FLOW_NEXT;
+        case 0xA000:
+            fprintf(output, "    chip8->index_register = 0x%03X;\n", nnn);
+            return FLOW_NEXT;
+        case 0xC000:
+            fprintf(output, "    chip8->registers[0x%X] = (ui8)(0x%02X & chip8_random_byte(&chip8->random_state));\n", x, nn);
+            return FLOW_NEXT;
+        case 0xE000:
+            snprintf(condition, sizeof(condition), "chip8->keys[chip8->registers[0x%X]] == %u", x, nn == 0x9E ? 1 : 0);
+            write_skip(output, translation, address, condition);
+            return FLOW_BRANCH;
+        case 0xF000:
+            switch(nn)
+            {
+                case 0x07:
+                    fprintf(output, "    chip8->registers[0x%X] = chip8->delay_timer;\n", x);
+                    break;
+                case 0x15:
+                    fprintf(output, "    chip8->delay_timer = chip8->registers[0x%X];\n", x);
+                    break;
+                case 0x1E:
+                    fprintf(output, "    chip8->index_register = (chip8->index_register + chip8->registers[0x%X]) & (C8_MEMORY_SIZE - 1);\n", x);
+                    break;
+                case 0x29:
+                    fprintf(output, "    chip8->index_register = (ui8)(chip8->registers[0x%X] * C8_FONT_SIZE);\n", x);
+                    break;
+                case 0x65:
+                    for(ui8 i = 0; i <= x; ++i)
+                        fprintf(output, "    chip8->registers[0x%X] = chip8->memory[(chip8->index_register + %u) & (C8_MEMORY_SIZE - 1)];\n", i, i);
+                    if(flags & C8_QUIRK_LOAD_STORE_INCREMENT)
+                        fprintf(output, "    chip8->index_register += %u;\n", x + 1);
+                    break;
+            }
+            return FLOW_NEXT;
+    }
+    return FLOW_NEXT;
+}
+
+void write_rom(FILE *output, Translation *translation, const ui32 rom_index, const char *rom_file_path)
+{
+    const Chip8Rom *rom = translation->rom;
+
+    fprintf(output, "/* %s */\n\nstatic const ui8 rom%u_data[%u] =\n{", rom_file_path, rom_index, rom->size);
+    for(ui32 i = 0; i < rom->size; ++i)
+        fprintf(output, "%s0x%02X,", i % 16 == 0 ? "\n    " : " ", rom->data[i]);
+    fprintf(output, "\n};\n\n");
+
+    // What the program uses, so it declares nothing it does not
+    ui8 uses_idle = 0;
+    ui8 uses_interpret = 0;
+    ui8 uses_dispatch = 0;
+    for(ui32 address = C8_ROM_PLACEMENT; address < C8_MEMORY_SIZE; ++address)
+    {
+        const ui32 length = translation->block_length[address];
+        if(length == 0)
+            continue;
+
+        const ui16 first_opcode = rom_opcode(translation, address);
+        uses_idle |= (first_opcode & 0xF0FF) == 0xF007 || (first_opcode & 0xF0FF) == 0xF00A;
+        const ui16 last_opcode = rom_opcode(translation, address + (length - 1) * 2);
+        uses_interpret |= instruction_flow(last_opcode) == FLOW_INTERPRET;
+        uses_dispatch |= instruction_flow(last_opcode) == FLOW_INTERPRET || last_opcode == 0x00EE;
+    }
+
+    fprintf(output, "static ui32 rom%u_run(Chip8 *chip8, const ui8 *valid_blocks, const ui32 max_cycles, ui32 *events_out)\n{\n", rom_index);
+    if(translation->num_blocks == 0)
+    {
+        fprintf(output, "    (void)chip8;\n    (void)valid_blocks;\n    (void)max_cycles;\n");
+        fprintf(output, "    if(events_out)\n        *events_out = 0;\n    return 0;\n}\n\n");
+    }
+    else
+    {
+        if(uses_interpret)
+            fprintf(output, "    const ui32 code_generation = chip8->code_generation;\n");
+        fprintf(output, "    ui32 budget = max_cycles;\n");
+        fprintf(output, "    ui32 frame_left = chip8_cycles_to_frame(chip8);\n");
+        fprintf(output, "    ui32 events = 0;\n");
+        if(uses_idle)
+            fprintf(output, "    ui32 idle_cycles = 0;\n");
+
+        fprintf(output, "\n%s    switch(chip8->program_counter)\n    {\n", uses_dispatch ? "dispatch:\n" : "");
+        for(ui32 address = C8_ROM_PLACEMENT; address < C8_MEMORY_SIZE; ++address)
+        {
+            if(translation->block_length[address] != 0)
+                fprintf(output, "        case 0x%03X: goto block_%03X;\n", address, address);
+        }
+        fprintf(output, "    }\n    goto done;\n\n");
+
+        ui32 block_index = 0;
+        for(ui32 address = C8_ROM_PLACEMENT; address < C8_MEMORY_SIZE; ++address)
+        {
+            const ui32 length = translation->block_length[address];
+            if(length == 0)
+                continue;
+
+            fprintf(output, "block_%03X:\n", address);
+            const ui16 first_opcode = rom_opcode(translation, address);
+            if((first_opcode & 0xF0FF) == 0xF007 || (first_opcode & 0xF0FF) == 0xF00A)
+                fprintf(output, "    C8_AOT_SKIP_IDLE(0x%03X, block_%03X);\n", address, address);
+            fprintf(output, "    C8_AOT_BLOCK(%u, 0x%03X, %u);\n", block_index++, address, length);
+
+            for(ui32 count = 1; count <= length; ++count)
+            {
+                const ui16 instruction_address = (ui16)(address + (count - 1) * 2);
+                const ui8 flow = write_instruction(output, translation, instruction_address);
+                translation->num_interpreted += flow == FLOW_INTERPRET;
+                if(flow != FLOW_NEXT)
+                    break;
+
+                fprintf(output, "    C8_AOT_COUNT();\n");
+                // Blocks that run into the next one end by going on with it
+                if(count == length)
+                    write_jump(output, translation, instruction_address + 2, "    ");
+            }
+            fprintf(output, "\n");
+        }
+
+        fprintf(output, "done:\n");
+        fprintf(output, "    chip8_advance_clock(chip8, chip8_cycles_to_frame(chip8) - frame_left);\n");
+        fprintf(output, "    if(events_out)\n        *events_out = events;\n");
+        fprintf(output, "    return max_cycles - budget;\n}\n\n");
+    }
+
+    fprintf(output, "static const Chip8AotBlock rom%u_blocks[] =\n{\n", rom_index);
+    for(ui32 address = C8_ROM_PLACEMENT; address < C8_MEMORY_SIZE; ++address)
+    {
+        if(translation->block_length[address] != 0)
+            fprintf(output, "    { 0x%03X, %u },\n", address, translation->block_length[address]);
+    }
+    fprintf(output, "};\n\n");
+
+    // The name is only informative, characters that would need escaping are dropped
+    fprintf(output, "static const Chip8AotProgram rom%u_program =\n{\n    \"", rom_index);
+    for(const char *c = rom_file_path; *c != '\0'; ++c)
+    {
+        if(*c != '"' && *c != '\\' && *c >= ' ')
+            fputc(*c, output);
+    }
+    fprintf(output, "\", 0x%016llXULL, %u, rom%u_data, %u,\n", rom->hash, translation->quirks, rom_index, rom->size);
+    fprintf(output, "    rom%u_blocks, sizeof(rom%u_blocks) / sizeof(rom%u_blocks[0]), rom%u_run,\n};\n\n", rom_index, rom_index, rom_index, rom_index);
+}
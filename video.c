@@ -0,0 +1,150 @@
+#include "chip8.h"
+#include "chip8_video.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+    Video exporter:
+    Converts a recording made with `chip8_headless --video` to a GIF or a
+    YUV4MPEG2 stream, picked by the extension of the output file.
+
+    Usage: chip8_video [--scale N] [--from FRAME] recording [output.gif | output.y4m]
+
+    --scale N      Size of a screen pixel in the output, 4 by default.
+    --from FRAME   Starts at that recorded frame, seeking from the closest
+                   keyframe instead of decoding the whole recording.
+
+    Without an output the recording is only summarized.
+*/
+
+enum
+{
+    DEFAULT_SCALE = 4,
+};
+
+void print_usage(const char *program);
+int print_summary(Chip8VideoPlayer *player, const char *video_file_path);
+ui8 has_extension(const char *path, const char *extension);
+
+int main(int n_args, char **args)
+{
+    ui32 scale = DEFAULT_SCALE;
+    ui64 first_frame = 0;
+
+    int arg = 1;
+    for(; arg < n_args; ++arg)
+    {
+        if(strcmp(args[arg], "--scale") == 0 && arg + 1 < n_args)
+            scale = (ui32)strtoul(args[++arg], NULL, 0);
+        else if(strcmp(args[arg], "--from") == 0 && arg + 1 < n_args)
+            first_frame = strtoull(args[++arg], NULL, 0);
+        else if(strcmp(args[arg], "--help") == 0)
+        {
+            print_usage(args[0]);
+            return 0;
+        }
+        else if(args[arg][0] == '-' && args[arg][1] == '-')
+        {
+            print_usage(args[0]);
+            return 1;
+        }
+        else
+            break;
+    }
+
+    if(arg == n_args || n_args - arg > 2 || scale == 0 || scale > C8_VIDEO_MAX_SCALE)
+    {
+        print_usage(args[0]);
+        return 1;
+    }
+
+    const char *video_file_path = args[arg];
+    const char *output_path = arg + 1 < n_args ? args[arg + 1] : NULL;
+    Chip8VideoPlayer *player = NULL;
+    if(chip8_video_play(video_file_path, &player) != C8_VIDEO_OK)
+    {
+        printf("cannot read recording `%s`\n", video_file_path);
+        return 1;
+    }
+
+    if(first_frame != 0 && chip8_video_seek(player, first_frame) != C8_VIDEO_OK)
+    {
+        printf("%s: has no frame %llu\n", video_file_path, first_frame);
+        chip8_video_play_close(player);
+        return 1;
+    }
+
+    if(output_path == NULL)
+    {
+        const int exit_code = print_summary(player, video_file_path);
+        chip8_video_play_close(player);
+        return exit_code;
+    }
+
+    const ui8 gif = has_extension(output_path, ".gif");
+    if(!gif && !has_extension(output_path, ".y4m"))
+    {
+        printf("`%s` is neither a .gif nor a .y4m file\n", output_path);
+        chip8_video_play_close(player);
+        return 1;
+    }
+
+    FILE *output = fopen(output_path, "wb");
+    if(output == NULL)
+    {
+        printf("cannot write `%s`\n", output_path);
+        chip8_video_play_close(player);
+        return 1;
+    }
+
+    i32 status = gif ? chip8_video_export_gif(player, output, scale) : chip8_video_export_y4m(player, output, scale);
+    if(fclose(output) != 0 && status == C8_VIDEO_OK)
+        status = C8_VIDEO_WRITE_FAILED;
+    chip8_video_play_close(player);
+    if(status != C8_VIDEO_OK)
+    {
+        printf("failed to write `%s`\n", output_path);
+        return 1;
+    }
+    return 0;
+}
+
+void print_usage(const char *program)
+{
+    printf("Usage: %s [--scale N] [--from FRAME] recording [output.gif | output.y4m]\n", program);
+}
+
+int print_summary(Chip8VideoPlayer *player, const char *video_file_path)
+{
+    const Chip8VideoHeader *header = chip8_video_header(player);
+    Chip8Frame frame;
+    ui64 num_frames = 0, num_hires_frames = 0;
+    if(chip8_video_seek(player, 0) != C8_VIDEO_OK)
+        return 1;
+    while(chip8_video_read_frame(player, &frame))
+    {
+        ++num_frames;
+        num_hires_frames += frame.hires;
+    }
+
+    FILE *file = fopen(video_file_path, "rb");
+    long size = 0;
+    if(file != NULL && fseek(file, 0, SEEK_END) == 0)
+        size = ftell(file);
+    if(file != NULL)
+        fclose(file);
+
+    printf("%s rom=%016llx cycles-per-frame=%u keyframe-interval=%u frames=%llu hires-frames=%llu bytes=%ld bytes/frame=%.2f\n",
+        video_file_path, header->rom_hash, header->cycles_per_frame, header->keyframe_interval,
+        num_frames, num_hires_frames, size, num_frames != 0 ? (double)size / (double)num_frames : 0.0);
+    return 0;
+}
+
+ui8 has_extension(const char *path, const char *extension)
+{
+    const size_t path_length = strlen(path);
+    const size_t extension_length = strlen(extension);
+    return path_length >= extension_length && strcmp(&path[path_length - extension_length], extension) == 0;
+}